@@ -11,10 +11,17 @@
 #include "nrf_gpio.h"
 #include "boards.h"
 #include "nrf_log.h"
+#include "epoch.h"
+#include "app_util_platform.h"
+#include "budget.h"
+#include "diag.h"
 
 bool is_ble_data_notifications_en = false;
 bool is_ble_connected = false;
 bool is_ble_log_notifications_en = false;
+static uint8_t hvn_fifo[SWIVX_HVN_FIFO_SIZE];     //Type of each notification queued in the SoftDevice
+static uint8_t hvn_fifo_rd = 0;
+static uint8_t hvn_fifo_count = 0;
 
 /**@brief Function for initializing the SwivX Custom Service. **/
 uint32_t ble_swivx_init(ble_swivx_t * p_cus, const ble_swivx_init_t * p_cus_init)
@@ -80,6 +87,36 @@ uint32_t ble_swivx_init(ble_swivx_t * p_cus, const ble_swivx_init_t * p_cus_init
     {
         return err_code;
     }
+
+    // Add SwivX Filter characteristic
+    err_code = swivx_filter_char_add(p_cus, p_cus_init);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    // Add SwivX Haptic characteristic
+    err_code = swivx_haptic_char_add(p_cus, p_cus_init);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    // Add SwivX Budget characteristic
+    err_code = swivx_budget_char_add(p_cus, p_cus_init);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    // Add SwivX Diagnostics characteristic
+    err_code = swivx_diag_char_add(p_cus, p_cus_init);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    return NRF_SUCCESS;
 }
 
 
@@ -98,7 +135,7 @@ static uint32_t swivx_settings_char_add(ble_swivx_t * p_cus, const ble_swivx_ini
     ble_gatts_attr_t    attr_char_value;
     ble_uuid_t          ble_uuid;
     ble_gatts_attr_md_t attr_md;
-    uint8_t default_value[14];
+    uint8_t default_value[SWIVX_SETTINGS_CHAR_LEN];
 
     split_register_to_array(default_value);
 
@@ -137,9 +174,9 @@ static uint32_t swivx_settings_char_add(ble_swivx_t * p_cus, const ble_swivx_ini
 
     attr_char_value.p_uuid    = &ble_uuid;
     attr_char_value.p_attr_md = &attr_md;
-    attr_char_value.init_len  = 14;
+    attr_char_value.init_len  = SWIVX_SETTINGS_CHAR_LEN;
     attr_char_value.init_offs = 0;
-    attr_char_value.max_len   = 14;
+    attr_char_value.max_len   = SWIVX_SETTINGS_CHAR_LEN;
     attr_char_value.p_value = default_value;
 
     err_code = sd_ble_gatts_characteristic_add(p_cus->service_handle, &char_md,
@@ -370,15 +407,23 @@ static uint32_t swivx_bat_char_add(ble_swivx_t * p_cus, const ble_swivx_init_t *
     ble_uuid_t          ble_uuid;
     ble_gatts_attr_md_t attr_md;
 
+    memset(&cccd_md, 0, sizeof(cccd_md));
+
+    //  Read  operation on Cccd should be possible without authentication.
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&cccd_md.read_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&cccd_md.write_perm);
+    
+    cccd_md.vloc       = BLE_GATTS_VLOC_STACK;
+
     memset(&char_md, 0, sizeof(char_md));
 
     char_md.char_props.read   = 1;
     char_md.char_props.write  = 0;
-    char_md.char_props.notify = 0; 
+    char_md.char_props.notify = 1; 
     char_md.p_char_user_desc  = NULL;
     char_md.p_char_pf         = NULL;
     char_md.p_user_desc_md    = NULL;
-    char_md.p_cccd_md         = NULL; 
+    char_md.p_cccd_md         = &cccd_md; 
     char_md.p_sccd_md         = NULL;
 
     memset(&attr_md, 0, sizeof(attr_md));
@@ -412,6 +457,257 @@ static uint32_t swivx_bat_char_add(ble_swivx_t * p_cus, const ble_swivx_init_t *
     return NRF_SUCCESS;
 }
 
+/**@brief Function for adding the SwivX Filter characteristic.
+ *
+ * @param[in]   p_cus        Custom Service structure.
+ * @param[in]   p_cus_init   Information needed to initialize the service.
+ *
+ * @return      NRF_SUCCESS on success, otherwise an error code.
+ */
+static uint32_t swivx_filter_char_add(ble_swivx_t * p_cus, const ble_swivx_init_t * p_cus_init)
+{
+    uint32_t            err_code;
+    ble_gatts_char_md_t char_md;
+    ble_gatts_attr_t    attr_char_value;
+    ble_uuid_t          ble_uuid;
+    ble_gatts_attr_md_t attr_md;
+    uint8_t default_value[SWIVX_FILTER_CHAR_LEN];
+
+    default_value[0] = settings_register.filterMedian;
+    default_value[1] = settings_register.filterIirShift;
+    default_value[2] = settings_register.filterDecimation;
+
+    memset(&char_md, 0, sizeof(char_md));
+
+    char_md.char_props.read   = 1;
+    char_md.char_props.write  = 1;
+    char_md.char_props.notify = 0; 
+    char_md.p_char_user_desc  = NULL;
+    char_md.p_char_pf         = NULL;
+    char_md.p_user_desc_md    = NULL;
+    char_md.p_cccd_md         = NULL; 
+    char_md.p_sccd_md         = NULL;
+
+    memset(&attr_md, 0, sizeof(attr_md));
+
+    attr_md.read_perm  = p_cus_init->swivx_filter_char_attr_md.read_perm;
+    attr_md.write_perm = p_cus_init->swivx_filter_char_attr_md.write_perm;
+    attr_md.vloc       = BLE_GATTS_VLOC_STACK;
+    attr_md.rd_auth    = 0;
+    attr_md.wr_auth    = 0;
+    attr_md.vlen       = 0;
+
+    ble_uuid.type = p_cus->uuid_type;
+    ble_uuid.uuid = SWIVX_FILTER_CHAR_UUID;
+
+    memset(&attr_char_value, 0, sizeof(attr_char_value));
+
+    attr_char_value.p_uuid    = &ble_uuid;
+    attr_char_value.p_attr_md = &attr_md;
+    attr_char_value.init_len  = SWIVX_FILTER_CHAR_LEN;
+    attr_char_value.init_offs = 0;
+    attr_char_value.max_len   = SWIVX_FILTER_CHAR_LEN;
+    attr_char_value.p_value   = default_value;
+
+    err_code = sd_ble_gatts_characteristic_add(p_cus->service_handle, &char_md,
+                                               &attr_char_value,
+                                               &p_cus->swivx_filter_handles);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    return NRF_SUCCESS;
+}
+
+/**@brief Function for adding the SwivX Haptic characteristic.
+ *
+ * @details Writes are authorized so long uploads can be taken by the Queued Write module, the
+ *          attribute handle has to be registered with it by the application.
+ *
+ * @param[in]   p_cus        Custom Service structure.
+ * @param[in]   p_cus_init   Information needed to initialize the service.
+ *
+ * @return      NRF_SUCCESS on success, otherwise an error code.
+ */
+static uint32_t swivx_haptic_char_add(ble_swivx_t * p_cus, const ble_swivx_init_t * p_cus_init)
+{
+    uint32_t            err_code;
+    ble_gatts_char_md_t char_md;
+    ble_gatts_attr_t    attr_char_value;
+    ble_uuid_t          ble_uuid;
+    ble_gatts_attr_md_t attr_md;
+    uint8_t default_value[HAPTIC_UPLOAD_HEADER_LEN];
+
+    //Selection of the current alert waveform
+    default_value[0] = settings_register.hapticSlot;
+    default_value[1] = 0;
+
+    memset(&char_md, 0, sizeof(char_md));
+
+    char_md.char_props.read   = 1;
+    char_md.char_props.write  = 1;
+    char_md.char_props.notify = 0; 
+    char_md.p_char_user_desc  = NULL;
+    char_md.p_char_pf         = NULL;
+    char_md.p_user_desc_md    = NULL;
+    char_md.p_cccd_md         = NULL; 
+    char_md.p_sccd_md         = NULL;
+
+    memset(&attr_md, 0, sizeof(attr_md));
+
+    attr_md.read_perm  = p_cus_init->swivx_haptic_char_attr_md.read_perm;
+    attr_md.write_perm = p_cus_init->swivx_haptic_char_attr_md.write_perm;
+    attr_md.vloc       = BLE_GATTS_VLOC_STACK;
+    attr_md.rd_auth    = 0;
+    attr_md.wr_auth    = 1;
+    attr_md.vlen       = 1;
+
+    ble_uuid.type = p_cus->uuid_type;
+    ble_uuid.uuid = SWIVX_HAPTIC_CHAR_UUID;
+
+    memset(&attr_char_value, 0, sizeof(attr_char_value));
+
+    attr_char_value.p_uuid    = &ble_uuid;
+    attr_char_value.p_attr_md = &attr_md;
+    attr_char_value.init_len  = HAPTIC_UPLOAD_HEADER_LEN;
+    attr_char_value.init_offs = 0;
+    attr_char_value.max_len   = SWIVX_HAPTIC_CHAR_LEN;
+    attr_char_value.p_value   = default_value;
+
+    err_code = sd_ble_gatts_characteristic_add(p_cus->service_handle, &char_md,
+                                               &attr_char_value,
+                                               &p_cus->swivx_haptic_handles);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    return NRF_SUCCESS;
+}
+
+/**@brief Function for adding the SwivX Budget characteristic.
+ *
+ * @param[in]   p_cus        Custom Service structure.
+ * @param[in]   p_cus_init   Information needed to initialize the service.
+ *
+ * @return      NRF_SUCCESS on success, otherwise an error code.
+ */
+static uint32_t swivx_budget_char_add(ble_swivx_t * p_cus, const ble_swivx_init_t * p_cus_init)
+{
+    uint32_t            err_code;
+    ble_gatts_char_md_t char_md;
+    ble_gatts_attr_t    attr_char_value;
+    ble_uuid_t          ble_uuid;
+    ble_gatts_attr_md_t attr_md;
+    uint8_t default_value[SWIVX_BUDGET_CHAR_LEN];
+
+    budget_to_array(default_value);
+
+    memset(&char_md, 0, sizeof(char_md));
+
+    char_md.char_props.read   = 1;
+    char_md.char_props.write  = 0;
+    char_md.char_props.notify = 0; 
+    char_md.p_char_user_desc  = NULL;
+    char_md.p_char_pf         = NULL;
+    char_md.p_user_desc_md    = NULL;
+    char_md.p_cccd_md         = NULL; 
+    char_md.p_sccd_md         = NULL;
+
+    memset(&attr_md, 0, sizeof(attr_md));
+
+    attr_md.read_perm  = p_cus_init->swivx_budget_char_attr_md.read_perm;
+    attr_md.write_perm = p_cus_init->swivx_budget_char_attr_md.write_perm;
+    attr_md.vloc       = BLE_GATTS_VLOC_STACK;
+    attr_md.rd_auth    = 0;
+    attr_md.wr_auth    = 0;
+    attr_md.vlen       = 0;
+
+    ble_uuid.type = p_cus->uuid_type;
+    ble_uuid.uuid = SWIVX_BUDGET_CHAR_UUID;
+
+    memset(&attr_char_value, 0, sizeof(attr_char_value));
+
+    attr_char_value.p_uuid    = &ble_uuid;
+    attr_char_value.p_attr_md = &attr_md;
+    attr_char_value.init_len  = SWIVX_BUDGET_CHAR_LEN;
+    attr_char_value.init_offs = 0;
+    attr_char_value.max_len   = SWIVX_BUDGET_CHAR_LEN;
+    attr_char_value.p_value   = default_value;
+
+    err_code = sd_ble_gatts_characteristic_add(p_cus->service_handle, &char_md,
+                                               &attr_char_value,
+                                               &p_cus->swivx_budget_handles);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    return NRF_SUCCESS;
+}
+
+/**@brief Function for adding the SwivX Diagnostics characteristic.
+ *
+ * @param[in]   p_cus        Custom Service structure.
+ * @param[in]   p_cus_init   Information needed to initialize the service.
+ *
+ * @return      NRF_SUCCESS on success, otherwise an error code.
+ */
+static uint32_t swivx_diag_char_add(ble_swivx_t * p_cus, const ble_swivx_init_t * p_cus_init)
+{
+    uint32_t            err_code;
+    ble_gatts_char_md_t char_md;
+    ble_gatts_attr_t    attr_char_value;
+    ble_uuid_t          ble_uuid;
+    ble_gatts_attr_md_t attr_md;
+    uint8_t default_value[SWIVX_DIAG_CHAR_LEN];
+
+    diag_to_array(default_value);
+
+    memset(&char_md, 0, sizeof(char_md));
+
+    char_md.char_props.read   = 1;
+    char_md.char_props.write  = 0;
+    char_md.char_props.notify = 0; 
+    char_md.p_char_user_desc  = NULL;
+    char_md.p_char_pf         = NULL;
+    char_md.p_user_desc_md    = NULL;
+    char_md.p_cccd_md         = NULL; 
+    char_md.p_sccd_md         = NULL;
+
+    memset(&attr_md, 0, sizeof(attr_md));
+
+    attr_md.read_perm  = p_cus_init->swivx_diag_char_attr_md.read_perm;
+    attr_md.write_perm = p_cus_init->swivx_diag_char_attr_md.write_perm;
+    attr_md.vloc       = BLE_GATTS_VLOC_STACK;
+    attr_md.rd_auth    = 0;
+    attr_md.wr_auth    = 0;
+    attr_md.vlen       = 0;
+
+    ble_uuid.type = p_cus->uuid_type;
+    ble_uuid.uuid = SWIVX_DIAG_CHAR_UUID;
+
+    memset(&attr_char_value, 0, sizeof(attr_char_value));
+
+    attr_char_value.p_uuid    = &ble_uuid;
+    attr_char_value.p_attr_md = &attr_md;
+    attr_char_value.init_len  = SWIVX_DIAG_CHAR_LEN;
+    attr_char_value.init_offs = 0;
+    attr_char_value.max_len   = SWIVX_DIAG_CHAR_LEN;
+    attr_char_value.p_value   = default_value;
+
+    err_code = sd_ble_gatts_characteristic_add(p_cus->service_handle, &char_md,
+                                               &attr_char_value,
+                                               &p_cus->swivx_diag_handles);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    return NRF_SUCCESS;
+}
+
 /** @brief Function for handling incoming ble events related to the SwivX Service **/
 void ble_swivx_on_ble_evt( ble_evt_t const * p_ble_evt, void * p_context)
 {
@@ -435,6 +731,14 @@ void ble_swivx_on_ble_evt( ble_evt_t const * p_ble_evt, void * p_context)
             on_write(p_cus, p_ble_evt);
            break;
 
+        case BLE_GATTS_EVT_HVN_TX_COMPLETE:
+            on_hvn_tx_complete(p_cus, p_ble_evt);
+            break;
+
+        case BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST:
+            on_rw_authorize_request(p_cus, p_ble_evt);
+            break;
+
         default:
             // No implementation needed.
             break;
@@ -467,6 +771,10 @@ static void on_disconnect(ble_swivx_t * p_cus, ble_evt_t const * p_ble_evt)
     UNUSED_PARAMETER(p_ble_evt);
     p_cus->conn_handle = BLE_CONN_HANDLE_INVALID;
 
+    //Queued notifications are dropped with the link
+    hvn_fifo_rd = 0;
+    hvn_fifo_count = 0;
+
     ble_swivx_evt_t evt;
 
     //propogate event to application handler
@@ -474,6 +782,41 @@ static void on_disconnect(ble_swivx_t * p_cus, ble_evt_t const * p_ble_evt)
     p_cus->evt_handler(p_cus, &evt, NULL);
 }
 
+/**@brief Function for handling the notification TX complete event.
+ *
+ * @details Notifications complete in the order they were queued, count the log packets
+ *          among them and pass the count to the application.
+ *
+ * @param[in]   p_cus       Custom Service structure.
+ * @param[in]   p_ble_evt   Event received from the BLE stack.
+ */
+static void on_hvn_tx_complete(ble_swivx_t * p_cus, ble_evt_t const * p_ble_evt)
+{
+    uint8_t count = p_ble_evt->evt.gatts_evt.params.hvn_tx_complete.count;
+    uint16_t log_count = 0;
+
+    diag_count(DIAG_COUNTER_BLE_TX, count);
+
+    while(count > 0 && hvn_fifo_count > 0)
+    {
+        if(hvn_fifo[hvn_fifo_rd] == SWIVX_HVN_LOG)
+        {
+            log_count++;
+        }
+        hvn_fifo_rd = (hvn_fifo_rd + 1) % SWIVX_HVN_FIFO_SIZE;
+        hvn_fifo_count--;
+        count--;
+    }
+
+    if(log_count > 0 && p_cus->evt_handler != NULL)
+    {
+        ble_swivx_evt_t evt;
+
+        evt.evt_type = BLE_SWIVX_EVT_LOG_TX_COMPLETE;
+        p_cus->evt_handler(p_cus, &evt, &log_count);
+    }
+}
+
 /**@brief Function for handling the Write event.
  *
  * @param[in]   p_cus       Custom Service structure.
@@ -485,18 +828,25 @@ static void on_write(ble_swivx_t * p_cus, ble_evt_t const * p_ble_evt)
 
     if (p_evt_write->handle == p_cus->swivx_settings_handles.value_handle)
     {
-        uint8_t * data_packet;
-
         //if Mode is written
         ble_swivx_evt_t evt;
-        
-        data_packet = p_evt_write->data;
-        settings_register_write(data_packet);
+
+        settings_register_write(p_evt_write->data, p_evt_write->len);
 
         evt.evt_type = BLE_SWIVX_EVT_SETTINGS_WRITTEN;
         p_cus->evt_handler(p_cus, &evt, NULL);
     }
 
+    if (p_evt_write->handle == p_cus->swivx_filter_handles.value_handle
+        && p_evt_write->len == SWIVX_FILTER_CHAR_LEN)
+    {
+        //Filter settings are checked by the application before they are applied
+        ble_swivx_evt_t evt;
+
+        evt.evt_type = BLE_SWIVX_EVT_FILTER_WRITTEN;
+        p_cus->evt_handler(p_cus, &evt, p_evt_write->data);
+    }
+
     if (p_evt_write->handle == p_cus->swivx_mode_handles.value_handle)
     {
         //if Mode is written
@@ -554,6 +904,49 @@ static void on_write(ble_swivx_t * p_cus, ble_evt_t const * p_ble_evt)
 
 }
 
+/**@brief Function for handling the Read/Write Authorization request event.
+ *
+ * @details Single writes to the Haptic characteristic are accepted here. Prepared and executed
+ *          writes are handled by the Queued Write module.
+ *
+ * @param[in]   p_cus       Custom Service structure.
+ * @param[in]   p_ble_evt   Event received from the BLE stack.
+ */
+static void on_rw_authorize_request(ble_swivx_t * p_cus, ble_evt_t const * p_ble_evt)
+{
+    uint32_t err_code;
+    ble_gatts_evt_rw_authorize_request_t const * p_req = &p_ble_evt->evt.gatts_evt.params.authorize_request;
+    ble_gatts_rw_authorize_reply_params_t auth_reply;
+
+    if (p_req->type != BLE_GATTS_AUTHORIZE_TYPE_WRITE
+        || p_req->request.write.op != BLE_GATTS_OP_WRITE_REQ
+        || p_req->request.write.handle != p_cus->swivx_haptic_handles.value_handle)
+    {
+        return;
+    }
+
+    memset(&auth_reply, 0, sizeof(auth_reply));
+
+    auth_reply.type                     = BLE_GATTS_AUTHORIZE_TYPE_WRITE;
+    auth_reply.params.write.gatt_status = BLE_GATT_STATUS_SUCCESS;
+    auth_reply.params.write.update      = 1;
+    auth_reply.params.write.offset      = p_req->request.write.offset;
+    auth_reply.params.write.len         = p_req->request.write.len;
+    auth_reply.params.write.p_data      = p_req->request.write.data;
+
+    err_code = sd_ble_gatts_rw_authorize_reply(p_ble_evt->evt.gatts_evt.conn_handle, &auth_reply);
+    if (err_code != NRF_SUCCESS)
+    {
+        return;
+    }
+
+    //Packet is checked by the application before it is applied
+    ble_swivx_evt_t evt;
+
+    evt.evt_type = BLE_SWIVX_EVT_HAPTIC_WRITTEN;
+    p_cus->evt_handler(p_cus, &evt, NULL);
+}
+
 /**@brief Function for updating The SwivX Data characteristic and sending notification.
  *
  * @param[in]   p_cus       Custom Service structure.
@@ -586,24 +979,7 @@ uint32_t ble_swivx_data_update(ble_swivx_t * p_cus, uint8_t data_value)
     }
 
     // Send value if connected and notifying.
-    if ((p_cus->conn_handle != BLE_CONN_HANDLE_INVALID)) 
-    {
-        ble_gatts_hvx_params_t hvx_params;
-
-        memset(&hvx_params, 0, sizeof(hvx_params));
-
-        hvx_params.handle = p_cus->swivx_data_handles.value_handle;
-        hvx_params.type   = BLE_GATT_HVX_NOTIFICATION;
-        hvx_params.offset = gatts_value.offset;
-        hvx_params.p_len  = &gatts_value.len;
-        hvx_params.p_data = gatts_value.p_value;
-
-        err_code = sd_ble_gatts_hvx(p_cus->conn_handle, &hvx_params);
-    }
-    else
-    {
-        err_code = NRF_ERROR_INVALID_STATE;
-    }
+    err_code = swivx_notify(p_cus, p_cus->swivx_data_handles.value_handle, &gatts_value, SWIVX_HVN_DATA);
 
 
     return err_code;
@@ -641,24 +1017,7 @@ uint32_t ble_swivx_log_packet_send(ble_swivx_t * p_cus, uint8_t * packet_value)
     }
 
     // Send value if connected and notifying.
-    if ((p_cus->conn_handle != BLE_CONN_HANDLE_INVALID)) 
-    {
-        ble_gatts_hvx_params_t hvx_params;
-
-        memset(&hvx_params, 0, sizeof(hvx_params));
-
-        hvx_params.handle = p_cus->swivx_log_handles.value_handle;
-        hvx_params.type   = BLE_GATT_HVX_NOTIFICATION;
-        hvx_params.offset = gatts_value.offset;
-        hvx_params.p_len  = &gatts_value.len;
-        hvx_params.p_data = gatts_value.p_value;
-
-        err_code = sd_ble_gatts_hvx(p_cus->conn_handle, &hvx_params);
-    }
-    else
-    {
-        err_code = NRF_ERROR_INVALID_STATE;
-    }
+    err_code = swivx_notify(p_cus, p_cus->swivx_log_handles.value_handle, &gatts_value, SWIVX_HVN_LOG);
 
 
     return err_code;
@@ -675,14 +1034,14 @@ uint32_t ble_swivx_settings_update(ble_swivx_t * p_cus)
     }
 
     ble_gatts_value_t gatts_value;
-    uint8_t settings_array[14];
+    uint8_t settings_array[SWIVX_SETTINGS_CHAR_LEN];
 
     split_register_to_array(settings_array);
 
     // Initialize value struct.
     memset(&gatts_value, 0, sizeof(gatts_value));
 
-    gatts_value.len     = 14;
+    gatts_value.len     = SWIVX_SETTINGS_CHAR_LEN;
     gatts_value.offset  = 0;
     gatts_value.p_value = settings_array;
 
@@ -724,12 +1083,192 @@ uint32_t ble_swivx_bat_value_update(ble_swivx_t * p_cus, uint8_t data_value)
         return  err_code;
     }
 
+    //Notify if connected and subscribed, the value can always be read
+    err_code = swivx_notify(p_cus, p_cus->swivx_bat_handles.value_handle, &gatts_value, SWIVX_HVN_BAT);
+    if(err_code == NRF_ERROR_INVALID_STATE || err_code == BLE_ERROR_GATTS_SYS_ATTR_MISSING)
+    {
+        err_code = NRF_SUCCESS;
+    }
+
+    return err_code;
+}
+
+/** @brief Function to update the GATT database with the filter settings in the settings register **/
+uint32_t ble_swivx_filter_update(ble_swivx_t * p_cus)
+{
+    ret_code_t err_code;
+
+    if (p_cus == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    ble_gatts_value_t gatts_value;
+    uint8_t filter_array[SWIVX_FILTER_CHAR_LEN];
+
+    filter_array[0] = settings_register.filterMedian;
+    filter_array[1] = settings_register.filterIirShift;
+    filter_array[2] = settings_register.filterDecimation;
+
+    memset(&gatts_value, 0, sizeof(gatts_value));
+
+    gatts_value.len = SWIVX_FILTER_CHAR_LEN;
+    gatts_value.offset = 0;
+    gatts_value.p_value = filter_array;
+
+    //Update database
+    err_code = sd_ble_gatts_value_set(p_cus->conn_handle, p_cus->swivx_filter_handles.value_handle,
+                                       &gatts_value);
+    if(err_code != NRF_SUCCESS)
+    {
+        return  err_code;
+    }
+
+    return err_code;
+}
+
+/** @brief Function to update the GATT database with the alert waveform selection in the settings register **/
+uint32_t ble_swivx_haptic_update(ble_swivx_t * p_cus)
+{
+    ble_gatts_value_t gatts_value;
+    uint8_t haptic_array[HAPTIC_UPLOAD_HEADER_LEN];
+
+    if (p_cus == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    haptic_array[0] = settings_register.hapticSlot;
+    haptic_array[1] = 0;
+
+    memset(&gatts_value, 0, sizeof(gatts_value));
+
+    gatts_value.len = HAPTIC_UPLOAD_HEADER_LEN;
+    gatts_value.offset = 0;
+    gatts_value.p_value = haptic_array;
+
+    //Update database
+    return sd_ble_gatts_value_set(p_cus->conn_handle, p_cus->swivx_haptic_handles.value_handle,
+                                  &gatts_value);
+}
+
+/** @brief Function to update the GATT database with the motor energy budget **/
+uint32_t ble_swivx_budget_update(ble_swivx_t * p_cus)
+{
+    ble_gatts_value_t gatts_value;
+    uint8_t budget_array[SWIVX_BUDGET_CHAR_LEN];
+
+    if (p_cus == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    budget_to_array(budget_array);
+
+    memset(&gatts_value, 0, sizeof(gatts_value));
+
+    gatts_value.len = SWIVX_BUDGET_CHAR_LEN;
+    gatts_value.offset = 0;
+    gatts_value.p_value = budget_array;
+
+    //Update database
+    return sd_ble_gatts_value_set(p_cus->conn_handle, p_cus->swivx_budget_handles.value_handle,
+                                  &gatts_value);
+}
+
+/** @brief Function to update the GATT database with an energy and CPU time accounting snapshot **/
+uint32_t ble_swivx_diag_update(ble_swivx_t * p_cus)
+{
+    ble_gatts_value_t gatts_value;
+    uint8_t diag_array[SWIVX_DIAG_CHAR_LEN];
+
+    if (p_cus == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    diag_to_array(diag_array);
+
+    memset(&gatts_value, 0, sizeof(gatts_value));
+
+    gatts_value.len = SWIVX_DIAG_CHAR_LEN;
+    gatts_value.offset = 0;
+    gatts_value.p_value = diag_array;
+
+    //Update database
+    return sd_ble_gatts_value_set(p_cus->conn_handle, p_cus->swivx_diag_handles.value_handle,
+                                  &gatts_value);
+}
+
+/** @brief Function for reading the last haptic upload packet from the GATT database **/
+uint32_t ble_swivx_haptic_value_get(ble_swivx_t * p_cus, uint8_t * p_data, uint16_t * p_len)
+{
+    ret_code_t err_code;
+    ble_gatts_value_t gatts_value;
+
+    if (p_cus == NULL || p_data == NULL || p_len == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    memset(&gatts_value, 0, sizeof(gatts_value));
+
+    gatts_value.len = *p_len;
+    gatts_value.offset = 0;
+    gatts_value.p_value = p_data;
+
+    err_code = sd_ble_gatts_value_get(p_cus->conn_handle, p_cus->swivx_haptic_handles.value_handle,
+                                      &gatts_value);
+    *p_len = gatts_value.len;
+
+    return err_code;
+}
+
+/* @brief Function to send a notification and remember its type until the TX complete event */
+static uint32_t swivx_notify(ble_swivx_t * p_cus, uint16_t value_handle, ble_gatts_value_t * p_value, uint8_t hvn_type)
+{
+    uint32_t err_code;
+    ble_gatts_hvx_params_t hvx_params;
+
+    if (p_cus->conn_handle == BLE_CONN_HANDLE_INVALID)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    memset(&hvx_params, 0, sizeof(hvx_params));
+
+    hvx_params.handle = value_handle;
+    hvx_params.type   = BLE_GATT_HVX_NOTIFICATION;
+    hvx_params.offset = p_value->offset;
+    hvx_params.p_len  = &p_value->len;
+    hvx_params.p_data = p_value->p_value;
+
+    //TX complete is handled in the SoftDevice event interrupt, queue and record together
+    CRITICAL_REGION_ENTER();
+    if (hvn_fifo_count >= SWIVX_HVN_FIFO_SIZE)
+    {
+        err_code = NRF_ERROR_RESOURCES;
+    }
+    else
+    {
+        err_code = sd_ble_gatts_hvx(p_cus->conn_handle, &hvx_params);
+        if (err_code == NRF_SUCCESS)
+        {
+            hvn_fifo[(hvn_fifo_rd + hvn_fifo_count) % SWIVX_HVN_FIFO_SIZE] = hvn_type;
+            hvn_fifo_count++;
+        }
+    }
+    CRITICAL_REGION_EXIT();
+
     return err_code;
 }
 
 /* @brief Function to split the Settings Register to an array for the settings characteristic */
 static void split_register_to_array(uint8_t * reg_array)
 {
+    //Publish the live wall-clock, the flag is clear so a written back value is not a sync
+    uint32_t time = epoch_get();
+
     reg_array[0] = settings_register.angleMin;
     reg_array[1] = settings_register.angleMax;
     reg_array[2] = (uint8_t)((settings_register.touchDuration >> 24) & 0x000000FF);
@@ -740,20 +1279,77 @@ static void split_register_to_array(uint8_t * reg_array)
     reg_array[7] = (uint8_t)((settings_register.motorDuration) & 0x00FF);
     reg_array[8] = settings_register.motorIntensity;
     reg_array[9] = settings_register.motor_pulses;
-    reg_array[10] = (uint8_t)((settings_register.timestamp >> 24) & 0x000000FF);
-    reg_array[11] = (uint8_t)((settings_register.timestamp >> 16) & 0x000000FF);
-    reg_array[12] = (uint8_t)((settings_register.timestamp >> 8) & 0x000000FF);
-    reg_array[13] = (uint8_t)((settings_register.timestamp) & 0x000000FF);
+    reg_array[10] = (uint8_t)((time >> 24) & 0x000000FF);
+    reg_array[11] = (uint8_t)((time >> 16) & 0x000000FF);
+    reg_array[12] = (uint8_t)((time >> 8) & 0x000000FF);
+    reg_array[13] = (uint8_t)((time) & 0x000000FF);
+    reg_array[14] = 0;
+}
+
+static void budget_to_array(uint8_t * budget_array)
+{
+    uint32_t remaining = budget_remaining_get();
+    uint16_t throttled = budget_throttled_get();
+
+    budget_array[0] = (uint8_t)((remaining >> 24) & 0x000000FF);
+    budget_array[1] = (uint8_t)((remaining >> 16) & 0x000000FF);
+    budget_array[2] = (uint8_t)((remaining >> 8) & 0x000000FF);
+    budget_array[3] = (uint8_t)((remaining) & 0x000000FF);
+    budget_array[4] = (uint8_t)((throttled >> 8) & 0x00FF);
+    budget_array[5] = (uint8_t)((throttled) & 0x00FF);
+    budget_array[6] = budget_battery_get();
+    budget_array[7] = (uint8_t)budget_band_get();
 }
 
-static void settings_register_write(uint8_t * data_packet)
+static void diag_to_array(uint8_t * diag_array)
 {
+    diag_snapshot_t snapshot;
+    uint32_t values[SWIVX_DIAG_CHAR_LEN / 4];
+    uint8_t i;
+
+    diag_snapshot_get(&snapshot);
+
+    values[0] = snapshot.uptime_s;
+    for(i = 0; i < DIAG_SUBSYS_COUNT; i++)
+    {
+        values[1 + i] = snapshot.subsys_ms[i];
+    }
+    for(i = 0; i < DIAG_COUNTER_COUNT; i++)
+    {
+        values[1 + DIAG_SUBSYS_COUNT + i] = snapshot.counters[i];
+    }
+    values[1 + DIAG_SUBSYS_COUNT + DIAG_COUNTER_COUNT] = snapshot.avg_current_ua;
+
+    for(i = 0; i < (SWIVX_DIAG_CHAR_LEN / 4); i++)
+    {
+        diag_array[(i * 4)] = (uint8_t)((values[i] >> 24) & 0x000000FF);
+        diag_array[(i * 4) + 1] = (uint8_t)((values[i] >> 16) & 0x000000FF);
+        diag_array[(i * 4) + 2] = (uint8_t)((values[i] >> 8) & 0x000000FF);
+        diag_array[(i * 4) + 3] = (uint8_t)((values[i]) & 0x000000FF);
+    }
+}
+
+static void settings_register_write(uint8_t const * data_packet, uint16_t len)
+{
+    if(len < SWIVX_SETTINGS_LEGACY_LEN)
+    {
+        return;
+    }
+
     settings_register.angleMin = data_packet[0];
     settings_register.angleMax = data_packet[1];
     settings_register.touchDuration = (data_packet[2] << 24) + (data_packet[3] << 16) + (data_packet[4] << 8) + (data_packet[5]);
     settings_register.motorDuration = (data_packet[6] << 8) + (data_packet[7]);
     settings_register.motorIntensity = data_packet[8];
     settings_register.motor_pulses = data_packet[9];
-    settings_register.timestamp = (data_packet[10] << 24) + (data_packet[11] << 16) + (data_packet[12] << 8) + (data_packet[13]);
+
+    //A legacy write always carries the time, with the flags only an explicit time set syncs the clock
+    //as a read-modify-write carries a stale time back
+    if(len < SWIVX_SETTINGS_CHAR_LEN || (data_packet[14] & SWIVX_SETTINGS_FLAG_TIME_SET))
+    {
+        uint32_t timestamp = ((uint32_t)data_packet[10] << 24) + (data_packet[11] << 16) + (data_packet[12] << 8) + (data_packet[13]);
+        epoch_sync(timestamp, 0, EPOCH_SOURCE_APP);
+        settings_register.timestamp = timestamp;
+    }
 }
 
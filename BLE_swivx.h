@@ -18,6 +18,7 @@ extern "C" {
 #include "ble.h"
 #include "ble_srv_common.h"
 #include "log.h"
+#include "haptic.h"
 
 //SwivX custom base UUID                // {8ec91800-f315-4f60-9fb8-838830daea50}
 #define SWIVX_SERVICE_UUID_BASE         {0x73, 0x66, 0xA9, 0x46, 0xD4, 0x6E, 0x6B, 0xB2,              \
@@ -25,10 +26,27 @@ extern "C" {
 
 #define SWIVX_SERVICE_UUID             0x1800
 #define SWIVX_SETTINGS_CHAR_UUID       0x1801
+#define SWIVX_SETTINGS_CHAR_LEN        15             //settings (10), wall-clock (4), flags
+#define SWIVX_SETTINGS_LEGACY_LEN      14             //Without the flags, every write is a time sync
+#define SWIVX_SETTINGS_FLAG_TIME_SET   0x01           //The wall-clock bytes are a time sync from the app
 #define SWIVX_MODE_CHAR_UUID           0x1802
 #define SWIVX_LOG_CHAR_UUID            0x1803
 #define SWIVX_DATA_CHAR_UUID           0x1804
 #define SWIVX_BAT_CHAR_UUID            0x1805
+#define SWIVX_FILTER_CHAR_UUID         0x1806
+#define SWIVX_FILTER_CHAR_LEN          3              //median window, IIR shift, decimation
+#define SWIVX_HAPTIC_CHAR_UUID         0x1807
+#define SWIVX_HAPTIC_CHAR_LEN          HAPTIC_UPLOAD_MAX_LEN  //Longer than one ATT write, uploaded with Queued Writes
+#define SWIVX_BUDGET_CHAR_UUID         0x1808
+#define SWIVX_BUDGET_CHAR_LEN          8              //remaining ms (4), throttled alerts (2), battery %, band
+#define SWIVX_DIAG_CHAR_UUID           0x1809
+#define SWIVX_DIAG_CHAR_LEN            60             //uptime s, ms per subsystem (8), counters (5), average uA, 4 bytes each
+
+//Notifications queued in the SoftDevice, tracked to tell which ones a TX complete covers
+#define SWIVX_HVN_FIFO_SIZE            16
+#define SWIVX_HVN_DATA                 0
+#define SWIVX_HVN_LOG                  1
+#define SWIVX_HVN_BAT                  2
 
 extern bool is_ble_data_notifications_en;
 extern bool is_ble_connected;
@@ -55,7 +73,10 @@ typedef enum
     BLE_SWIVX_EVT_SETTINGS_WRITTEN,
     BLE_SWIVX_EVT_MODE_WRITTEN,
     BLE_SWIVX_EVT_DISCONNECTED,
-    BLE_SWIVX_EVT_CONNECTED
+    BLE_SWIVX_EVT_CONNECTED,
+    BLE_SWIVX_EVT_LOG_TX_COMPLETE,                                  //p_context is the uint16_t count of log packets sent
+    BLE_SWIVX_EVT_FILTER_WRITTEN,
+    BLE_SWIVX_EVT_HAPTIC_WRITTEN                                    //Read the value with ble_swivx_haptic_value_get
 } ble_swivx_evt_type_t;
 
 /**@brief Custom Service event. */
@@ -82,6 +103,10 @@ typedef struct
     ble_srv_cccd_security_mode_t  swivx_log_char_attr_md;         /**< Initial security level for Log characteristics attribute */
     ble_srv_cccd_security_mode_t  swivx_data_char_attr_md;        /**< Initial security level for Data characteristics attribute */
     ble_srv_cccd_security_mode_t  swivx_bat_char_attr_md;         /**< Initial security level for Battery characteristics attribute */
+    ble_srv_cccd_security_mode_t  swivx_filter_char_attr_md;      /**< Initial security level for Filter characteristics attribute */
+    ble_srv_cccd_security_mode_t  swivx_haptic_char_attr_md;      /**< Initial security level for Haptic characteristics attribute */
+    ble_srv_cccd_security_mode_t  swivx_budget_char_attr_md;      /**< Initial security level for Budget characteristics attribute */
+    ble_srv_cccd_security_mode_t  swivx_diag_char_attr_md;        /**< Initial security level for Diagnostics characteristics attribute */
 } ble_swivx_init_t;
 
 /**@brief Custom Service structure. This contains various status information for the service. */
@@ -94,6 +119,10 @@ struct ble_swivx_s
     ble_gatts_char_handles_t      swivx_log_handles;           /**< Handles related to the SwivX Log characteristic. */
     ble_gatts_char_handles_t      swivx_data_handles;          /**< Handles related to the SwivX Data characteristic. */
     ble_gatts_char_handles_t      swivx_bat_handles;           /**< Handles related to the SwivX Battery characteristic. */
+    ble_gatts_char_handles_t      swivx_filter_handles;        /**< Handles related to the SwivX Filter characteristic. */
+    ble_gatts_char_handles_t      swivx_haptic_handles;        /**< Handles related to the SwivX Haptic characteristic. */
+    ble_gatts_char_handles_t      swivx_budget_handles;        /**< Handles related to the SwivX Budget characteristic. */
+    ble_gatts_char_handles_t      swivx_diag_handles;          /**< Handles related to the SwivX Diagnostics characteristic. */
     uint16_t                      conn_handle;                 /**< Handle of the current connection (as provided by the BLE stack, is BLE_CONN_HANDLE_INVALID if not in a connection). */
     uint8_t                       uuid_type; 
 };
@@ -152,20 +181,51 @@ uint32_t ble_swivx_log_packet_send(ble_swivx_t * p_cus, uint8_t * packet_value);
 /** @brief Function to update the GATT database with current settings register values **/
 uint32_t ble_swivx_settings_update(ble_swivx_t * p_cus);
 
-/** @brief Function to update the GATT database with current battery level **/
+/** @brief Function to update the GATT database with current battery level and notify it **/
 uint32_t ble_swivx_bat_value_update(ble_swivx_t * p_cus, uint8_t data_value);
 
+/** @brief Function to update the GATT database with the filter settings in the settings register **/
+uint32_t ble_swivx_filter_update(ble_swivx_t * p_cus);
+
+/** @brief Function to update the GATT database with the alert waveform selection in the settings register **/
+uint32_t ble_swivx_haptic_update(ble_swivx_t * p_cus);
+
+/** @brief Function to update the GATT database with the motor energy budget **/
+uint32_t ble_swivx_budget_update(ble_swivx_t * p_cus);
+
+/** @brief Function to update the GATT database with an energy and CPU time accounting snapshot **/
+uint32_t ble_swivx_diag_update(ble_swivx_t * p_cus);
+
+/**@brief Function for reading the last haptic upload packet from the GATT database.
+ *
+ * @param[in]       p_cus    Custom Service structure.
+ * @param[out]      p_data   Buffer of SWIVX_HAPTIC_CHAR_LEN bytes.
+ * @param[in,out]   p_len    Buffer size in, packet length out.
+ *
+ * @return      NRF_SUCCESS on success, otherwise an error code.
+ */
+uint32_t ble_swivx_haptic_value_get(ble_swivx_t * p_cus, uint8_t * p_data, uint16_t * p_len);
+
 /** static functions declarations **/
 static uint32_t swivx_settings_char_add(ble_swivx_t * p_cus, const ble_swivx_init_t * p_cus_init);
 static uint32_t swivx_mode_char_add(ble_swivx_t * p_cus, const ble_swivx_init_t * p_cus_init);
 static uint32_t swivx_log_char_add(ble_swivx_t * p_cus, const ble_swivx_init_t * p_cus_init);
 static uint32_t swivx_data_char_add(ble_swivx_t * p_cus, const ble_swivx_init_t * p_cus_init);
 static uint32_t swivx_bat_char_add(ble_swivx_t * p_cus, const ble_swivx_init_t * p_cus_init);
+static uint32_t swivx_filter_char_add(ble_swivx_t * p_cus, const ble_swivx_init_t * p_cus_init);
+static uint32_t swivx_haptic_char_add(ble_swivx_t * p_cus, const ble_swivx_init_t * p_cus_init);
+static uint32_t swivx_budget_char_add(ble_swivx_t * p_cus, const ble_swivx_init_t * p_cus_init);
+static uint32_t swivx_diag_char_add(ble_swivx_t * p_cus, const ble_swivx_init_t * p_cus_init);
 static void on_connect(ble_swivx_t * p_cus, ble_evt_t const * p_ble_evt);
 static void on_disconnect(ble_swivx_t * p_cus, ble_evt_t const * p_ble_evt);
 static void on_write(ble_swivx_t * p_cus, ble_evt_t const * p_ble_evt);
+static void on_rw_authorize_request(ble_swivx_t * p_cus, ble_evt_t const * p_ble_evt);
+static void on_hvn_tx_complete(ble_swivx_t * p_cus, ble_evt_t const * p_ble_evt);
+static uint32_t swivx_notify(ble_swivx_t * p_cus, uint16_t value_handle, ble_gatts_value_t * p_value, uint8_t hvn_type);
 static void split_register_to_array(uint8_t * reg_array);
-static void settings_register_write(uint8_t * data_packet);
+static void budget_to_array(uint8_t * budget_array);
+static void diag_to_array(uint8_t * diag_array);
+static void settings_register_write(uint8_t const * data_packet, uint16_t len);
 
 
 #endif
\ No newline at end of file
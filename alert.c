@@ -0,0 +1,173 @@
+/* File: alert.c */
+
+/** C file for the SwivX posture alert policy **/
+
+
+#include "alert.h"
+#include "nrf_log.h"
+#include "custom_board.h"
+#include "epoch.h"
+#include "log.h"
+
+static alert_level_t alert_level = ALERT_LEVEL_NONE;
+static bool is_out_of_range = false;
+static bool is_in_episode = false;
+static bool is_backoff = false;
+static uint64_t episode_start_time = 0;     //First sample out of range
+static uint64_t in_range_time = 0;          //First sample back in range
+static uint64_t backoff_start_time = 0;
+static uint64_t last_alert_time = 0;
+static uint16_t alert_daily_count = 0;
+static uint32_t alert_day = 0;
+
+
+/**@brief Function for resetting the policy. **/
+void alert_reset(void)
+{
+    alert_level = ALERT_LEVEL_NONE;
+    is_out_of_range = false;
+    is_in_episode = false;
+    is_backoff = false;
+}
+
+
+/**@brief Function for passing one filtered angle through the alert policy. **/
+alert_action_t alert_process(uint8_t angle, uint64_t now)
+{
+    uint32_t grace = settings_register.touchDuration;
+    uint32_t elapsed;
+    alert_level_t next_level;
+
+    if(angle >= settings_register.angleMin)
+    {
+        if(is_out_of_range)
+        {
+            //Back in range, the episode ends once it is held for the compliance time
+            is_out_of_range = false;
+            in_range_time = now;
+            return (alert_level > ALERT_LEVEL_NONE) ? ALERT_ACTION_STOP : ALERT_ACTION_NONE;
+        }
+
+        if(is_in_episode && (now - in_range_time) >= ALERT_COMPLIANCE_TIME)
+        {
+            is_in_episode = false;
+            if(alert_level > ALERT_LEVEL_NONE)
+            {
+                NRF_LOG_INFO("Posture corrected at alert level %d", alert_level);
+                is_backoff = true;
+                backoff_start_time = now;
+            }
+            alert_level = ALERT_LEVEL_NONE;
+        }
+
+        return ALERT_ACTION_NONE;
+    }
+
+    is_out_of_range = true;
+    if(!is_in_episode)
+    {
+        is_in_episode = true;
+        episode_start_time = now;
+    }
+
+    //Highest stage already played, wait for the compliance
+    if(alert_level >= ALERT_LEVEL_REPEATED)
+    {
+        return ALERT_ACTION_NONE;
+    }
+
+    if(is_backoff)
+    {
+        if((now - backoff_start_time) < ALERT_BACKOFF_TIMEOUT)
+        {
+            return ALERT_ACTION_NONE;
+        }
+        is_backoff = false;
+    }
+
+    if(grace < ALERT_GRACE_MIN)
+    {
+        grace = ALERT_GRACE_MIN;
+    }
+    else if(grace > ALERT_GRACE_MAX)
+    {
+        grace = ALERT_GRACE_MAX;
+    }
+
+    //Stage reached by the time spent in this episode, one stage per sample at most
+    elapsed = (uint32_t)(now - episode_start_time);
+    if(elapsed < grace)
+    {
+        return ALERT_ACTION_NONE;
+    }
+    next_level = (alert_level_t)(((elapsed - grace) / ALERT_ESCALATE_TIMEOUT) + ALERT_LEVEL_GENTLE);
+    if(next_level <= alert_level)
+    {
+        return ALERT_ACTION_NONE;
+    }
+
+    //Stages are at least the escalation time apart, i.e. after a back-off or a capped stage
+    if(alert_level > ALERT_LEVEL_NONE && (now - last_alert_time) < ALERT_ESCALATE_TIMEOUT)
+    {
+        return ALERT_ACTION_NONE;
+    }
+
+    if(!alert_daily_count_take())
+    {
+        return ALERT_ACTION_NONE;
+    }
+
+    alert_level++;
+    last_alert_time = now;
+    switch(alert_level)
+    {
+        case ALERT_LEVEL_GENTLE:
+            return ALERT_ACTION_GENTLE;
+
+        case ALERT_LEVEL_STRONG:
+            return ALERT_ACTION_STRONG;
+
+        default:
+            return ALERT_ACTION_REPEATED;
+    }
+}
+
+
+/**@brief Function for getting the escalation stage of the current episode. **/
+alert_level_t alert_level_get(void)
+{
+    return alert_level;
+}
+
+
+/**@brief Function for getting the number of alerts fired today. **/
+uint16_t alert_daily_count_get(void)
+{
+    if((epoch_get() / ALERT_SECONDS_PER_DAY) != alert_day)
+    {
+        return 0;
+    }
+
+    return alert_daily_count;
+}
+
+
+/* Counts an alert against the daily cap, false if the cap is reached */
+static bool alert_daily_count_take(void)
+{
+    uint32_t today = epoch_get() / ALERT_SECONDS_PER_DAY;
+
+    if(today != alert_day)
+    {
+        alert_day = today;
+        alert_daily_count = 0;
+    }
+
+    if(alert_daily_count >= ALERT_DAILY_CAP)
+    {
+        return false;
+    }
+
+    alert_daily_count++;
+    return true;
+}
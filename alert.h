@@ -0,0 +1,81 @@
+/* Header file alert.h */
+
+/** Header file for the SwivX posture alert policy **/
+
+
+
+#ifndef ALERT_H
+#define ALERT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//Escalation, the first stage fires after settings_register.touchDuration out of range
+#define ALERT_GRACE_MIN             2000        //Shortest touchDuration, ms
+#define ALERT_GRACE_MAX             120000      //Longest touchDuration, ms
+#define ALERT_ESCALATE_TIMEOUT      15000       //Out of range time between two stages, ms
+
+//Back-off, the posture has to be held in range before the escalation starts over
+#define ALERT_COMPLIANCE_TIME       5000        //In range time that ends an episode, ms
+#define ALERT_BACKOFF_TIMEOUT       60000       //No alert for this long after an alerted episode, ms
+
+//Most alerts (stages fired) per day, the day is taken from the EPOCH time
+#define ALERT_DAILY_CAP             40
+#define ALERT_SECONDS_PER_DAY       86400
+
+/** Escalation stages of an out of range episode **/
+typedef enum
+{
+    ALERT_LEVEL_NONE,
+    ALERT_LEVEL_GENTLE,         //Single low intensity buzz
+    ALERT_LEVEL_STRONG,         //Alert pattern from the settings register, played once
+    ALERT_LEVEL_REPEATED,       //Alert pattern repeated by the motor state machine
+} alert_level_t;
+
+/** Action for the motor after a sample **/
+typedef enum
+{
+    ALERT_ACTION_NONE,
+    ALERT_ACTION_GENTLE,
+    ALERT_ACTION_STRONG,
+    ALERT_ACTION_REPEATED,
+    ALERT_ACTION_STOP,          //Back in range, stop a playing alert
+} alert_action_t;
+
+
+/**@brief Function for resetting the policy, e.g. after sampling was stopped.
+ *
+ * @details The episode is ended without back-off. The daily alert count is kept.
+ */
+void alert_reset(void);
+
+/**@brief Function for passing one filtered angle through the alert policy.
+ *
+ * @details Constant time per sample. An episode starts when the angle drops below
+ *          settings_register.angleMin and escalates one stage at a time while it stays out of
+ *          range. Short returns into range do not end the episode, only ALERT_COMPLIANCE_TIME
+ *          in range does.
+ *
+ * @param[in]   angle   Filtered angle in degrees.
+ * @param[in]   now     ticks_ms_get() time of the sample.
+ *
+ * @return   Action for the motor.
+ */
+alert_action_t alert_process(uint8_t angle, uint64_t now);
+
+/**@brief Function for getting the escalation stage of the current episode. **/
+alert_level_t alert_level_get(void);
+
+/**@brief Function for getting the number of alerts fired today. **/
+uint16_t alert_daily_count_get(void);
+
+/* Static Functions */
+
+/* Count an alert against the daily cap, false if the cap is reached */
+static bool alert_daily_count_take(void);
+
+#endif
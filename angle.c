@@ -0,0 +1,112 @@
+/* File: angle.c */
+
+/** C file for the SwivX fixed-point tilt angle functions **/
+
+
+#include "angle.h"
+
+/* atan(i/32) for i = 0..32 in 1/256 degree */
+static const uint16_t m_atan_lut[(1 << ANGLE_LUT_BITS) + 1] =
+{
+        0,   458,   916,  1371,  1824,  2273,  2719,  3159,
+     3593,  4021,  4443,  4856,  5262,  5660,  6049,  6429,
+     6801,  7163,  7516,  7859,  8193,  8518,  8834,  9141,
+     9439,  9728, 10008, 10280, 10544, 10799, 11047, 11287,
+    11520,
+};
+
+
+/**@brief Function for calculating atan2 in fixed-point degrees. **/
+int16_t angle_atan2(int32_t y, int32_t x)
+{
+    uint32_t ax = (x < 0) ? (uint32_t)(-x) : (uint32_t)x;
+    uint32_t ay = (y < 0) ? (uint32_t)(-y) : (uint32_t)y;
+    int32_t angle;
+
+    if(ax == 0 && ay == 0)
+    {
+        return 0;
+    }
+
+    angle = atan_octant((ay <= ax) ? ay : ax, (ay <= ax) ? ax : ay);
+
+    //Map the octant back to the full circle, still in 1/256 degree
+    if(ay > ax)
+    {
+        angle = (90 << ANGLE_LUT_Q) - angle;
+    }
+    if(x < 0)
+    {
+        angle = (180 << ANGLE_LUT_Q) - angle;
+    }
+    if(y < 0)
+    {
+        angle = -angle;
+    }
+
+    //Round to the output resolution
+    if(angle >= 0)
+    {
+        return (int16_t)((angle + (1 << (ANGLE_LUT_Q - ANGLE_Q - 1))) >> (ANGLE_LUT_Q - ANGLE_Q));
+    }
+    return (int16_t)-((-angle + (1 << (ANGLE_LUT_Q - ANGLE_Q - 1))) >> (ANGLE_LUT_Q - ANGLE_Q));
+}
+
+
+/**@brief Function for calculating the integer square root, rounded down. **/
+uint32_t angle_isqrt(uint32_t value)
+{
+    uint32_t root = 0;
+    uint32_t bit = 1UL << 30;
+
+    while(bit > value)
+    {
+        bit >>= 2;
+    }
+
+    //Digit by digit, one result bit per iteration
+    while(bit != 0)
+    {
+        if(value >= root + bit)
+        {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return root;
+}
+
+
+/**@brief Function for calculating the tilt angle from a raw accelerometer sample. **/
+int16_t angle_tilt(int16_t x, int16_t y, int16_t z)
+{
+    //x^2 + y^2 is at most 2^31, fits unsigned
+    uint32_t sum = (uint32_t)((int32_t)x * x) + (uint32_t)((int32_t)y * y);
+
+    return angle_atan2((int32_t)angle_isqrt(sum), -(int32_t)z);
+}
+
+
+/* atan(num/den) for 0 <= num <= den, den > 0, in 1/256 degree */
+static int32_t atan_octant(uint32_t num, uint32_t den)
+{
+    //Ratio in Q16, num < 2^16 so the shift cannot overflow
+    uint32_t ratio = (num << ANGLE_RATIO_Q) / den;
+    uint32_t index = ratio >> (ANGLE_RATIO_Q - ANGLE_LUT_BITS);
+    uint32_t frac = ratio & ((1UL << (ANGLE_RATIO_Q - ANGLE_LUT_BITS)) - 1);
+
+    if(index >= (1 << ANGLE_LUT_BITS))
+    {
+        return m_atan_lut[1 << ANGLE_LUT_BITS];
+    }
+
+    //Linear interpolation between the two LUT entries
+    return m_atan_lut[index] +
+           (int32_t)(((m_atan_lut[index + 1] - m_atan_lut[index]) * frac) >> (ANGLE_RATIO_Q - ANGLE_LUT_BITS));
+}
@@ -0,0 +1,57 @@
+/* Header file angle.h */
+
+/** Header file for the SwivX fixed-point tilt angle functions **/
+
+
+
+#ifndef ANGLE_H
+#define ANGLE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//Angles are returned in fixed-point degrees, 1/64 degree per LSB
+#define ANGLE_Q                 6
+#define ANGLE_DEG(a)            ((a) << ANGLE_Q)
+
+//atan LUT over one octant, 32 segments with linear interpolation
+#define ANGLE_LUT_BITS          5
+#define ANGLE_LUT_Q             8           //LUT entries in 1/256 degree
+#define ANGLE_RATIO_Q           16          //min/max ratio of the octant reduction
+
+
+/**@brief Function for calculating atan2 in fixed-point degrees.
+ *
+ * @details Integer only, the octant is reduced to atan(min/max) with min/max in [0, 1] which is
+ *          looked up in a 33 entry table. Error is below 0.01 degree.
+ *
+ * @param[in]   y   Y component, any scale, |y| < 2^16.
+ * @param[in]   x   X component, same scale as y, |x| < 2^16.
+ *
+ * @return   Angle in 1/64 degree, -180 to 180 degrees. 0 if x and y are both 0.
+ */
+int16_t angle_atan2(int32_t y, int32_t x);
+
+/**@brief Function for calculating the integer square root, rounded down. **/
+uint32_t angle_isqrt(uint32_t value);
+
+/**@brief Function for calculating the tilt angle from a raw accelerometer sample.
+ *
+ * @details Angle between the Z axis and gravity, atan2(sqrt(x^2 + y^2), -z).
+ *
+ * @param[in]   x, y, z   Raw signed accelerometer output, any range or resolution.
+ *
+ * @return   Tilt in 1/64 degree, 0 to 180 degrees.
+ */
+int16_t angle_tilt(int16_t x, int16_t y, int16_t z);
+
+/* Static Functions */
+
+/* atan of a ratio in [0, 1] from the LUT, in 1/256 degree */
+static int32_t atan_octant(uint32_t num, uint32_t den);
+
+#endif
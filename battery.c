@@ -4,112 +4,278 @@
 
 
 #include "battery.h"
+#include "nrf_saadc.h"
+#include "nrfx_ppi.h"
+#include "sdk_macros.h"
+#include "app_util_platform.h"
+#include "periph.h"
+#include "event.h"
+#include "power.h"
 
+/* RTC2 paces the sampling, RTC0 is the SoftDevice's and RTC1 runs app_timer */
+static const nrfx_rtc_t m_rtc = NRFX_RTC_INSTANCE(BATTERY_RTC_INSTANCE_ID);
+static nrf_ppi_channel_t m_ppi_start;       //RTC COMPARE0 -> SAADC START
+static nrf_ppi_channel_t m_ppi_sample;      //SAADC STARTED -> SAADC SAMPLE
 
+/* EasyDMA buffer, one result per START so the SAADC stops again after each conversion */
+static nrf_saadc_value_t m_result;
+static uint32_t sample_sum = 0;             //Burst being collected, SAADC interrupt only
+static uint16_t sample_count = 0;
+static uint16_t sample_charging = 0;
+static uint32_t burst_sum = 0;              //Sum of the last burst, written by the SAADC interrupt
+static uint16_t burst_count = 0;
+static uint16_t burst_charging = 0;         //Samples of the last burst taken while charging
+static bool is_first_sample = true;         //Published on its own for a level right after init
+static uint16_t battery_mv = 0;
+static bool is_monitor_running = false;
 
-/** @brief Function to initialize the SAADC for Battery Level reading */
+/* Discharge curve of the rested cell, levels between the points are interpolated */
+static const battery_curve_point_t m_discharge_curve[] =
+{
+    {3000, 0}, {3300, 5}, {3600, 10}, {3700, 20}, {3750, 30}, {3790, 40},
+    {3830, 50}, {3870, 60}, {3920, 70}, {3970, 80}, {4100, 90}, {4200, 100}
+};
+
+
+/** @brief Function to start the battery monitor */
 uint32_t battery_level_init(void)
 {
     ret_code_t err_code;
+    nrfx_rtc_config_t rtc_config = NRFX_RTC_DEFAULT_CONFIG;
 
-    nrfx_saadc_config_t saadc_config = NRFX_SAADC_DEFAULT_CONFIG;
-    nrf_saadc_channel_config_t channel_config = NRFX_SAADC_DEFAULT_CHANNEL_CONFIG_SE(BATTER_LEVEL_INPUT_PIN);
+    periph_register(PERIPH_SAADC, battery_saadc_power);
 
-    err_code = nrfx_saadc_init(&saadc_config, battery_level_evt_handler);
-    if(err_code != NRF_SUCCESS)
-    {
-        return err_code;
-    }
+    //Enabled but stopped between conversions, the SAADC only draws current from START to END
+    err_code = periph_acquire(PERIPH_SAADC);
+    VERIFY_SUCCESS(err_code);
 
-    err_code = nrfx_saadc_channel_init(BATTER_LEVEL_INPUT_PIN, &channel_config);
-    if(err_code != NRF_SUCCESS)
-    {
-        return err_code;
-    }
+    rtc_config.prescaler = RTC_FREQ_TO_PRESCALER(BATTERY_RTC_FREQ);
+    err_code = nrfx_rtc_init(&m_rtc, &rtc_config, battery_rtc_handler);
+    VERIFY_SUCCESS(err_code);
 
-}
+    //Compare event for PPI only, no interrupt. The counter free runs, capsense shares it
+    err_code = nrfx_rtc_cc_set(&m_rtc, BATTERY_RTC_CC, BATTERY_SAMPLE_PERIOD_S * BATTERY_RTC_FREQ, false);
+    VERIFY_SUCCESS(err_code);
 
-/** @brief Function to uninitialize the SAADC for Battery level Reading */
-void battery_level_uninit(void)
-{
-    //Disable all channels and uninit the SAADC
-    nrfx_saadc_uninit();
+    //COMPARE0 -> SAADC start, the END interrupt sets the next compare
+    err_code = nrfx_ppi_channel_alloc(&m_ppi_start);
+    VERIFY_SUCCESS(err_code);
+
+    err_code = nrfx_ppi_channel_assign(m_ppi_start,
+                                       nrfx_rtc_event_address_get(&m_rtc, NRF_RTC_EVENT_COMPARE_0),
+                                       nrf_saadc_task_address_get(NRF_SAADC_TASK_START));
+    VERIFY_SUCCESS(err_code);
+
+    //STARTED -> SAADC sample, the result ends the conversion and the SAADC stops by itself
+    err_code = nrfx_ppi_channel_alloc(&m_ppi_sample);
+    VERIFY_SUCCESS(err_code);
+
+    err_code = nrfx_ppi_channel_assign(m_ppi_sample,
+                                       nrf_saadc_event_address_get(NRF_SAADC_EVENT_STARTED),
+                                       nrf_saadc_task_address_get(NRF_SAADC_TASK_SAMPLE));
+    VERIFY_SUCCESS(err_code);
+
+    err_code = nrfx_ppi_channel_enable(m_ppi_sample);
+    VERIFY_SUCCESS(err_code);
+
+    err_code = nrfx_ppi_channel_enable(m_ppi_start);
+    VERIFY_SUCCESS(err_code);
+
+    nrfx_rtc_enable(&m_rtc);
+    is_monitor_running = true;
+
+    //First level right away for the budget and the power state
+    nrf_saadc_task_trigger(NRF_SAADC_TASK_START);
+
+    return NRF_SUCCESS;
 }
 
 
-/** @brief Function for calculating the battery percent level */
+/** @brief Function for calculating the battery percent level from the last burst */
 uint8_t battery_level_update(void)
 {
-    ret_code_t err_code;
-    uint16_t bat_lvl_16 = 0;
-    uint8_t bat_level_value = 0;
-    nrf_saadc_value_t bat_value_adc;
+    uint32_t sum;
+    uint16_t count;
+    uint16_t charging;
+    int32_t mv;
 
-    err_code = nrfx_saadc_sample_convert(BATTER_LEVEL_INPUT_PIN, &bat_value_adc);
-    APP_ERROR_CHECK(err_code);
+    CRITICAL_REGION_ENTER();
+    sum = burst_sum;
+    count = burst_count;
+    charging = burst_charging;
+    CRITICAL_REGION_EXIT();
 
-    bat_lvl_16 = (((bat_value_adc * ADC_REF)/ADC_RESOLUTION) * ADC_GAIN)*2;
-    //printf("Battery level %d\r\n", bat_lvl_16);
-
-    //Battery level set statments
-    if(bat_lvl_16 <= 3000)
-    {
-        bat_level_value = 0;
-    }
-    else if(bat_lvl_16 <= 3300)
-    {
-        bat_level_value = 5;
-    }
-    else if(bat_lvl_16 <= 3600)
+    if(count == 0)
     {
-        bat_level_value = 10;
+        return battery_curve_level(battery_mv);
     }
-    else if(bat_lvl_16 <= 3700)
+
+    //Scaled in one step and rounded once, 14bit readings of 3.6V full scale times the divider
+    mv = (int32_t)(((sum * (ADC_REF * ADC_GAIN * BATTERY_DIV_SCALE)) + (((uint32_t)count * ADC_RESOLUTION) / 2))
+                   / ((uint32_t)count * ADC_RESOLUTION));
+
+    //Samples are taken asleep with the motor paused, the charger is the only load that moves the
+    //terminal voltage. It rises by the charge current on the samples taken while charging
+    mv -= (int32_t)(((uint32_t)charging * BATTERY_CHARGE_UA / 1000) * BATTERY_R_INTERNAL_MOHM / 1000) / count;
+
+    battery_mv = (mv > 0) ? (uint16_t)mv : 0;
+
+    return battery_curve_level(battery_mv);
+}
+
+
+/** @brief Function for getting the charger compensated battery voltage of the last burst in mV */
+uint16_t battery_mv_get(void)
+{
+    return battery_mv;
+}
+
+
+/** @brief Function for pausing the sampling while a large load runs */
+void battery_load_set(bool is_loaded)
+{
+    if(!is_monitor_running)
     {
-        bat_level_value = 20;
+        return;
     }
-    else if(bat_lvl_16 <= 3750)
+
+    if(is_loaded)
     {
-        bat_level_value = 30;
+        (void)nrfx_ppi_channel_disable(m_ppi_start);
     }
-    else if(bat_lvl_16 <= 3790)
+    else
     {
-        bat_level_value = 40;
+        //Full period of rest before the next sample
+        battery_schedule_next();
+        (void)nrfx_ppi_channel_enable(m_ppi_start);
     }
-    else if(bat_lvl_16 <= 3830)
+}
+
+
+/** @brief Function for powering the SAADC up and down, called by the resource manager */
+static uint32_t battery_saadc_power(bool is_on)
+{
+    //16 conversions averaged in hardware, burst runs them all on one sample task
+    nrf_saadc_channel_config_t const channel_config =
     {
-        bat_level_value = 50;
-    }
-    else if(bat_lvl_16 <= 3870)
+        .resistor_p = NRF_SAADC_RESISTOR_DISABLED,
+        .resistor_n = NRF_SAADC_RESISTOR_DISABLED,
+        .gain       = NRF_SAADC_GAIN1_6,
+        .reference  = NRF_SAADC_REFERENCE_INTERNAL,
+        .acq_time   = NRF_SAADC_ACQTIME_10US,       //Divider source impedance 50k
+        .mode       = NRF_SAADC_MODE_SINGLE_ENDED,
+        .burst      = NRF_SAADC_BURST_ENABLED,
+        .pin_p      = BATTER_LEVEL_INPUT_PIN,
+        .pin_n      = NRF_SAADC_INPUT_DISABLED
+    };
+
+    if(!is_on)
     {
-        bat_level_value = 60;
+        //Stop a conversion in flight, then disconnect the input and disable
+        NRFX_IRQ_DISABLE(SAADC_IRQn);
+        nrf_saadc_int_disable(NRF_SAADC_INT_ALL);
+        nrf_saadc_task_trigger(NRF_SAADC_TASK_STOP);
+        nrf_saadc_channel_input_set(BATTERY_SAADC_CHANNEL, NRF_SAADC_INPUT_DISABLED, NRF_SAADC_INPUT_DISABLED);
+        nrf_saadc_disable();
+        return NRF_SUCCESS;
     }
-    else if(bat_lvl_16 <= 3920)
+
+    //Driven by the HAL, the nrfx driver starts the SAADC ahead of the sample task or samples
+    //from its STARTED interrupt, here PPI does both and only END interrupts
+    nrf_saadc_resolution_set(NRF_SAADC_RESOLUTION_14BIT);
+    nrf_saadc_oversample_set(NRF_SAADC_OVERSAMPLE_16X);
+    nrf_saadc_channel_init(BATTERY_SAADC_CHANNEL, &channel_config);
+    nrf_saadc_buffer_init(&m_result, 1);
+
+    nrf_saadc_event_clear(NRF_SAADC_EVENT_END);
+    nrf_saadc_int_enable(NRF_SAADC_INT_END);
+    NRFX_IRQ_PRIORITY_SET(SAADC_IRQn, APP_IRQ_PRIORITY_LOW);
+    NRFX_IRQ_ENABLE(SAADC_IRQn);
+
+    nrf_saadc_enable();
+
+    return NRF_SUCCESS;
+}
+
+
+/** @brief Function for the SAADC interrupt, one per conversion */
+void SAADC_IRQHandler(void)
+{
+    if(!nrf_saadc_event_check(NRF_SAADC_EVENT_END))
     {
-        bat_level_value = 70;
+        return;
     }
-    else if(bat_lvl_16 <= 3970)
+    nrf_saadc_event_clear(NRF_SAADC_EVENT_END);
+    battery_schedule_next();
+
+    //Single ended readings can dip below 0 around ground
+    if(m_result > 0)
     {
-        bat_level_value = 80;
+        sample_sum += (uint32_t)m_result;
     }
-    else if(bat_lvl_16 <= 4100)
+    sample_count++;
+
+    //Load at the time of the sample, read right after the conversion
+    if(power_is_charging())
     {
-        bat_level_value = 90;
+        sample_charging++;
     }
-    else
+
+    if(sample_count < BATTERY_BURST_SIZE && !is_first_sample)
     {
-        bat_level_value = 100;
+        return;
     }
 
-  return bat_level_value;
+    burst_sum = sample_sum;
+    burst_count = sample_count;
+    burst_charging = sample_charging;
+    sample_sum = 0;
+    sample_count = 0;
+    sample_charging = 0;
+    is_first_sample = false;
+
+    event_post(EVENT_BATTERY);
 }
 
 
+/** @brief Function for setting the next sample a whole period from now */
+static void battery_schedule_next(void)
+{
+    uint32_t next = nrfx_rtc_counter_get(&m_rtc) + (BATTERY_SAMPLE_PERIOD_S * BATTERY_RTC_FREQ);
 
+    (void)nrfx_rtc_cc_set(&m_rtc, BATTERY_RTC_CC, next & NRF_RTC_COUNTER_MAX, false);
+}
 
 
-/** @brief Function ofr the SAADC handler */
-static void battery_level_evt_handler(nrfx_saadc_evt_t const * p_evt)
+/** @brief Function for the RTC handler, no RTC interrupts are enabled */
+static void battery_rtc_handler(nrfx_rtc_int_type_t int_type)
 {
-    //Do nothing, not needed, but required for initialization
-}
\ No newline at end of file
+}
+
+
+/** @brief Function for mapping a voltage to a level on the discharge curve */
+static uint8_t battery_curve_level(uint16_t mv)
+{
+    uint8_t count = sizeof(m_discharge_curve) / sizeof(m_discharge_curve[0]);
+    uint8_t i;
+
+    if(mv <= m_discharge_curve[0].mv)
+    {
+        return m_discharge_curve[0].level;
+    }
+
+    for(i = 1; i < count; i++)
+    {
+        if(mv < m_discharge_curve[i].mv)
+        {
+            battery_curve_point_t const * p_lo = &m_discharge_curve[i - 1];
+            battery_curve_point_t const * p_hi = &m_discharge_curve[i];
+            uint32_t span = p_hi->mv - p_lo->mv;
+
+            //Linear between the points, rounded
+            return p_lo->level + (uint8_t)((((uint32_t)(mv - p_lo->mv) * (p_hi->level - p_lo->level)) + (span / 2)) / span);
+        }
+    }
+
+    return m_discharge_curve[count - 1].level;
+}
@@ -16,24 +16,73 @@ extern "C" {
 #include "nrf_gpio.h"
 #include "nrf_log.h"
 #include "app_timer.h"
-#include "nrfx_saadc.h"
+#include "nrf_saadc.h"
+#include "nrfx_rtc.h"
 
 #define BATTER_LEVEL_INPUT_PIN  NRF_SAADC_INPUT_AIN5
+#define BATTERY_SAADC_CHANNEL   0
 #define BATTERY_DIV_SCALE       2     //Voltage divider from the battery resistors (both 100k)
 #define ADC_GAIN                6     //ADC gain is 1/6
-#define ADC_RESOLUTION          4096  //12bit ADC resolution setting
+#define ADC_RESOLUTION          16384 //14bit ADC resolution setting
 #define ADC_REF                 600   //ADC reference voltage
 
-/** @brief Function to initialize the SAADC for reading the battery voltage */
-uint32_t battery_level_init(void);
+//Sampling schedule, RTC2 COMPARE0 starts the SAADC through PPI and STARTED triggers the
+//conversion on a second PPI channel. RTC2 free runs, its other compares are free for capsense
+#define BATTERY_RTC_INSTANCE_ID 2
+#define BATTERY_RTC_CC          0
+#define BATTERY_RTC_FREQ        8     //Hz, slowest RTC2 tick
+#define BATTERY_SAMPLE_PERIOD_S 15
+#define BATTERY_BURST_SIZE      4     //Conversions per level update, one per period
+
+//Charger compensation, the curve is for the rested cell. The sleep and LED currents at sample time
+//are below 1mA, under 0.25mV across the cell resistance, and are not compensated
+#define BATTERY_R_INTERNAL_MOHM 250   //Cell, protection and divider path resistance
+#define BATTERY_CHARGE_UA       100000 //Charger constant current, raises the terminal voltage
+
+/** Point of the discharge curve, ordered by voltage **/
+typedef struct
+{
+    uint16_t mv;
+    uint8_t level;              //Percent
+} battery_curve_point_t;
 
-/** @brief Function for uninitializing the SAADC */
-void battery_level_uninit(void);
 
-/** @brief Function for calculating the battery percent level */
+/** @brief Function to start the battery monitor
+ *
+ * @details Starts a first reading right away, then the SAADC samples on the RTC2 schedule without
+ *          the CPU. It is only started for a conversion, the END interrupt adds the result up.
+ *          EVENT_BATTERY is posted for the first reading and then once every BATTERY_BURST_SIZE
+ *          samples.
+ *
+ * @return   NRF_SUCCESS on success, otherwise an error code.
+ */
+uint32_t battery_level_init(void);
+
+/** @brief Function for calculating the battery percent level from the last burst */
 uint8_t battery_level_update(void);
 
-/** @brief Function ofr the SAADC handler */
-static void battery_level_evt_handler(nrfx_saadc_evt_t const * p_evt);
+/** @brief Function for getting the charger compensated battery voltage of the last burst in mV */
+uint16_t battery_mv_get(void);
+
+/** @brief Function for pausing the sampling while a large load, i.e. the motor, runs.
+ *
+ * @details Interrupt safe. The schedule restarts when the load ends, the next sample is a whole
+ *          period after it so the cell has recovered.
+ *
+ * @param[in]   is_loaded   true while the load runs.
+ */
+void battery_load_set(bool is_loaded);
 
-#endif
\ No newline at end of file
+/** @brief Function for powering the SAADC up and down */
+static uint32_t battery_saadc_power(bool is_on);
+
+/** @brief Function for setting the next sample a whole period from now */
+static void battery_schedule_next(void);
+
+/** @brief Function for the RTC handler, no RTC interrupts are enabled */
+static void battery_rtc_handler(nrfx_rtc_int_type_t int_type);
+
+/** @brief Function for mapping a voltage to a level on the discharge curve */
+static uint8_t battery_curve_level(uint16_t mv);
+
+#endif
@@ -0,0 +1,139 @@
+/* File: budget.c */
+
+/** C file for the SwivX motor energy budget **/
+
+
+#include "budget.h"
+#include "nrf_log.h"
+#include "app_util_platform.h"
+#include "epoch.h"
+
+static uint8_t battery_level = 100;
+static budget_band_t budget_band = BUDGET_BAND_FULL;
+static uint32_t motor_used_ms = 0;          //Today's motor on-time at full duty
+static uint16_t throttled_count = 0;        //Alerts not played today
+static uint32_t budget_day = 0;
+
+
+/**@brief Function for setting the battery level the budget is derived from. **/
+bool budget_battery_set(uint8_t level)
+{
+    budget_band_t band;
+
+    battery_level = level;
+
+    if(level < BUDGET_BATTERY_RESERVE)
+    {
+        band = BUDGET_BAND_RESERVE;
+    }
+    else if(level < BUDGET_BATTERY_FULL)
+    {
+        band = BUDGET_BAND_LOW;
+    }
+    else
+    {
+        band = BUDGET_BAND_FULL;
+    }
+
+    if(band == budget_band)
+    {
+        return false;
+    }
+
+    NRF_LOG_INFO("Motor budget band %d, battery %d%%", band, level);
+    budget_band = band;
+    return true;
+}
+
+
+/**@brief Function for getting the current battery band. **/
+budget_band_t budget_band_get(void)
+{
+    return budget_band;
+}
+
+
+/**@brief Function for checking if an alert may be played. **/
+bool budget_alert_allow(void)
+{
+    if(budget_band == BUDGET_BAND_RESERVE || budget_remaining_get() == 0)
+    {
+        CRITICAL_REGION_ENTER();
+        throttled_count++;
+        CRITICAL_REGION_EXIT();
+        return false;
+    }
+
+    return true;
+}
+
+
+/**@brief Function for scaling a motor intensity to the battery band. **/
+uint8_t budget_intensity_scale(uint8_t intensity)
+{
+    if(budget_band == BUDGET_BAND_FULL)
+    {
+        return intensity;
+    }
+
+    return (uint8_t)(((uint16_t)intensity * BUDGET_LOW_INTENSITY) / 100);
+}
+
+
+/**@brief Function for charging motor on-time to the budget. **/
+void budget_motor_charge(uint32_t on_ms)
+{
+    budget_day_update();
+
+    CRITICAL_REGION_ENTER();
+    motor_used_ms += on_ms;
+    CRITICAL_REGION_EXIT();
+}
+
+
+/**@brief Function for getting today's remaining motor on-time at full duty in ms. **/
+uint32_t budget_remaining_get(void)
+{
+    uint32_t daily = BUDGET_DAILY_MOTOR_MS;
+
+    budget_day_update();
+
+    if(budget_band != BUDGET_BAND_FULL)
+    {
+        daily = (daily * BUDGET_LOW_DAILY) / 100;
+    }
+
+    return (motor_used_ms < daily) ? (daily - motor_used_ms) : 0;
+}
+
+
+/**@brief Function for getting the number of alerts throttled today. **/
+uint16_t budget_throttled_get(void)
+{
+    budget_day_update();
+
+    return throttled_count;
+}
+
+
+/**@brief Function for getting the last battery level in percent. **/
+uint8_t budget_battery_get(void)
+{
+    return battery_level;
+}
+
+
+/* Starts a new day of budget if the EPOCH day changed */
+static void budget_day_update(void)
+{
+    uint32_t today = epoch_get() / BUDGET_SECONDS_PER_DAY;
+
+    CRITICAL_REGION_ENTER();
+    if(today != budget_day)
+    {
+        budget_day = today;
+        motor_used_ms = 0;
+        throttled_count = 0;
+    }
+    CRITICAL_REGION_EXIT();
+}
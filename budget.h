@@ -0,0 +1,87 @@
+/* Header file budget.h */
+
+/** Header file for the SwivX motor energy budget **/
+
+
+
+#ifndef BUDGET_H
+#define BUDGET_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//Daily motor on-time at full duty, ~2 mAh a day with a 60 mA coin motor
+#define BUDGET_DAILY_MOTOR_MS       120000
+#define BUDGET_SECONDS_PER_DAY      86400
+
+//Battery bands (percent), below BUDGET_BATTERY_RESERVE the cell is kept for BLE and logging
+#define BUDGET_BATTERY_FULL         50
+#define BUDGET_BATTERY_RESERVE      10
+
+//Motor intensity and daily budget in the low band, percent of the full band values
+#define BUDGET_LOW_INTENSITY        70
+#define BUDGET_LOW_DAILY            50
+
+/** Battery bands, higher is more restricted **/
+typedef enum
+{
+    BUDGET_BAND_FULL,           //Full intensity and budget
+    BUDGET_BAND_LOW,            //Reduced intensity and budget, alerts are not repeated
+    BUDGET_BAND_RESERVE,        //No alerts
+} budget_band_t;
+
+
+/**@brief Function for setting the battery level the budget is derived from.
+ *
+ * @param[in]   level   Battery level in percent.
+ *
+ * @return   true if the battery band changed, compiled motor patterns have to be rebuilt.
+ */
+bool budget_battery_set(uint8_t level);
+
+/**@brief Function for getting the current battery band. **/
+budget_band_t budget_band_get(void);
+
+/**@brief Function for checking if an alert may be played.
+ *
+ * @details An alert that is not allowed is counted as throttled.
+ *
+ * @return   false if the battery is in the reserve band or today's budget is used up.
+ */
+bool budget_alert_allow(void);
+
+/**@brief Function for scaling a motor intensity to the battery band.
+ *
+ * @param[in]   intensity   Intensity in percent.
+ *
+ * @return   Scaled intensity in percent.
+ */
+uint8_t budget_intensity_scale(uint8_t intensity);
+
+/**@brief Function for charging motor on-time to the budget.
+ *
+ * @details Interrupt safe, called when the motor driver is switched off.
+ *
+ * @param[in]   on_ms   On-time at full duty in ms.
+ */
+void budget_motor_charge(uint32_t on_ms);
+
+/**@brief Function for getting today's remaining motor on-time at full duty in ms. **/
+uint32_t budget_remaining_get(void);
+
+/**@brief Function for getting the number of alerts throttled today. **/
+uint16_t budget_throttled_get(void);
+
+/**@brief Function for getting the last battery level in percent. **/
+uint8_t budget_battery_get(void);
+
+/* Static Functions */
+
+/* Start a new day of budget if the EPOCH day changed */
+static void budget_day_update(void);
+
+#endif
@@ -0,0 +1,147 @@
+/* File: button.c */
+
+/** C file for the SwivX power button **/
+
+
+#include "button.h"
+#include "nrf_gpio.h"
+#include "nrf_log.h"
+#include "app_timer.h"
+#include "sdk_macros.h"
+#include "event.h"
+
+APP_TIMER_DEF(m_button_debounce_timer);   //Edge debounce timer
+APP_TIMER_DEF(m_button_long_timer);       //Long press timer
+APP_TIMER_DEF(m_button_double_timer);     //Second press timer
+
+static button_state_t button_state = BUTTON_STATE_RELEASED;
+static bool is_double_pending = false;
+
+
+/**@brief Function for initializing the power button. **/
+uint32_t button_init(void)
+{
+    ret_code_t err_code;
+
+    if(!nrfx_gpiote_is_init())
+    {
+        err_code = nrfx_gpiote_init();
+        VERIFY_SUCCESS(err_code);
+    }
+
+    err_code = app_timer_create(&m_button_debounce_timer, APP_TIMER_MODE_SINGLE_SHOT, button_debounce_timer_handler);
+    VERIFY_SUCCESS(err_code);
+
+    err_code = app_timer_create(&m_button_long_timer, APP_TIMER_MODE_SINGLE_SHOT, button_long_timer_handler);
+    VERIFY_SUCCESS(err_code);
+
+    err_code = app_timer_create(&m_button_double_timer, APP_TIMER_MODE_SINGLE_SHOT, button_double_timer_handler);
+    VERIFY_SUCCESS(err_code);
+
+    //Both edges on the low power PORT event, sense polarity follows the pin level
+    nrfx_gpiote_in_config_t pin_config = NRFX_GPIOTE_CONFIG_IN_SENSE_TOGGLE(false);
+    pin_config.pull = NRF_GPIO_PIN_NOPULL;
+
+    err_code = nrfx_gpiote_in_init(PBOUT, &pin_config, button_pin_handler);
+    VERIFY_SUCCESS(err_code);
+
+    nrfx_gpiote_in_event_enable(PBOUT, true);
+
+    //Pick up a button that is already held, e.g. the press that powered the device on
+    return app_timer_start(m_button_debounce_timer, APP_TIMER_TICKS(BUTTON_DEBOUNCE_TIMEOUT), NULL);
+}
+
+
+/**@brief Function to return true while the button is held down, debounced. **/
+bool button_is_pressed(void)
+{
+    return (button_state != BUTTON_STATE_RELEASED);
+}
+
+
+/* PORT event handler of the button pin, every edge restarts the debounce */
+static void button_pin_handler(nrfx_gpiote_pin_t pin, nrf_gpiote_polarity_t action)
+{
+    ret_code_t err_code;
+
+    err_code = app_timer_stop(m_button_debounce_timer);
+    APP_ERROR_CHECK(err_code);
+
+    err_code = app_timer_start(m_button_debounce_timer, APP_TIMER_TICKS(BUTTON_DEBOUNCE_TIMEOUT), NULL);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/* Debounce timer handler, acts on the settled level */
+static void button_debounce_timer_handler(void * p_context)
+{
+    ret_code_t err_code;
+    bool is_down = (nrf_gpio_pin_read(PBOUT) == BUTTON_ACTIVE_LEVEL);
+
+    if(is_down && button_state == BUTTON_STATE_RELEASED)
+    {
+        button_state = BUTTON_STATE_PRESSED;
+
+        //Second press of a double press, decided on its release
+        if(is_double_pending)
+        {
+            err_code = app_timer_stop(m_button_double_timer);
+            APP_ERROR_CHECK(err_code);
+        }
+
+        err_code = app_timer_start(m_button_long_timer, APP_TIMER_TICKS(BUTTON_LONG_TIMEOUT), NULL);
+        APP_ERROR_CHECK(err_code);
+    }
+    else if(!is_down && button_state != BUTTON_STATE_RELEASED)
+    {
+        err_code = app_timer_stop(m_button_long_timer);
+        APP_ERROR_CHECK(err_code);
+
+        //Release of a long press is not a click
+        if(button_state == BUTTON_STATE_LONG)
+        {
+            button_state = BUTTON_STATE_RELEASED;
+            return;
+        }
+        button_state = BUTTON_STATE_RELEASED;
+
+        if(is_double_pending)
+        {
+            //Second click within the double press time
+            is_double_pending = false;
+            err_code = app_timer_stop(m_button_double_timer);
+            APP_ERROR_CHECK(err_code);
+            event_post(EVENT_BUTTON_DOUBLE);
+        }
+        else
+        {
+            //Wait for a second click before reporting a short press
+            is_double_pending = true;
+            err_code = app_timer_start(m_button_double_timer, APP_TIMER_TICKS(BUTTON_DOUBLE_TIMEOUT), NULL);
+            APP_ERROR_CHECK(err_code);
+        }
+    }
+}
+
+
+/* Long press timer handler, fires while the button is still held */
+static void button_long_timer_handler(void * p_context)
+{
+    if(button_state == BUTTON_STATE_PRESSED)
+    {
+        button_state = BUTTON_STATE_LONG;
+        is_double_pending = false;
+        event_post(EVENT_BUTTON_LONG);
+    }
+}
+
+
+/* Double press timer handler, no second press came */
+static void button_double_timer_handler(void * p_context)
+{
+    if(is_double_pending)
+    {
+        is_double_pending = false;
+        event_post(EVENT_BUTTON_SHORT);
+    }
+}
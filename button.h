@@ -0,0 +1,65 @@
+/* Header file button.h */
+
+/** Header file for the SwivX power button **/
+
+
+
+#ifndef BUTTON_H
+#define BUTTON_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "custom_board.h"
+#include "nrfx_gpiote.h"
+
+//PBOUT is active low
+#define BUTTON_ACTIVE_LEVEL         0
+
+//Press timing, ms
+#define BUTTON_DEBOUNCE_TIMEOUT     30          //Level must be stable this long after the last edge
+#define BUTTON_LONG_TIMEOUT         POWER_OFF_TIMEOUT
+#define BUTTON_DOUBLE_TIMEOUT       DOUBLETAP_TIMEOUT
+
+/** Button press states **/
+typedef enum
+{
+    BUTTON_STATE_RELEASED,
+    BUTTON_STATE_PRESSED,
+    BUTTON_STATE_LONG,          //Long press fired, the release is ignored
+} button_state_t;
+
+
+/**@brief Function for initializing the power button.
+ *
+ * @details The pin uses a low power GPIOTE PORT event, no GPIOTE channel or polling is needed
+ *          while waiting for a press. Edges are debounced by a one-shot app timer, a second timer
+ *          fires the long press while the button is still held and a third waits for the second
+ *          press of a double press. Posts EVENT_BUTTON_SHORT, EVENT_BUTTON_LONG and
+ *          EVENT_BUTTON_DOUBLE. A button held at startup is handled like any other press.
+ *
+ * @return   NRF_SUCCESS on success, otherwise an error code.
+ */
+uint32_t button_init(void);
+
+/**@brief Function to return true while the button is held down, debounced. **/
+bool button_is_pressed(void);
+
+/* Static Functions */
+
+/* PORT event handler of the button pin */
+static void button_pin_handler(nrfx_gpiote_pin_t pin, nrf_gpiote_polarity_t action);
+
+/* Debounce timer handler, acts on the settled level */
+static void button_debounce_timer_handler(void * p_context);
+
+/* Long press timer handler */
+static void button_long_timer_handler(void * p_context);
+
+/* Double press timer handler, no second press came */
+static void button_double_timer_handler(void * p_context);
+
+#endif
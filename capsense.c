@@ -4,38 +4,172 @@
 
 
 #include "capsense.h"
+#include "nrf_gpio.h"
+#include "nrfx_gpiote.h"
+#include "nrfx_ppi.h"
+#include "nrf_rtc.h"
+#include "nrf_pwr_mgmt.h"
+#include "app_util_platform.h"
+#include "battery.h"
+#include "event.h"
+#include "ticks.h"
+#include "periph.h"
+#include "sdk_macros.h"
+#include "trace.h"
 
+//LPCOMP left enabled would wake the device from System OFF on any crossing
+NRF_PWR_MGMT_HANDLER_REGISTER(capsense_shutdown_handler, 1);
+
+static const nrfx_timer_t m_timer = NRFX_TIMER_INSTANCE(CAPSENSE_TIMER_INSTANCE_ID);
+static nrf_ppi_channel_t m_ppi_start;       //RTC COMPARE -> TIMER start, the sampling schedule
+static nrf_ppi_channel_t m_ppi_charge;      //TIMER COMPARE2 -> charge pin high
+static nrf_ppi_channel_t m_ppi_trip;        //LPCOMP UP -> TIMER capture, charge pin low
+static uint32_t timeout_ticks = 0;
 
-/** Threshold for sensor activation **/
-volatile uint32_t threshold_value = 1350; //3000
 static capsense_state_t cap_state = CSENSE_STATE_UNINIT;
+static capsense_wear_t wear_state = CAPSENSE_WEAR_UNKNOWN;
 static bool capsense_driver_is_init = false;
+static uint32_t cal_sum = 0;
+static uint8_t cal_count = 0;
+static int32_t filtered_q4 = 0;             //Readings with 4 fraction bits
+static int32_t baseline_q4 = 0;
+static int8_t wear_count = 0;               //Samples past a wear threshold, negative below the baseline
 bool touch_activated = false;
-uint32_t last_touch_time = 0;
+uint64_t last_touch_time = 0;
 
 
 /**@brief Function for the Capacitive sensing initialization.
  *
- * @details Initializes the Capsense driver.
+ * @details The measurement runs without the CPU: an RTC compare starts the TIMER, the TIMER
+ *          raises the charge pin, the LPCOMP captures the TIMER when the pad crosses VDD/2 and
+ *          drops the charge pin again. Only the end of the measurement interrupts.
  */
  uint32_t capsense_init(void)
  {
     ret_code_t err_code;
-    nrf_drv_csense_config_t csense_config;
+    nrfx_gpiote_out_config_t charge_config = NRFX_GPIOTE_CONFIG_OUT_TASK_TOGGLE(false);
+
+    const nrfx_timer_config_t timer_config = {
+        .frequency          = NRF_TIMER_FREQ_16MHz,
+        .mode               = NRF_TIMER_MODE_TIMER,
+        .bit_width          = NRF_TIMER_BIT_WIDTH_16,
+        .interrupt_priority = APP_IRQ_PRIORITY_LOW,
+        .p_context          = NULL
+    };
+
+    if(capsense_driver_is_init)
+    {
+        return NRF_SUCCESS;
+    }
+
+    if(!nrfx_gpiote_is_init())
+    {
+        err_code = nrfx_gpiote_init();
+        VERIFY_SUCCESS(err_code);
+    }
+
+    //Charge pin is driven by GPIOTE tasks, low discharges the pad
+    err_code = nrfx_gpiote_out_init(C1_CHRGE, &charge_config);
+    VERIFY_SUCCESS(err_code);
+    nrfx_gpiote_out_task_enable(C1_CHRGE);
+
+    err_code = nrfx_timer_init(&m_timer, &timer_config, capsense_handler);
+    VERIFY_SUCCESS(err_code);
+
+    //Timeout ends every measurement, stopped and cleared for the next one
+    timeout_ticks = nrfx_timer_us_to_ticks(&m_timer, CAPSENSE_TIMEOUT_US);
+    nrfx_timer_extended_compare(&m_timer, NRF_TIMER_CC_CHANNEL1, timeout_ticks + CAPSENSE_START_TICKS,
+                                NRF_TIMER_SHORT_COMPARE1_STOP_MASK | NRF_TIMER_SHORT_COMPARE1_CLEAR_MASK, true);
+    nrfx_timer_compare(&m_timer, NRF_TIMER_CC_CHANNEL2, CAPSENSE_START_TICKS, false);
+
+    //The battery RTC paces the measurements, the compare is moved on after each one
+    err_code = nrfx_ppi_channel_alloc(&m_ppi_start);
+    VERIFY_SUCCESS(err_code);
+
+    err_code = nrfx_ppi_channel_assign(m_ppi_start,
+                                       nrf_rtc_event_address_get(CAPSENSE_RTC, CAPSENSE_RTC_EVENT),
+                                       nrfx_timer_task_address_get(&m_timer, NRF_TIMER_TASK_START));
+    VERIFY_SUCCESS(err_code);
 
-    csense_config.output_pin = C1_CHRGE;
+    err_code = nrfx_ppi_channel_alloc(&m_ppi_charge);
+    VERIFY_SUCCESS(err_code);
 
-    err_code = nrf_drv_csense_init(&csense_config, capsense_handler);
-    APP_ERROR_CHECK(err_code);
+    err_code = nrfx_ppi_channel_assign(m_ppi_charge,
+                                       nrfx_timer_event_address_get(&m_timer, NRF_TIMER_EVENT_COMPARE2),
+                                       nrfx_gpiote_set_task_addr_get(C1_CHRGE));
+    VERIFY_SUCCESS(err_code);
 
-    //Pad 0 is set on AIN 3 (pin P05)
-    nrf_drv_csense_channels_enable(PAD_0_MASK);
+    err_code = nrfx_ppi_channel_alloc(&m_ppi_trip);
+    VERIFY_SUCCESS(err_code);
+
+    err_code = nrfx_ppi_channel_assign(m_ppi_trip,
+                                       nrf_lpcomp_event_address_get(NRF_LPCOMP_EVENT_UP),
+                                       nrfx_timer_task_address_get(&m_timer, NRF_TIMER_TASK_CAPTURE0));
+    VERIFY_SUCCESS(err_code);
+
+    err_code = nrfx_ppi_channel_fork_assign(m_ppi_trip, nrfx_gpiote_clr_task_addr_get(C1_CHRGE));
+    VERIFY_SUCCESS(err_code);
+
+    periph_register(PERIPH_CAPSENSE, capsense_power);
+
+    cal_sum = 0;
+    cal_count = 0;
+    wear_count = 0;
+    wear_state = CAPSENSE_WEAR_UNKNOWN;
+
+    //The LPCOMP stays enabled while the schedule runs, it only draws a few hundred nA
+    err_code = periph_acquire(PERIPH_CAPSENSE);
+    VERIFY_SUCCESS(err_code);
 
     capsense_driver_is_init = true;
 
-    return err_code;
+    return NRF_SUCCESS;
  }
 
+/* Powers the LPCOMP and the measurement PPI channels up and down, called by the resource manager */
+static uint32_t capsense_power(bool is_on)
+{
+    ret_code_t err_code;
+
+    const nrf_lpcomp_config_t lpcomp_config = {
+        .reference = CAPSENSE_LPCOMP_REF,
+        .detection = NRF_LPCOMP_DETECT_UP,
+        .hyst      = NRF_LPCOMP_HYST_50mV
+    };
+
+    if(!is_on)
+    {
+        nrf_rtc_event_disable(CAPSENSE_RTC, CAPSENSE_RTC_EVTEN_MASK);
+        (void)nrfx_ppi_channel_disable(m_ppi_start);
+        (void)nrfx_ppi_channel_disable(m_ppi_trip);
+        (void)nrfx_ppi_channel_disable(m_ppi_charge);
+        nrf_lpcomp_task_trigger(NRF_LPCOMP_TASK_STOP);
+        nrf_lpcomp_disable();
+        return NRF_SUCCESS;
+    }
+
+    //Analog input, the digital buffer would draw current around VDD/2
+    nrf_gpio_cfg_default(CAP_IN);
+
+    //No LPCOMP interrupt, the UP event only goes to PPI
+    nrf_lpcomp_configure(&lpcomp_config);
+    nrf_lpcomp_input_select(CAPSENSE_LPCOMP_INPUT);
+    nrf_lpcomp_enable();
+    nrf_lpcomp_task_trigger(NRF_LPCOMP_TASK_START);
+
+    err_code = nrfx_ppi_channel_enable(m_ppi_charge);
+    VERIFY_SUCCESS(err_code);
+
+    err_code = nrfx_ppi_channel_enable(m_ppi_trip);
+    VERIFY_SUCCESS(err_code);
+
+    //Schedule runs from the next compare
+    capsense_schedule_next();
+    nrf_rtc_event_enable(CAPSENSE_RTC, CAPSENSE_RTC_EVTEN_MASK);
+
+    return nrfx_ppi_channel_enable(m_ppi_start);
+}
+
 /** @brief Function to return capsense driver init status **/
 bool capsense_is_init(void)
 {
@@ -44,62 +178,201 @@ bool capsense_is_init(void)
 
 /**@brief Function for the Capacitive sensing uninitialization.
  *
- * @details Uninitializes the Capsense driver.
+ * @details Drops the reference on the Capsense block, the schedule and the LPCOMP are stopped
+ *          from the main loop.
  */
 void capsense_uninit(void)
 {
-    ret_code_t err_code = nrf_drv_csense_uninit();
-    capsense_driver_is_init = false;
+    if(capsense_driver_is_init)
+    {
+        periph_release(PERIPH_CAPSENSE);
+        capsense_driver_is_init = false;
+    }
 }
 
 
-/**@brief Function for the sampling the Capcitive sensor.
- *
- * @details samples the capacitive sensor.
- */
-void capsense_sample(void)
+/**@brief Function for getting the wear state. **/
+capsense_wear_t capsense_wear_get(void)
 {
-    ret_code_t err_code;
-    if(!nrf_drv_csense_is_busy())
+    return wear_state;
+}
+
+
+/**@brief Function to return false only while the device is known to be off the body. **/
+bool capsense_is_worn(void)
+{
+    return (wear_state != CAPSENSE_WEAR_OFF);
+}
+
+
+/* Moves the RTC compare on by the interval of the wear state, the next measurement starts there */
+static void capsense_schedule_next(void)
+{
+    uint32_t interval = (wear_state == CAPSENSE_WEAR_OFF) ? CAPSENSE_INTERVAL_UNWORN : CAPSENSE_INTERVAL_WORN;
+    uint32_t next = nrf_rtc_counter_get(CAPSENSE_RTC) + CAPSENSE_MS_TO_RTC(interval);
+
+    nrf_rtc_cc_set(CAPSENSE_RTC, CAPSENSE_RTC_CC, next & NRF_RTC_COUNTER_MAX);
+}
+
+
+/* Shutdown handler, the LPCOMP is powered down before System OFF */
+static bool capsense_shutdown_handler(nrf_pwr_mgmt_evt_t event)
+{
+    //Directly, the resource manager would only power it down from the main loop
+    if(periph_is_powered(PERIPH_CAPSENSE))
     {
-        err_code = nrf_drv_csense_sample();
-        APP_ERROR_CHECK(err_code);
+        (void)capsense_power(false);
+
+        //A measurement in flight would leave the pad charging
+        nrfx_timer_pause(&m_timer);
+        nrfx_gpiote_clr_task_trigger(C1_CHRGE);
     }
+
+    return true;
 }
 
 
- /**@brief Function for the Capacitive sensing Handler.
+ /**@brief Function for the measurement TIMER handler.
  *
- * @param[in]   p_event_struct - csense driver event
+ * @param[in]   event_type   TIMER event, the timeout compare ends a measurement.
  *
- * @details Handles the capsense events.
+ * @details Reads the charge time and runs the engine, no logging in the interrupt.
  */
-static void capsense_handler(nrf_drv_csense_evt_t * p_event_struct)
+static void capsense_handler(nrf_timer_event_t event_type, void * p_context)
 {
-    switch(p_event_struct->analog_channel)
+    uint32_t capture;
+    uint32_t reading;
+
+    if(event_type != NRF_TIMER_EVENT_COMPARE1)
     {
-        case AIN_3:
-            printf("Capacitive sensor value: %d \n", p_event_struct->read_value);
-            if(p_event_struct->read_value >= threshold_value && cap_state != CSENSE_STATE_PRESSED)
+        return;
+    }
+
+    //Discharge, also when the LPCOMP did not trip
+    nrfx_gpiote_clr_task_trigger(C1_CHRGE);
+
+    capture = nrfx_timer_capture_get(&m_timer, NRF_TIMER_CC_CHANNEL0);
+    reading = (capture > CAPSENSE_START_TICKS) ? (capture - CAPSENSE_START_TICKS) : timeout_ticks;
+
+    //The TIMER clear leaves the capture, zero is read next time if the LPCOMP never trips
+    nrfx_timer_compare(&m_timer, NRF_TIMER_CC_CHANNEL0, 0, false);
+
+    //Next start from the RTC, after the engine in case the wear state changes
+    capsense_process(reading);
+    capsense_schedule_next();
+}
+
+
+/* Adaptive baseline, touch and wear engine, runs on every reading */
+static void capsense_process(uint32_t reading)
+{
+    int32_t delta;
+
+    //The first readings average to the baseline
+    if(cal_count < CAPSENSE_CAL_SAMPLES)
+    {
+        cal_sum += reading;
+        cal_count++;
+
+        if(cal_count == CAPSENSE_CAL_SAMPLES)
+        {
+            baseline_q4 = (int32_t)((cal_sum << 4) / CAPSENSE_CAL_SAMPLES);
+            filtered_q4 = baseline_q4;
+
+            //No pad or the pad never charges, the power state stays on motion only
+            if((cal_sum / CAPSENSE_CAL_SAMPLES) >= timeout_ticks)
             {
-                cap_state = CSENSE_STATE_PRESSED;
-                touch_activated = true;
-                last_touch_time = millis();
-                printf("Sensor pressed \n");
+                capsense_uninit();
             }
-            else if (p_event_struct->read_value < threshold_value && cap_state == CSENSE_STATE_PRESSED)
+        }
+        return;
+    }
+
+    //Low pass, then the distance from the baseline
+    filtered_q4 += (((int32_t)reading << 4) - filtered_q4) >> CAPSENSE_FILTER_SHIFT;
+    delta = (filtered_q4 - baseline_q4) >> 4;
+    TRACE(TRACE_CAPSENSE, reading, delta, wear_state);
+
+    //Touch, hysteresis between the press and release thresholds
+    if(cap_state != CSENSE_STATE_PRESSED && delta >= CAPSENSE_TOUCH_ON_DELTA)
+    {
+        cap_state = CSENSE_STATE_PRESSED;
+        touch_activated = true;
+        last_touch_time = ticks_ms_get();
+        event_post(EVENT_TOUCH);
+    }
+    else if(cap_state == CSENSE_STATE_PRESSED && delta < CAPSENSE_TOUCH_OFF_DELTA)
+    {
+        cap_state = CSENSE_STATE_RELEASED;
+        touch_activated = false;
+        last_touch_time = ticks_ms_get();
+    }
+
+    //Wear, debounced in both directions with hysteresis
+    switch(wear_state)
+    {
+        case CAPSENSE_WEAR_ON:
+            wear_count = (delta < CAPSENSE_WEAR_OFF_DELTA) ? (wear_count + 1) : 0;
+            if(wear_count >= CAPSENSE_WEAR_OFF_COUNT)
             {
-                cap_state = CSENSE_STATE_RELEASED;
-                touch_activated = false;
-                last_touch_time = millis();
-                printf("Sensor released \n");
+                capsense_wear_set(CAPSENSE_WEAR_OFF);
             }
             break;
 
-        case AIN_5:
+        case CAPSENSE_WEAR_OFF:
+            wear_count = (delta >= CAPSENSE_WEAR_ON_DELTA) ? (wear_count + 1) : 0;
+            if(wear_count >= CAPSENSE_WEAR_ON_COUNT)
+            {
+                capsense_wear_set(CAPSENSE_WEAR_ON);
+            }
             break;
 
         default:
+            //Calibrated on or off the body, the first clear step either way decides
+            if(delta >= CAPSENSE_WEAR_ON_DELTA)
+            {
+                wear_count = (wear_count > 0) ? (wear_count + 1) : 1;
+            }
+            else if(delta <= -CAPSENSE_WEAR_ON_DELTA)
+            {
+                wear_count = (wear_count < 0) ? (wear_count - 1) : -1;
+            }
+            else
+            {
+                wear_count = 0;
+            }
+
+            if(wear_count >= CAPSENSE_WEAR_ON_COUNT)
+            {
+                capsense_wear_set(CAPSENSE_WEAR_ON);
+            }
+            else if(wear_count <= -CAPSENSE_WEAR_OFF_COUNT)
+            {
+                //Calibrated while worn, the level now is the bare pad
+                baseline_q4 = filtered_q4;
+                capsense_wear_set(CAPSENSE_WEAR_OFF);
+            }
             break;
     }
+
+    //Drift, the baseline is held while worn and follows the bare pad otherwise. Below the
+    //baseline it recovers at once, unless a drop is how an unknown state learns it was worn
+    if(wear_state == CAPSENSE_WEAR_OFF && delta < -CAPSENSE_NOISE_DELTA)
+    {
+        baseline_q4 += (filtered_q4 - baseline_q4) >> CAPSENSE_RECOVER_SHIFT;
+    }
+    else if(wear_state != CAPSENSE_WEAR_ON && delta < CAPSENSE_WEAR_OFF_DELTA && delta > -CAPSENSE_WEAR_OFF_DELTA)
+    {
+        baseline_q4 += (filtered_q4 - baseline_q4) >> CAPSENSE_DRIFT_SHIFT;
+    }
+}
+
+
+/* Changes the wear state, the schedule follows it from the next measurement */
+static void capsense_wear_set(capsense_wear_t state)
+{
+    wear_state = state;
+    wear_count = 0;
+
+    event_post(EVENT_WEAR);
 }
@@ -15,12 +15,40 @@ extern "C" {
 #include <stdbool.h>
 #include <string.h>
 #include "custom_board.h"
-#include "nrf_drv_csense.h"
-
-#define AIN_3           CAP_SENSE1
-#define AIN_5           BAT_SENSE
-#define PAD_0_MASK      (1UL << AIN_3)
-#define BAT_SENSE_MASK  (1UL << AIN_5)
+#include "nrf_lpcomp.h"
+#include "nrf_rtc.h"
+#include "nrf_pwr_mgmt.h"
+#include "nrfx_timer.h"
+
+//Pad on AIN3 (P05), charged through the resistor on C1_CHRGE. The LPCOMP trips at VDD/2, the
+//charge time grows with the pad capacitance so a touch or the skin raises the reading
+#define CAPSENSE_LPCOMP_INPUT       NRF_LPCOMP_INPUT_3
+#define CAPSENSE_LPCOMP_REF         NRF_LPCOMP_REF_SUPPLY_4_8
+#define CAPSENSE_TIMER_INSTANCE_ID  1
+#define CAPSENSE_START_TICKS        2           //TIMER ticks before the charge starts
+#define CAPSENSE_TIMEOUT_US         200         //Longest charge time, a reading that reaches it is saturated
+
+//Sampling schedule, ms. A compare of the battery RTC starts each measurement through PPI
+#define CAPSENSE_RTC                NRF_RTC2
+#define CAPSENSE_RTC_CC             1
+#define CAPSENSE_RTC_EVENT          NRF_RTC_EVENT_COMPARE_1
+#define CAPSENSE_RTC_EVTEN_MASK     NRF_RTC_INT_COMPARE1_MASK
+#define CAPSENSE_MS_TO_RTC(ms)      (((ms) * BATTERY_RTC_FREQ) / 1000)
+#define CAPSENSE_INTERVAL_WORN      250         //Touch response, at least 2 RTC ticks
+#define CAPSENSE_INTERVAL_UNWORN    1000        //Only waits to be put on
+
+//Engine, readings and deltas in 16MHz TIMER ticks
+#define CAPSENSE_CAL_SAMPLES        8           //Averaged for the first baseline
+#define CAPSENSE_FILTER_SHIFT       1           //Reading low pass, weight 1/2
+#define CAPSENSE_DRIFT_SHIFT        6           //Baseline tracking off the body, weight 1/64
+#define CAPSENSE_RECOVER_SHIFT      2           //Baseline tracking below the baseline, weight 1/4
+#define CAPSENSE_NOISE_DELTA        4           //Below the baseline by more than this it recovers
+#define CAPSENSE_WEAR_ON_DELTA      24          //Skin contact
+#define CAPSENSE_WEAR_OFF_DELTA     12
+#define CAPSENSE_TOUCH_ON_DELTA     96          //Finger on the pad
+#define CAPSENSE_TOUCH_OFF_DELTA    64
+#define CAPSENSE_WEAR_ON_COUNT      4           //Samples past the threshold to change the wear state
+#define CAPSENSE_WEAR_OFF_COUNT     8
 
 
 typedef enum
@@ -30,18 +58,31 @@ typedef enum
     CSENSE_STATE_RELEASED,
 } capsense_state_t;
 
+/** Wear detection state **/
+typedef enum
+{
+    CAPSENSE_WEAR_UNKNOWN,      //Not calibrated, disabled or no change seen since boot, taken as worn
+    CAPSENSE_WEAR_OFF,
+    CAPSENSE_WEAR_ON,
+} capsense_wear_t;
+
 extern bool touch_activated;
-extern uint32_t last_touch_time;
+extern uint64_t last_touch_time;
 
 /**@brief Function for the Capacitive sensing initialization.
  *
- * @details Initializes the Capsense driver.
+ * @details Sets up the LPCOMP, TIMER and PPI measurement and starts the sampling schedule on the
+ *          battery RTC, call battery_level_init() first. The
+ *          first CAPSENSE_CAL_SAMPLES readings set the baseline. EVENT_TOUCH is posted on a press
+ *          and EVENT_WEAR when the wear state changes.
+ *
+ * @return   NRF_SUCCESS on success, otherwise an error code.
  */
 uint32_t capsense_init(void);
 
 /**@brief Function for the Capacitive sensing uninitialization.
  *
- * @details Uninitializes the Capsense driver.
+ * @details Stops the schedule and drops the reference on the Capsense block.
  */
 void capsense_uninit(void);
 
@@ -49,20 +90,34 @@ void capsense_uninit(void);
 bool capsense_is_init(void);
 
 
-/**@brief Function for the sampling the Capcitive sensor.
- *
- * @details samples the capacitive sensor.
- */
-void capsense_sample(void);
+/**@brief Function for getting the wear state. **/
+capsense_wear_t capsense_wear_get(void);
 
+/**@brief Function to return false only while the device is known to be off the body. **/
+bool capsense_is_worn(void);
 
-/**@brief Function for the Capacitive sensing Handler.
- *
- * @param[in]   p_event_struct - csense driver event
+
+/**@brief Function for the measurement TIMER handler, runs the engine on the reading.
  *
- * @details Handles the capsense events.
+ * @param[in]   event_type   TIMER event.
+ * @param[in]   p_context    Unused.
  */
-static void capsense_handler(nrf_drv_csense_evt_t * p_event_struct);
+static void capsense_handler(nrf_timer_event_t event_type, void * p_context);
+
+/* Powers the LPCOMP and the measurement PPI channels up and down for the resource manager */
+static uint32_t capsense_power(bool is_on);
+
+/* Sets the RTC compare of the next measurement */
+static void capsense_schedule_next(void);
+
+/* Powers the LPCOMP down before System OFF */
+static bool capsense_shutdown_handler(nrf_pwr_mgmt_evt_t event);
 
+/* Adaptive baseline, touch and wear engine, runs on every reading */
+static void capsense_process(uint32_t reading);
 
-#endif
\ No newline at end of file
+/* Changes the wear state, the schedule follows it */
+static void capsense_wear_set(capsense_wear_t state);
+
+
+#endif
@@ -12,19 +12,21 @@
 #include "capsense.h"
 #include "kxtj3.h"
 #include "log.h"
-
-APP_TIMER_DEF(m_led_timer);       //LED indicator timer
-APP_TIMER_DEF(m_apploop_timer);   //app loop timer
-APP_TIMER_DEF(m_clock_timer);     //Current Time Timer
-
-static led_indicate_t led_ind_state = LED_INDICATE_IDLE;
-static led_indicate_t last_led_state = LED_INDICATE_IDLE;
-static led_indicate_t last_apploop_state = APPLOOP_TIMER_OFF;
-static capsense_state_t cap_state = CSENSE_STATE_UNINIT;
-static bool led_ind_on = false;
-bool take_angle_reading = false;
+#include "event.h"
+#include "ticks.h"
+#include "button.h"
+#include "led.h"
+#include "battery.h"
+
+//Indication patterns, indexed by led_indicate_t. Levels are brightness, mix them for other colours
+static led_pattern_t const m_led_patterns[LED_INDICATE_COUNT] =
+{
+    [LED_INDICATE_ADVERTISING] = { .blue = LED_LEVEL_MAX, .count = LED_PATTERN_LOOP,
+                                   .on_ms = LED_IND_ON_DELAY, .off_ms = LED_IND_OFF_DELAY },
+    [LED_INDICATE_CONNECTED]   = { .green = LED_LEVEL_MAX, .count = 1, .on_ms = LED_IND_CONNECTED_DELAY },
+    [LED_INDICATE_LOW_BATTERY] = { .red = LED_LEVEL_MAX, .count = 1, .on_ms = LED_IND_LOW_BATTERY_DELAY }
+};
 bool is_awake_from_sleep = false;
-bool touch_button_press = false;
 
 
 void custom_board_init(void)
@@ -38,6 +40,14 @@ void custom_board_init(void)
 
     gpio_init();
     timers_init();
+
+    //LED patterns on PWM1, takes the LED pins over from the GPIO
+    err_code = led_init();
+    APP_ERROR_CHECK(err_code);
+
+    //Power button events, replaces polling PBOUT in the main loop
+    err_code = button_init();
+    APP_ERROR_CHECK(err_code);
     //log_fds_init();
 
     #if MOTOR_ENABLE == 1
@@ -48,19 +58,28 @@ void custom_board_init(void)
         kxtj3_init_t m_accel_init = {
             .i2c_scl_pin = SCL_PIN,
             .i2c_sda_pin = SDA_PIN,
+            .int_pin = ACCL_INT,
             .reso_mode = RESO_LOW_8BIT,
-            .range_mode = RANGE_4G
+            .range_mode = RANGE_4G,
+            .odr = ODR_50HZ,
+            .wake_odr = WUF_ODR_12_5HZ,
+            .wake_threshold = ACCL_WAKE_THRESHOLD,
+            .wake_counter = ACCL_WAKE_COUNT
         };
 
         err_code = kxtj3_init(&m_accel_init);
         //APP_ERROR_CHECK(err_code);
     #endif
 
+    //Starts RTC2, the capsense schedule runs on it too
+    err_code = battery_level_init();
+    APP_ERROR_CHECK(err_code);
+
     #if CAPSENSE_ENABLE == 1
-        //capsense_init();
+        //Touch and wear detection on the LPCOMP, samples on the battery RTC
+        err_code = capsense_init();
+        APP_ERROR_CHECK(err_code);
     #endif
-
-    battery_level_init();
 }
 
 
@@ -76,6 +95,7 @@ static void gpio_init()
   nrf_gpio_cfg_output(MOTOR_PWM);
   nrf_gpio_cfg_input(PBOUT, NRF_GPIO_PIN_NOPULL);
   nrf_gpio_cfg_input(CAP_IN, NRF_GPIO_PIN_NOPULL);
+  nrf_gpio_cfg_input(STAT, NRF_GPIO_PIN_PULLUP);    //Open drain, read by the first battery sample
 
   nrf_gpio_pin_set(PSHOLD);
   nrf_gpio_pin_set(LED_R);
@@ -96,24 +116,11 @@ static void timers_init(void)
     uint32_t err_code = app_timer_init();
     APP_ERROR_CHECK(err_code);
 
+    //Monotonic time base, needs app_timer
+    ticks_init();
+
     //Motor Timer
     motor_timer_init();
-
-    // LED timer
-    err_code = app_timer_create(&m_led_timer, APP_TIMER_MODE_SINGLE_SHOT, led_ind_timer_handler);
-    APP_ERROR_CHECK(err_code); 
-
-    //Capacitive sensor timer
-    err_code = app_timer_create(&m_apploop_timer, APP_TIMER_MODE_REPEATED, apploop_timer_handler);
-    APP_ERROR_CHECK(err_code);
-
-    //Clock timer for EPOCH time
-    err_code = app_timer_create(&m_clock_timer, APP_TIMER_MODE_REPEATED, clock_timer_handler);
-    APP_ERROR_CHECK(err_code);
-
-    //Start clock timer
-    err_code = app_timer_start(m_clock_timer, APP_TIMER_TICKS(CLOCK_TIMEOUT), NULL);
-    APP_ERROR_CHECK(err_code);
 }
 
 /**@brief       Configure leds to indicate required state.
@@ -121,166 +128,32 @@ static void timers_init(void)
  */
 uint32_t swivx_led_indication(led_indicate_t indicate)
 {
-    uint32_t err_code   = NRF_SUCCESS;
-    uint32_t next_delay = 0;
-    led_ind_state = indicate;
-    
-    if(last_led_state != indicate)
-    {
-        leds_off();
-        err_code       = app_timer_stop(m_led_timer);
-    }
-    last_led_state = indicate;
-
-    switch (indicate)
+    if(indicate >= LED_INDICATE_COUNT || indicate == LED_INDICATE_IDLE)
     {
-
-        case LED_INDICATE_ADVERTISING:
-            // in advertising blink LED_0
-            if (!led_ind_on)
-            {
-                nrf_gpio_pin_clear(LED_B);
-                next_delay = LED_IND_ON_DELAY;
-                led_ind_on = true;
-            }
-            else
-            {
-                nrf_gpio_pin_set(LED_B);
-                next_delay = LED_IND_OFF_DELAY;
-                led_ind_on = false;
-            }
-
-            err_code       = app_timer_start(m_led_timer, APP_TIMER_TICKS(next_delay), NULL);
-            break;
-            
-        case LED_INDICATE_CONNECTED:
-            if (!led_ind_on)
-            {
-                nrf_gpio_pin_clear(LED_G);
-                next_delay = 1000;
-                led_ind_on = true;
-                err_code       = app_timer_start(m_led_timer, APP_TIMER_TICKS(next_delay), NULL);
-            }
-            else
-            {
-                nrf_gpio_pin_set(LED_G);
-                led_ind_on = false;
-            }
-            break;
-
-        case LED_INDICATE_LOW_BATTERY:
-            if(!led_ind_on)
-            {
-                nrf_gpio_pin_clear(LED_R);
-                next_delay = 500;
-                led_ind_on = true;
-                err_code       = app_timer_start(m_led_timer, APP_TIMER_TICKS(next_delay), NULL);
-            }
-            else
-            {
-                nrf_gpio_pin_set(LED_R);
-                led_ind_on = false;
-            }
-            break;
-
-        default:
-            break;
+        led_stop();
+        return NRF_SUCCESS;
     }
 
-    return err_code;
-}
-
-static void leds_off(void)
-{
-    nrf_gpio_pin_set(LED_G);
-    nrf_gpio_pin_set(LED_R);
-    nrf_gpio_pin_set(LED_B);
-}
-
-static void checkCapsense_Button(void)
-{
-  //Read cap sense input
-  if(nrf_gpio_pin_read(CAP_IN) && cap_state != CSENSE_STATE_PRESSED)
-  {
-    cap_state = CSENSE_STATE_PRESSED;
-    last_touch_time = millis();
-    //NRF_LOG_INFO("touch pressed");
-  }
-  else if(!nrf_gpio_pin_read(CAP_IN) && cap_state == CSENSE_STATE_PRESSED) 
-  {
-     touch_button_press = true;
-     cap_state = CSENSE_STATE_RELEASED;
-     last_touch_time = millis();
-     NRF_LOG_INFO("touch tapped.");
-  }
+    //Patterns play on the LED PWM, the CPU is not woken up for the blinks
+    return led_pattern_play(&m_led_patterns[indicate]);
 }
-/******************** @Timers handlers ********************/
 
-/** LED timer handler **/
-static void led_ind_timer_handler(void *p_context)
-{
-    swivx_led_indication(led_ind_state);
-}
-
-/** Capsense timer handler **/
-static void apploop_timer_handler(void *p_context)
-{
-        //capsense_sample();
-        //checkCapsense_Button();
-        take_angle_reading = true;
-}
-
-/** Clock Timer handler **/
-static void clock_timer_handler(void * p_context)
-{
-    settings_register.timestamp++;
-}
-
-/* Starts the Capsense timer in different modes.
+/* Starts or stops the app loop sampling.
 *
-* @param[in]  mode - Low Power or Active, sets the
-*             samping rate of 100ms or 500ms.
+* @param[in]  mode - Active samples the accelerometer in batches without the app timer,
+*             off stops it. The batch interrupt wakes the app loop.
 */
 void apploop_timer_start_mode(apploop_timer_t mode)
 {
-    ret_code_t err_code;
-
-    if(last_apploop_state != mode)
-    {
-        err_code = app_timer_stop(m_apploop_timer);
-        is_capsense_timer_running = false;
-    }
-
-    last_apploop_state = mode;
-
-    if(mode == APPLOOP_TIMER_ACTIVE)
-    {
-        err_code = app_timer_start(m_apploop_timer, APP_TIMER_TICKS(APP_TIMEOUT_ACTIVE), NULL);
-        APP_ERROR_CHECK(err_code);
-        is_capsense_timer_running = true;
-    }
-    else if(mode == APPLOOP_TIMER_LP)
-    {
-        err_code = app_timer_start(m_apploop_timer, APP_TIMER_TICKS(APP_TIMEOUT_LP), NULL);
-        APP_ERROR_CHECK(err_code);
-        is_capsense_timer_running = true;
-    }
-    else if(mode == APPLOOP_TIMER_OFF)
-    {
-        err_code = app_timer_stop(m_apploop_timer);
-        is_capsense_timer_running = false;
-    }
-}
-
-
-/* millis functions */
-uint32_t millis(void)
-{
-    return(app_timer_cnt_get() / 32.768);
+    #if ACCL_ENABLE == 1
+        if(mode == APPLOOP_TIMER_ACTIVE)
+        {
+            ret_code_t err_code = kxtj3_batch_start();
+            APP_ERROR_CHECK(err_code);
+        }
+        else
+        {
+            kxtj3_batch_stop();
+        }
+    #endif
 }
-
-uint32_t compare_millis(uint32_t previous_millis, uint32_t current_millis)
-{
-    if(current_millis < previous_millis) return(current_millis + OVERFLOW + 1 - previous_millis);
-    return(current_millis - previous_millis);
-}
\ No newline at end of file
@@ -18,13 +18,14 @@ extern "C" {
 
 /** Hardware peripherals enabled **/
 #define MOTOR_ENABLE        1
-#define CAPSENSE_ENABLE     0
+#define CAPSENSE_ENABLE     1
 #define ACCL_ENABLE         1
 
 /** App modes **/
 #define APP_MODE_LP         0
 #define APP_MODE_ACTIVE     1
 #define APP_MODE_REQ_LOG    2
+#define APP_MODE_CALIBRATE  3           //Capture the neutral posture, written to the mode characteristic
 
 
 /* Pinout definitions */
@@ -42,6 +43,7 @@ extern "C" {
 #define C1_CHRGE            11
 #define SCL_PIN             22
 #define SDA_PIN             24
+#define ACCL_INT            23          //KXTJ3 INT, data ready / wake-up
 
 /* Board Support Package */
 #define BUTTONS_NUMBER      0
@@ -51,23 +53,25 @@ extern "C" {
 #define LEDS_INV_MASK         LEDS_MASK
 #define BUTTONS_ACTIVE_STATE  0
 
-//LED timer delays
+//LED pattern timing
 #define LED_IND_ON_DELAY      200
 #define LED_IND_OFF_DELAY     800
+#define LED_IND_CONNECTED_DELAY     1000
+#define LED_IND_LOW_BATTERY_DELAY   500
 
 //APP timer value
-#define APP_TIMEOUT_ACTIVE      20
-#define APP_TIMEOUT_LP          500
-#define CLOCK_TIMEOUT           1000
-#define BATTERY_LEVEL_TIMEOUT   10000
 #define NOTOUCH_TIMEOUT         0
 #define LOG_SAMPLE_TIMEOUT      100
 #define POWER_OFF_TIMEOUT       3000
 #define TOUCH_TIMEOUT_ACTIVE    5000
 #define DOUBLETAP_TIMEOUT       500
+#define STILLNESS_TIMEOUT       60000       //No motion time before going to low power mode
+#define EVENT_STATS_LOG_TIMEOUT 60000       //Event queue statistics logging interval
 
-//Millis overflow condition
-#define OVERFLOW    ((uint32_t)(0xFFFFFFFF/32.768))
+//Motion detection
+#define STILLNESS_ANGLE_DELTA   3           //Angle change (degrees) counted as motion in active mode
+#define ACCL_WAKE_THRESHOLD     26          //Wake-up threshold in 1/256 g, ~100 mg
+#define ACCL_WAKE_COUNT         2           //Samples above the threshold, 160 ms at 12.5Hz
 
 /** LED States **/
 typedef enum 
@@ -75,21 +79,17 @@ typedef enum
   LED_INDICATE_IDLE,
   LED_INDICATE_ADVERTISING,
   LED_INDICATE_CONNECTED,
-  LED_INDICATE_LOW_BATTERY
+  LED_INDICATE_LOW_BATTERY,
+  LED_INDICATE_COUNT
 } led_indicate_t;
 
-/** Capsense timer states **/
+/** App loop sampling states **/
 typedef enum
 {
-   APPLOOP_TIMER_LP,
    APPLOOP_TIMER_ACTIVE,
    APPLOOP_TIMER_OFF
 } apploop_timer_t;
 
-static bool is_capsense_timer_running;
-extern bool take_angle_reading;
-extern bool touch_button_press;
-
 
 /**@brief Function for initializing the custom hardware.
  *
@@ -108,29 +108,12 @@ static void gpio_init(void);
 /* Init peripheral timers */
 static void timers_init(void);
 
-/* LED timer handler for changing LED modes */
-static void led_ind_timer_handler(void *p_context);
-
-/* Capsense timer handler for sampling rates */
-static void apploop_timer_handler(void *p_context);
-
-/* EPOCH clock timer handler */
-static void clock_timer_handler(void * p_context);
-
 
-/* Starts the Capsense timer in different modes.
+/* Starts or stops the app loop sampling.
 *
-* @param[in]  mode - Low Power or Active, sets the
-*             samping rate of 100ms or 500ms.
+* @param[in]  mode - Active samples the accelerometer in batches, off stops it.
 */
 void apploop_timer_start_mode(apploop_timer_t mode);
 
-static void leds_off(void);
-
-
-/* millis functions */
-uint32_t millis(void);
-uint32_t compare_millis(uint32_t previous_millis, uint32_t current_millis);
-
 
 #endif
\ No newline at end of file
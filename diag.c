@@ -0,0 +1,202 @@
+/* File: diag.c */
+
+/** C file for the SwivX energy and CPU time accounting **/
+
+
+#include "diag.h"
+#include <string.h>
+#include "nrf.h"
+#include "nrf_soc.h"
+#include "nrf_nvic.h"
+#include "app_error.h"
+#include "app_util_platform.h"
+#include "sdk_macros.h"
+#include "ticks.h"
+
+static uint64_t m_cycles[DIAG_SUBSYS_COUNT];        //CPU sections in DWT cycles
+static uint64_t m_ticks[DIAG_SUBSYS_COUNT];         //On time in RTC ticks
+static uint64_t m_on_since[DIAG_SUBSYS_COUNT];
+static bool m_is_on[DIAG_SUBSYS_COUNT];
+static uint32_t m_counters[DIAG_COUNTER_COUNT];
+
+static diag_subsys_t cpu_stack[DIAG_CPU_DEPTH];
+static uint8_t cpu_depth = 0;
+static uint32_t cpu_mark = 0;
+static bool volatile is_radio_active = false;
+
+
+/**@brief Function for initializing the accounting. **/
+uint32_t diag_init(void)
+{
+    ret_code_t err_code;
+
+    memset(m_cycles, 0, sizeof(m_cycles));
+    memset(m_counters, 0, sizeof(m_counters));
+
+    //Cycle counter, counts only while the CPU runs
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    //Radio notification interrupt before and after every radio event
+    err_code = sd_nvic_ClearPendingIRQ(SWI1_IRQn);
+    VERIFY_SUCCESS(err_code);
+
+    err_code = sd_nvic_SetPriority(SWI1_IRQn, APP_IRQ_PRIORITY_LOW);
+    VERIFY_SUCCESS(err_code);
+
+    err_code = sd_nvic_EnableIRQ(SWI1_IRQn);
+    VERIFY_SUCCESS(err_code);
+
+    return sd_radio_notification_cfg_set(NRF_RADIO_NOTIFICATION_TYPE_INT_ON_BOTH,
+                                         NRF_RADIO_NOTIFICATION_DISTANCE_NONE);
+}
+
+
+/**@brief Function for starting a CPU time section. **/
+void diag_cpu_begin(diag_subsys_t subsys)
+{
+    uint32_t now = DWT->CYCCNT;
+
+    //Outer section is paused
+    if(cpu_depth > 0)
+    {
+        m_cycles[cpu_stack[cpu_depth - 1]] += (uint32_t)(now - cpu_mark);
+    }
+
+    if(cpu_depth < DIAG_CPU_DEPTH && subsys < DIAG_SUBSYS_COUNT)
+    {
+        cpu_stack[cpu_depth++] = subsys;
+    }
+    cpu_mark = now;
+}
+
+
+/**@brief Function for ending the CPU time section started last. **/
+void diag_cpu_end(diag_subsys_t subsys)
+{
+    uint32_t now = DWT->CYCCNT;
+
+    if(cpu_depth == 0 || cpu_stack[cpu_depth - 1] != subsys)
+    {
+        return;
+    }
+
+    //Cycle counter wraps every 67 s, sections are much shorter
+    m_cycles[subsys] += (uint32_t)(now - cpu_mark);
+    cpu_depth--;
+    cpu_mark = now;
+}
+
+
+/**@brief Function for marking a subsystem on. **/
+void diag_on(diag_subsys_t subsys)
+{
+    if(subsys >= DIAG_SUBSYS_COUNT)
+    {
+        return;
+    }
+
+    CRITICAL_REGION_ENTER();
+    if(!m_is_on[subsys])
+    {
+        m_is_on[subsys] = true;
+        m_on_since[subsys] = ticks_get();
+    }
+    CRITICAL_REGION_EXIT();
+}
+
+
+/**@brief Function for marking a subsystem off. **/
+void diag_off(diag_subsys_t subsys)
+{
+    if(subsys >= DIAG_SUBSYS_COUNT)
+    {
+        return;
+    }
+
+    CRITICAL_REGION_ENTER();
+    if(m_is_on[subsys])
+    {
+        m_is_on[subsys] = false;
+        m_ticks[subsys] += ticks_get() - m_on_since[subsys];
+    }
+    CRITICAL_REGION_EXIT();
+}
+
+
+/**@brief Function for adding a known on-time. **/
+void diag_add(diag_subsys_t subsys, uint32_t ms)
+{
+    if(subsys < DIAG_SUBSYS_COUNT)
+    {
+        CRITICAL_REGION_ENTER();
+        m_ticks[subsys] += TICKS_FROM_MS(ms);
+        CRITICAL_REGION_EXIT();
+    }
+}
+
+
+/**@brief Function for adding to an event counter. **/
+void diag_count(diag_counter_t counter, uint32_t n)
+{
+    if(counter < DIAG_COUNTER_COUNT)
+    {
+        CRITICAL_REGION_ENTER();
+        m_counters[counter] += n;
+        CRITICAL_REGION_EXIT();
+    }
+}
+
+
+/**@brief Function for getting the accounting since reset. **/
+void diag_snapshot_get(diag_snapshot_t * p_snapshot)
+{
+    uint64_t now;
+    uint64_t uptime_ms;
+    uint64_t awake_ms;
+    uint64_t charge;            //uA * ms
+    uint8_t i;
+
+    CRITICAL_REGION_ENTER();
+    now = ticks_get();
+    for(i = 0; i < DIAG_SUBSYS_COUNT; i++)
+    {
+        //Running intervals count up to now
+        uint64_t ticks = m_ticks[i] + (m_is_on[i] ? (now - m_on_since[i]) : 0);
+
+        p_snapshot->subsys_ms[i] = (uint32_t)(TICKS_TO_MS(ticks) + (m_cycles[i] / DIAG_CPU_CYCLES_PER_MS));
+    }
+    memcpy(p_snapshot->counters, m_counters, sizeof(m_counters));
+    CRITICAL_REGION_EXIT();
+
+    uptime_ms = TICKS_TO_MS(now);
+    p_snapshot->uptime_s = (uint32_t)(uptime_ms / 1000);
+
+    //CPU is awake whenever it is not sleeping, radio, flash and loads add on top
+    awake_ms = uptime_ms - p_snapshot->subsys_ms[DIAG_SUBSYS_SLEEP];
+    charge = (awake_ms * DIAG_CURRENT_CPU_UA)
+           + ((uint64_t)p_snapshot->subsys_ms[DIAG_SUBSYS_SLEEP] * DIAG_CURRENT_SLEEP_UA)
+           + ((uint64_t)p_snapshot->subsys_ms[DIAG_SUBSYS_BLE_TX] * DIAG_CURRENT_RADIO_UA)
+           + ((uint64_t)p_snapshot->subsys_ms[DIAG_SUBSYS_FDS_GC] * DIAG_CURRENT_FLASH_UA)
+           + ((uint64_t)p_snapshot->subsys_ms[DIAG_SUBSYS_MOTOR] * DIAG_CURRENT_MOTOR_UA)
+           + ((uint64_t)p_snapshot->subsys_ms[DIAG_SUBSYS_LED] * DIAG_CURRENT_LED_UA);
+
+    p_snapshot->avg_current_ua = (uptime_ms > 0) ? (uint32_t)(charge / uptime_ms) : 0;
+}
+
+
+/* SoftDevice radio notification, toggles before and after every radio event */
+void SWI1_IRQHandler(void)
+{
+    is_radio_active = !is_radio_active;
+
+    if(is_radio_active)
+    {
+        diag_on(DIAG_SUBSYS_BLE_TX);
+    }
+    else
+    {
+        diag_off(DIAG_SUBSYS_BLE_TX);
+    }
+}
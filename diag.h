@@ -0,0 +1,97 @@
+/* Header file diag.h */
+
+/** Header file for the SwivX energy and CPU time accounting **/
+
+
+
+#ifndef DIAG_H
+#define DIAG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//DWT cycle counter runs at the CPU clock
+#define DIAG_CPU_CYCLES_PER_MS      64000
+#define DIAG_CPU_DEPTH              4           //Nested CPU sections, the inner one pauses the outer
+
+//Current model for the average current estimate, nRF52832 datasheet typicals at 3 V with DCDC
+#define DIAG_CURRENT_CPU_UA         3300        //CPU running from flash, awake time not in sleep
+#define DIAG_CURRENT_SLEEP_UA       5           //System ON idle, RTC running, KXTJ3 in low power
+#define DIAG_CURRENT_RADIO_UA       6000        //Radio event average of TX and RX at 0 dBm
+#define DIAG_CURRENT_FLASH_UA       7400        //Flash erase and write during garbage collection
+#define DIAG_CURRENT_MOTOR_UA       60000       //ERM motor at full duty
+#define DIAG_CURRENT_LED_UA         1000        //LED PWM with the 16MHz clock, plus an LED at the pattern duty
+
+/** Accounted subsystems **/
+typedef enum
+{
+    DIAG_SUBSYS_SAMPLING,       //CPU, angle batch processing
+    DIAG_SUBSYS_FILTER,         //CPU, angle filter pipeline
+    DIAG_SUBSYS_LOG,            //CPU, log writes
+    DIAG_SUBSYS_FDS_GC,         //RTC, garbage collection start to finish
+    DIAG_SUBSYS_BLE_TX,         //RTC, radio active, SoftDevice radio notification
+    DIAG_SUBSYS_MOTOR,          //RTC, motor driver enabled
+    DIAG_SUBSYS_LED,            //RTC, LED pattern playing on the PWM
+    DIAG_SUBSYS_SLEEP,          //RTC, CPU waiting for an event
+    DIAG_SUBSYS_COUNT
+} diag_subsys_t;
+
+/** Event counters **/
+typedef enum
+{
+    DIAG_COUNTER_WAKEUP,        //Returns from sleep
+    DIAG_COUNTER_FLASH_WRITE,   //FDS record writes, updates and deletes
+    DIAG_COUNTER_FLASH_ERASE,   //FDS garbage collections, each erases at least one page
+    DIAG_COUNTER_BLE_TX,        //Notifications sent
+    DIAG_COUNTER_SAMPLE_GATED,  //Angle samples gated by the motor, held instead of filtered
+    DIAG_COUNTER_COUNT
+} diag_counter_t;
+
+/** Accounting snapshot since reset **/
+typedef struct
+{
+    uint32_t uptime_s;
+    uint32_t subsys_ms[DIAG_SUBSYS_COUNT];
+    uint32_t counters[DIAG_COUNTER_COUNT];
+    uint32_t avg_current_ua;    //Estimate from the current model
+} diag_snapshot_t;
+
+
+/**@brief Function for initializing the accounting.
+ *
+ * @details Starts the DWT cycle counter and the SoftDevice radio notification on SWI1, the
+ *          SoftDevice must be enabled.
+ *
+ * @return   NRF_SUCCESS on success, otherwise an error code.
+ */
+uint32_t diag_init(void);
+
+/**@brief Function for starting a CPU time section, main loop context only. **/
+void diag_cpu_begin(diag_subsys_t subsys);
+
+/**@brief Function for ending the CPU time section started last. **/
+void diag_cpu_end(diag_subsys_t subsys);
+
+/**@brief Function for marking a subsystem on, time is accounted in RTC ticks.
+ *
+ * @details Interrupt safe, a subsystem that is already on keeps its start time.
+ */
+void diag_on(diag_subsys_t subsys);
+
+/**@brief Function for marking a subsystem off. **/
+void diag_off(diag_subsys_t subsys);
+
+/**@brief Function for adding a known on-time, for a subsystem that stops without telling. **/
+void diag_add(diag_subsys_t subsys, uint32_t ms);
+
+/**@brief Function for adding to an event counter, interrupt safe. **/
+void diag_count(diag_counter_t counter, uint32_t n);
+
+/**@brief Function for getting the accounting since reset. **/
+void diag_snapshot_get(diag_snapshot_t * p_snapshot);
+
+#endif
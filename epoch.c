@@ -0,0 +1,170 @@
+/* File: epoch.c */
+
+/** C file for the SwivX wall-clock (EPOCH) time base **/
+
+
+#include "epoch.h"
+#include <string.h>
+#include "nrf_log.h"
+#include "app_util_platform.h"
+
+/** Reference point of a sync, RTC ticks and EPOCH time in 1/32768 s **/
+typedef struct
+{
+    uint64_t rtc_ticks;
+    uint64_t time_ticks;
+    bool     valid;
+} epoch_ref_t;
+
+static epoch_ref_t epoch_ref;                       //Reference the wall-clock is derived from
+static epoch_ref_t source_ref[EPOCH_SOURCE_COUNT];  //Last sync of each source for drift estimation
+static epoch_source_t epoch_ref_source = EPOCH_SOURCE_NONE;
+static int32_t drift_ppb = 0;
+static uint32_t last_monotonic_time = 0;
+
+
+/**@brief Function for initializing the EPOCH time base. **/
+void epoch_init(uint32_t restored_time, int32_t restored_drift_ppb)
+{
+    //Drift estimate from flash may be garbage on first boot
+    if(restored_drift_ppb > EPOCH_DRIFT_MAX_PPB || restored_drift_ppb < -EPOCH_DRIFT_MAX_PPB)
+    {
+        restored_drift_ppb = 0;
+    }
+    drift_ppb = restored_drift_ppb;
+
+    memset(source_ref, 0, sizeof(source_ref));
+    CRITICAL_REGION_ENTER();
+    epoch_ref.rtc_ticks = ticks_get();
+    epoch_ref.time_ticks = (uint64_t)restored_time * EPOCH_TICKS_PER_SEC;
+    epoch_ref.valid = true;
+    epoch_ref_source = EPOCH_SOURCE_FLASH;
+    CRITICAL_REGION_EXIT();
+
+    //Log timestamps continue from the last persisted value after a reset
+    last_monotonic_time = restored_time;
+}
+
+
+/**@brief Function for getting the current EPOCH time in seconds. **/
+uint32_t epoch_get(void)
+{
+    epoch_ref_t ref;
+    uint64_t now_ticks;
+
+    //Called from interrupts too, e.g. the motor budget. A sync in between would tear the 64bit
+    //reference, and the tick count must not be older than the reference it is taken against
+    CRITICAL_REGION_ENTER();
+    ref = epoch_ref;
+    now_ticks = ticks_get();
+    CRITICAL_REGION_EXIT();
+
+    uint64_t elapsed = now_ticks - ref.rtc_ticks;
+
+    //Correct the elapsed LFCLK ticks by the estimated drift
+    int64_t correction = ((int64_t)elapsed * drift_ppb) / 1000000000;
+
+    return (uint32_t)((ref.time_ticks + elapsed + correction) / EPOCH_TICKS_PER_SEC);
+}
+
+
+/**@brief Function for getting a timestamp that never goes backwards. **/
+uint32_t epoch_get_monotonic(void)
+{
+    uint32_t now = epoch_get();
+
+    if(now >= last_monotonic_time)
+    {
+        last_monotonic_time = now;
+    }
+    else if((last_monotonic_time - now) > EPOCH_MONOTONIC_MAX_HOLD)
+    {
+        //Persisted time was bogus, do not hold the log timestamps forever
+        NRF_LOG_INFO("Epoch jumped back %d s, releasing hold", last_monotonic_time - now);
+        last_monotonic_time = now;
+    }
+
+    return last_monotonic_time;
+}
+
+
+/**@brief Function for synchronising the wall-clock to an external time reference. **/
+void epoch_sync(uint32_t time, uint8_t fractions256, epoch_source_t source)
+{
+    uint64_t now_ticks = ticks_get();
+    uint64_t time_ticks = ((uint64_t)time * EPOCH_TICKS_PER_SEC) + ((uint32_t)fractions256 << 7);
+    epoch_ref_t * p_prev;
+
+    if(source == EPOCH_SOURCE_NONE || source >= EPOCH_SOURCE_COUNT)
+    {
+        return;
+    }
+    p_prev = &source_ref[source];
+
+    //Estimate the LFCLK drift against the previous sync from the same source, so a
+    //constant offset between sources (i.e. CTS local time) does not show up as drift
+    if(p_prev->valid && time_ticks > p_prev->time_ticks)
+    {
+        uint64_t true_span = time_ticks - p_prev->time_ticks;
+        uint64_t local_span = now_ticks - p_prev->rtc_ticks;
+
+        if(local_span >= ((uint64_t)EPOCH_DRIFT_MIN_SPAN * EPOCH_TICKS_PER_SEC))
+        {
+            int64_t measured = (((int64_t)true_span - (int64_t)local_span) * 1000000000) / (int64_t)local_span;
+
+            if(measured <= EPOCH_DRIFT_MAX_PPB && measured >= -EPOCH_DRIFT_MAX_PPB)
+            {
+                drift_ppb += (int32_t)((measured - drift_ppb) / (1 << EPOCH_DRIFT_SMOOTH_SHIFT));
+                NRF_LOG_INFO("Epoch drift measured %d ppb, estimate %d ppb", (int32_t)measured, drift_ppb);
+            }
+        }
+    }
+
+    p_prev->rtc_ticks = now_ticks;
+    p_prev->time_ticks = time_ticks;
+    p_prev->valid = true;
+
+    //CTS reports local time, the app writes UTC. Keep the app reference once it has been set.
+    if(source == EPOCH_SOURCE_CTS && epoch_ref_source == EPOCH_SOURCE_APP)
+    {
+        return;
+    }
+
+    CRITICAL_REGION_ENTER();
+    epoch_ref.rtc_ticks = now_ticks;
+    epoch_ref.time_ticks = time_ticks;
+    epoch_ref_source = source;
+    CRITICAL_REGION_EXIT();
+
+    NRF_LOG_INFO("Epoch synced to %d, source %d", time, source);
+}
+
+
+/**@brief Function for converting a calendar date and time to EPOCH time. **/
+uint32_t epoch_from_date(uint16_t year, uint8_t month, uint8_t day,
+                         uint8_t hours, uint8_t minutes, uint8_t seconds)
+{
+    //Days since 1970-01-01, March based year so the leap day is last
+    int32_t y = (int32_t)year - (month <= 2);
+    int32_t era = (y >= 0 ? y : y - 399) / 400;
+    uint32_t yoe = (uint32_t)(y - era * 400);
+    uint32_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    int32_t days = era * 146097 + (int32_t)doe - 719468;
+
+    return ((uint32_t)days * 86400) + ((uint32_t)hours * 3600) + ((uint32_t)minutes * 60) + seconds;
+}
+
+
+/**@brief Function for getting the current LFCLK drift estimate in parts per billion. **/
+int32_t epoch_drift_get(void)
+{
+    return drift_ppb;
+}
+
+
+/**@brief Function to return true if the clock has been synced since reset. **/
+bool epoch_is_synced(void)
+{
+    return (epoch_ref_source == EPOCH_SOURCE_CTS || epoch_ref_source == EPOCH_SOURCE_APP);
+}
@@ -0,0 +1,78 @@
+/* Header file epoch.h */
+
+/** Header file for the SwivX wall-clock (EPOCH) time base **/
+
+
+
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ticks.h"
+
+//Derived from the RTC ticks of ticks_get()
+#define EPOCH_TICKS_PER_SEC         TICKS_PER_SEC
+
+//Drift estimation limits
+#define EPOCH_DRIFT_MAX_PPB         500000      //LFRC is +-500 ppm worst case uncalibrated
+#define EPOCH_DRIFT_MIN_SPAN        7200        //Seconds between two syncs before a drift estimate is trusted
+#define EPOCH_DRIFT_SMOOTH_SHIFT    2           //New drift estimate weight 1/4
+
+//Largest backwards step (seconds) that is absorbed by holding log timestamps
+#define EPOCH_MONOTONIC_MAX_HOLD    86400
+
+/** Sources the wall-clock can be synchronised from **/
+typedef enum
+{
+    EPOCH_SOURCE_NONE,
+    EPOCH_SOURCE_FLASH,         //Restored from the settings register after reset
+    EPOCH_SOURCE_CTS,           //Current Time Service on the connected phone
+    EPOCH_SOURCE_APP,           //Timestamp written by the app to the settings characteristic
+    EPOCH_SOURCE_COUNT
+} epoch_source_t;
+
+
+/**@brief Function for initializing the EPOCH time base.
+ *
+ * @details Starts counting from the last persisted time. Wall-clock time is derived lazily from
+ *          the RTC ticks of ticks_get(), no timer is used.
+ *
+ * @param[in]   restored_time   Last known EPOCH time, e.g. from the settings register.
+ * @param[in]   drift_ppb       Last LFCLK drift estimate in parts per billion.
+ */
+void epoch_init(uint32_t restored_time, int32_t drift_ppb);
+
+/**@brief Function for getting the current EPOCH time in seconds. **/
+uint32_t epoch_get(void);
+
+/**@brief Function for getting a timestamp that never goes backwards.
+ *
+ * @details To be used for log timestamps. If a sync moves the clock backwards, the returned
+ *          value holds until the wall-clock catches up again.
+ */
+uint32_t epoch_get_monotonic(void);
+
+/**@brief Function for synchronising the wall-clock to an external time reference.
+ *
+ * @param[in]   time            True EPOCH time in seconds.
+ * @param[in]   fractions256    Sub second part of the time in 1/256 s, 0 if unknown.
+ * @param[in]   source          Source of the time reference.
+ */
+void epoch_sync(uint32_t time, uint8_t fractions256, epoch_source_t source);
+
+/**@brief Function for converting a calendar date and time to EPOCH time. **/
+uint32_t epoch_from_date(uint16_t year, uint8_t month, uint8_t day,
+                         uint8_t hours, uint8_t minutes, uint8_t seconds);
+
+/**@brief Function for getting the current LFCLK drift estimate in parts per billion. **/
+int32_t epoch_drift_get(void);
+
+/**@brief Function to return true if the clock has been synced since reset. **/
+bool epoch_is_synced(void);
+
+#endif
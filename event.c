@@ -0,0 +1,150 @@
+/* File: event.c */
+
+/** C file for the SwivX application event queue **/
+
+
+#include "event.h"
+#include <string.h>
+#include "nrf_log.h"
+#include "app_error.h"
+#include "app_scheduler.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+
+/** Queued event, time of the post for the latency **/
+typedef struct
+{
+    event_type_t type;
+    uint32_t post_ticks;
+} event_msg_t;
+
+static event_handler_t m_handlers[EVENT_COUNT];
+static event_stats_t m_stats[EVENT_COUNT];
+static bool volatile m_pending[EVENT_COUNT];
+static uint16_t queue_count = 0;
+static uint16_t queue_high_water = 0;
+
+
+/**@brief Function for initializing the event queue. **/
+void event_init(void)
+{
+    APP_SCHED_INIT(sizeof(event_msg_t), EVENT_QUEUE_SIZE);
+
+    memset(m_handlers, 0, sizeof(m_handlers));
+    memset(m_stats, 0, sizeof(m_stats));
+    memset((void *)m_pending, 0, sizeof(m_pending));
+}
+
+
+/**@brief Function for setting the handler of an event type. **/
+void event_handler_set(event_type_t type, event_handler_t handler)
+{
+    if(type < EVENT_COUNT)
+    {
+        m_handlers[type] = handler;
+    }
+}
+
+
+/**@brief Function for posting an event. **/
+void event_post(event_type_t type)
+{
+    event_msg_t msg;
+
+    if(type >= EVENT_COUNT)
+    {
+        return;
+    }
+
+    CRITICAL_REGION_ENTER();
+    if(m_pending[type])
+    {
+        m_stats[type].coalesced++;
+    }
+    else
+    {
+        msg.type = type;
+        msg.post_ticks = app_timer_cnt_get();
+
+        if(app_sched_event_put(&msg, sizeof(msg), event_dispatch) == NRF_SUCCESS)
+        {
+            m_pending[type] = true;
+            queue_count++;
+            if(queue_count > queue_high_water)
+            {
+                queue_high_water = queue_count;
+            }
+        }
+        else
+        {
+            m_stats[type].dropped++;
+        }
+    }
+    CRITICAL_REGION_EXIT();
+}
+
+
+/**@brief Function for running every pending event. **/
+void event_execute(void)
+{
+    app_sched_execute();
+}
+
+
+/**@brief Function for getting the dispatch statistics of an event type. **/
+void event_stats_get(event_type_t type, event_stats_t * p_stats)
+{
+    if(type < EVENT_COUNT)
+    {
+        CRITICAL_REGION_ENTER();
+        *p_stats = m_stats[type];
+        CRITICAL_REGION_EXIT();
+    }
+}
+
+
+/**@brief Function for getting the highest number of queued events since reset. **/
+uint16_t event_queue_high_water_get(void)
+{
+    return queue_high_water;
+}
+
+
+/**@brief Function for logging the statistics of every event type. **/
+void event_stats_log(void)
+{
+    uint8_t type;
+
+    NRF_LOG_INFO("Event queue high water %d/%d", queue_high_water, EVENT_QUEUE_SIZE);
+    for(type = 0; type < EVENT_COUNT; type++)
+    {
+        //Latency in us, RTC ticks are 1/32768 s
+        NRF_LOG_INFO("Event %d: %d run, %d merged, %d dropped, max %d us", type, m_stats[type].count,
+                     m_stats[type].coalesced, m_stats[type].dropped,
+                     (uint32_t)(((uint64_t)m_stats[type].max_latency * 1000000) / 32768));
+    }
+}
+
+
+/* Scheduler handler, runs the handler of a queued event */
+static void event_dispatch(void * p_event_data, uint16_t event_size)
+{
+    event_msg_t const * p_msg = (event_msg_t const *)p_event_data;
+    uint32_t latency = app_timer_cnt_diff_compute(app_timer_cnt_get(), p_msg->post_ticks);
+
+    //Cleared before the handler runs, a post from the handler queues the event again
+    CRITICAL_REGION_ENTER();
+    m_pending[p_msg->type] = false;
+    queue_count--;
+    m_stats[p_msg->type].count++;
+    if(latency > m_stats[p_msg->type].max_latency)
+    {
+        m_stats[p_msg->type].max_latency = latency;
+    }
+    CRITICAL_REGION_EXIT();
+
+    if(m_handlers[p_msg->type] != NULL)
+    {
+        m_handlers[p_msg->type]();
+    }
+}
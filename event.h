@@ -0,0 +1,85 @@
+/* Header file event.h */
+
+/** Header file for the SwivX application event queue **/
+
+
+
+#ifndef EVENT_H
+#define EVENT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//Scheduler queue, each event type is queued at most once so this covers every type
+#define EVENT_QUEUE_SIZE            16
+
+/** Application events, posted from interrupt handlers and run in the main loop **/
+typedef enum
+{
+    EVENT_MODE,                 //App mode changed, run the mode entry
+    EVENT_ACCL_BATCH,           //Accelerometer batch ready
+    EVENT_ACCL_MOTION,          //Accelerometer wake-up interrupt
+    EVENT_TOUCH,                //Capsense pressed
+    EVENT_LOG_SEND,             //Log packets can be queued for notification
+    EVENT_FDS_GC,               //Deleted flash records to collect
+    EVENT_BUTTON_SHORT,         //Power button clicked once
+    EVENT_BUTTON_LONG,          //Power button held for BUTTON_LONG_TIMEOUT
+    EVENT_BUTTON_DOUBLE,        //Power button clicked twice
+    EVENT_POWER_UPDATE,         //Power state input changed or idle check
+    EVENT_POWER_STATE,          //Power state changed
+    EVENT_PERIPH_RELEASE,       //Last reference on a peripheral dropped
+    EVENT_BATTERY,              //Battery burst measured
+    EVENT_WEAR,                 //Capsense wear state changed
+    EVENT_COUNT
+} event_type_t;
+
+/** Event handler, runs in the main loop **/
+typedef void (*event_handler_t)(void);
+
+/** Dispatch statistics of an event type **/
+typedef struct
+{
+    uint32_t count;             //Events dispatched
+    uint32_t coalesced;         //Posts merged into an already pending event
+    uint32_t dropped;           //Posts lost to a full queue
+    uint32_t max_latency;       //Longest post to dispatch time in RTC ticks
+} event_stats_t;
+
+
+/**@brief Function for initializing the event queue. **/
+void event_init(void);
+
+/**@brief Function for setting the handler of an event type. **/
+void event_handler_set(event_type_t type, event_handler_t handler);
+
+/**@brief Function for posting an event.
+ *
+ * @details Interrupt safe. An event that is already pending is not queued again, like the
+ *          flags it replaces.
+ *
+ * @param[in]   type   Event type.
+ */
+void event_post(event_type_t type);
+
+/**@brief Function for running every pending event, called from the main loop. **/
+void event_execute(void);
+
+/**@brief Function for getting the dispatch statistics of an event type. **/
+void event_stats_get(event_type_t type, event_stats_t * p_stats);
+
+/**@brief Function for getting the highest number of queued events since reset. **/
+uint16_t event_queue_high_water_get(void);
+
+/**@brief Function for logging the statistics of every event type. **/
+void event_stats_log(void);
+
+/* Static Functions */
+
+/* Scheduler handler, runs the handler of a queued event */
+static void event_dispatch(void * p_event_data, uint16_t event_size);
+
+#endif
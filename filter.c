@@ -0,0 +1,138 @@
+/* File: filter.c */
+
+/** C file for the SwivX angle filter pipeline **/
+
+
+#include "filter.h"
+#include "sdk_errors.h"
+
+static filter_config_t m_config =
+{
+    .median_len = FILTER_DEFAULT_MEDIAN,
+    .iir_shift  = FILTER_DEFAULT_IIR_SHIFT,
+    .decimation = FILTER_DEFAULT_DECIMATION
+};
+
+static int16_t median_window[FILTER_MEDIAN_MAX];
+static uint8_t median_pos = 0;
+static int32_t iir_state = 0;                 //Low-pass output with FILTER_IIR_FRAC_BITS fraction bits
+static uint8_t decimation_count = 0;
+static bool is_primed = false;
+static int16_t last_output = 0;
+
+
+/**@brief Function for setting the filter pipeline configuration. **/
+uint32_t filter_config_set(filter_config_t const * p_config)
+{
+    if(p_config->median_len > FILTER_MEDIAN_MAX ||
+       (p_config->median_len > 1 && (p_config->median_len & 0x01) == 0) ||
+       p_config->iir_shift > FILTER_IIR_SHIFT_MAX ||
+       p_config->decimation == 0 || p_config->decimation > FILTER_DECIMATION_MAX)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    m_config = *p_config;
+    filter_reset();
+
+    return NRF_SUCCESS;
+}
+
+
+/**@brief Function for getting the current filter pipeline configuration. **/
+void filter_config_get(filter_config_t * p_config)
+{
+    *p_config = m_config;
+}
+
+
+/**@brief Function for resetting the filter state. **/
+void filter_reset(void)
+{
+    is_primed = false;
+    decimation_count = 0;
+}
+
+
+/**@brief Function for passing one sample through the filter pipeline. **/
+bool filter_process(int16_t sample, bool is_gated, int16_t * p_out)
+{
+    int16_t value = sample;
+
+    if(is_gated)
+    {
+        //Nothing to hold before the first valid sample
+        if(!is_primed)
+        {
+            return false;
+        }
+        value = last_output;
+    }
+
+    //First sample fills the median window and the IIR state, no start-up ramp from 0
+    if(!is_primed)
+    {
+        for(uint8_t i = 0; i < FILTER_MEDIAN_MAX; i++)
+        {
+            median_window[i] = sample;
+        }
+        median_pos = 0;
+        iir_state = (int32_t)sample << FILTER_IIR_FRAC_BITS;
+        is_primed = true;
+    }
+
+    //Sliding median, rejects single sample spikes (bumps)
+    if(!is_gated && m_config.median_len > 1)
+    {
+        median_window[median_pos] = sample;
+        median_pos++;
+        if(median_pos >= m_config.median_len)
+        {
+            median_pos = 0;
+        }
+        value = median_get();
+    }
+
+    //First order IIR low-pass
+    if(!is_gated && m_config.iir_shift > 0)
+    {
+        iir_state += (((int32_t)value << FILTER_IIR_FRAC_BITS) - iir_state) >> m_config.iir_shift;
+        value = (int16_t)((iir_state + (1 << (FILTER_IIR_FRAC_BITS - 1))) >> FILTER_IIR_FRAC_BITS);
+    }
+
+    last_output = value;
+
+    //Decimation, the low-pass runs at the full rate so this only thins the output
+    decimation_count++;
+    if(decimation_count < m_config.decimation)
+    {
+        return false;
+    }
+    decimation_count = 0;
+
+    *p_out = value;
+    return true;
+}
+
+
+/* Median of the sliding window, insertion sort of at most FILTER_MEDIAN_MAX values */
+static int16_t median_get(void)
+{
+    int16_t sorted[FILTER_MEDIAN_MAX];
+    uint8_t len = m_config.median_len;
+
+    for(uint8_t i = 0; i < len; i++)
+    {
+        int16_t value = median_window[i];
+        uint8_t j = i;
+
+        while(j > 0 && sorted[j - 1] > value)
+        {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = value;
+    }
+
+    return sorted[len / 2];
+}
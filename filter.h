@@ -0,0 +1,73 @@
+/* Header file filter.h */
+
+/** Header file for the SwivX angle filter pipeline **/
+
+
+
+#ifndef FILTER_H
+#define FILTER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//Stage limits, checked when a configuration is set over BLE
+#define FILTER_MEDIAN_MAX           5           //Longest sliding median window
+#define FILTER_IIR_SHIFT_MAX        6           //Smallest IIR weight 1/64
+#define FILTER_DECIMATION_MAX       50          //1 output per second at 50Hz ODR
+#define FILTER_IIR_FRAC_BITS        8           //Extra fraction bits kept in the IIR state
+
+//Default pipeline, 5 sample spike rejection and a ~3 sample time constant at the full rate
+#define FILTER_DEFAULT_MEDIAN       5
+#define FILTER_DEFAULT_IIR_SHIFT    2
+#define FILTER_DEFAULT_DECIMATION   1
+
+/** Filter pipeline configuration, median -> IIR low-pass -> decimation **/
+typedef struct
+{
+    uint8_t median_len;         //Sliding median window, 0 or 1 = off, odd up to FILTER_MEDIAN_MAX
+    uint8_t iir_shift;          //IIR low-pass y += (x - y) / 2^n, 0 = off
+    uint8_t decimation;         //One output every n samples, 1 = every sample
+} filter_config_t;
+
+
+/**@brief Function for setting the filter pipeline configuration.
+ *
+ * @details The filter state is reset, the next sample primes all stages.
+ *
+ * @param[in]   p_config   New configuration.
+ *
+ * @return   NRF_SUCCESS, or NRF_ERROR_INVALID_PARAM if a stage is out of range. The current
+ *           configuration is kept on error.
+ */
+uint32_t filter_config_set(filter_config_t const * p_config);
+
+/**@brief Function for getting the current filter pipeline configuration. **/
+void filter_config_get(filter_config_t * p_config);
+
+/**@brief Function for resetting the filter state, e.g. after sampling was stopped. **/
+void filter_reset(void);
+
+/**@brief Function for passing one sample through the filter pipeline.
+ *
+ * @details Constant time per sample, integer only. A gated sample (e.g. taken while the motor
+ *          vibrates) does not enter the median or IIR stages. It still counts for the
+ *          decimation, the output holds the last filtered value.
+ *
+ * @param[in]   sample     Input sample, e.g. an angle in 1/64 degree.
+ * @param[in]   is_gated   true to reject the sample.
+ * @param[out]  p_out      Filtered sample, only written on an output sample.
+ *
+ * @return   true if the decimation stage produced an output sample.
+ */
+bool filter_process(int16_t sample, bool is_gated, int16_t * p_out);
+
+/* Static Functions */
+
+/* Median of the sliding window */
+static int16_t median_get(void);
+
+#endif
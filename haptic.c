@@ -0,0 +1,255 @@
+/* File: haptic.c */
+
+/** C file for the SwivX haptic waveform library **/
+
+
+#include "haptic.h"
+#include <string.h>
+#include "nrf_log.h"
+#include "fds.h"
+#include "motor.h"
+#include "log.h"
+#include "budget.h"
+#include "event.h"
+
+/* Waveforms as uploaded, also the FDS record data */
+static haptic_waveform_t m_waveforms[HAPTIC_SLOT_COUNT];
+
+/* Compiled sequences, values must stay in RAM for EasyDMA */
+static nrf_pwm_values_common_t m_slot_values[HAPTIC_SLOT_COUNT][HAPTIC_MAX_SAMPLES];
+static nrf_pwm_sequence_t m_slot_seq[HAPTIC_SLOT_COUNT];
+static uint8_t m_slot_duty[HAPTIC_SLOT_COUNT];
+
+
+/**@brief Function for loading the waveform slots from flash. **/
+void haptic_init(void)
+{
+    uint8_t slot;
+
+    for(slot = 0; slot < HAPTIC_SLOT_COUNT; slot++)
+    {
+        if(!haptic_flash_recall(slot))
+        {
+            m_waveforms[slot].step_count = 0;
+        }
+        haptic_compile(slot);
+    }
+
+    //Selected slot may be gone or the settings register is from an older firmware
+    if(haptic_sequence_get(settings_register.hapticSlot) == NULL)
+    {
+        settings_register.hapticSlot = HAPTIC_SLOT_NONE;
+    }
+}
+
+
+/**@brief Function for checking an upload packet without applying it. **/
+bool haptic_upload_check(uint8_t const * p_data, uint16_t len)
+{
+    uint8_t slot;
+    uint8_t step_count;
+    uint16_t samples = 1;
+    uint8_t i;
+
+    if(p_data == NULL || len < HAPTIC_UPLOAD_HEADER_LEN)
+    {
+        return false;
+    }
+    slot = p_data[0];
+    step_count = p_data[1];
+
+    //Selection of a waveform
+    if(step_count == 0)
+    {
+        return (len == HAPTIC_UPLOAD_HEADER_LEN)
+            && (slot == HAPTIC_SLOT_NONE || haptic_sequence_get(slot) != NULL);
+    }
+
+    if(slot >= HAPTIC_SLOT_COUNT || step_count > HAPTIC_MAX_STEPS
+       || len != (HAPTIC_UPLOAD_HEADER_LEN + (step_count * 2)))
+    {
+        return false;
+    }
+
+    for(i = 0; i < step_count; i++)
+    {
+        uint8_t intensity = p_data[HAPTIC_UPLOAD_HEADER_LEN + (i * 2)];
+        uint8_t duration = p_data[HAPTIC_UPLOAD_HEADER_LEN + (i * 2) + 1];
+
+        if(intensity > 100 || duration == 0)
+        {
+            return false;
+        }
+        samples += duration;
+    }
+
+    return (samples <= HAPTIC_MAX_SAMPLES);
+}
+
+
+/**@brief Function for applying an upload packet. **/
+uint32_t haptic_upload(uint8_t const * p_data, uint16_t len)
+{
+    uint8_t slot;
+
+    if(!haptic_upload_check(p_data, len))
+    {
+        return (p_data == NULL || len < HAPTIC_UPLOAD_HEADER_LEN) ? NRF_ERROR_INVALID_LENGTH : NRF_ERROR_INVALID_PARAM;
+    }
+    slot = p_data[0];
+
+    if(p_data[1] == 0)
+    {
+        NRF_LOG_INFO("Haptic alert waveform %d selected", slot);
+        settings_register.hapticSlot = slot;
+        return settings_reg_flash_write();
+    }
+
+    //Sequence is read by EasyDMA while playing
+    if(!is_motor_stopped())
+    {
+        motor_state_handler(MOTOR_STOP);
+    }
+
+    memset(&m_waveforms[slot], 0, sizeof(haptic_waveform_t));
+    m_waveforms[slot].step_count = p_data[1];
+    memcpy(m_waveforms[slot].steps, &p_data[HAPTIC_UPLOAD_HEADER_LEN], m_waveforms[slot].step_count * 2);
+    haptic_compile(slot);
+
+    NRF_LOG_INFO("Haptic waveform %d uploaded, %d steps", slot, m_waveforms[slot].step_count);
+
+    return haptic_flash_write(slot);
+}
+
+
+/**@brief Function for getting the compiled PWM sequence of a slot. **/
+nrf_pwm_sequence_t const * haptic_sequence_get(uint8_t slot)
+{
+    if(slot >= HAPTIC_SLOT_COUNT || m_slot_seq[slot].length == 0)
+    {
+        return NULL;
+    }
+
+    return &m_slot_seq[slot];
+}
+
+
+/**@brief Function for getting the average duty of a slot in percent. **/
+uint8_t haptic_duty_get(uint8_t slot)
+{
+    return (slot < HAPTIC_SLOT_COUNT) ? m_slot_duty[slot] : 0;
+}
+
+
+/**@brief Function for compiling all slots again. **/
+void haptic_refresh(void)
+{
+    uint8_t slot;
+
+    if(!is_motor_stopped())
+    {
+        motor_state_handler(MOTOR_STOP);
+    }
+
+    for(slot = 0; slot < HAPTIC_SLOT_COUNT; slot++)
+    {
+        haptic_compile(slot);
+    }
+}
+
+
+/* Expands a waveform to one PWM value per HAPTIC_STEP_MS, each value repeats for the whole step unit */
+static void haptic_compile(uint8_t slot)
+{
+    haptic_waveform_t const * p_wave = &m_waveforms[slot];
+    uint16_t length = 0;
+    uint32_t duty_sum = 0;
+    uint8_t i;
+
+    m_slot_seq[slot].values.p_common = m_slot_values[slot];
+    m_slot_seq[slot].repeats = (HAPTIC_STEP_MS / MOTOR_PWM_PERIOD_MS) - 1;
+    m_slot_seq[slot].end_delay = 0;
+    m_slot_seq[slot].length = 0;
+    m_slot_duty[slot] = 0;
+
+    if(p_wave->step_count == 0 || p_wave->step_count > HAPTIC_MAX_STEPS)
+    {
+        return;
+    }
+
+    for(i = 0; i < p_wave->step_count; i++)
+    {
+        //Softer on a low battery, see budget_intensity_scale
+        uint8_t intensity = budget_intensity_scale((p_wave->steps[i].intensity > 100) ? 100 : p_wave->steps[i].intensity);
+        uint16_t level = MOTOR_PWM_TOP - (uint16_t)(((uint32_t)MOTOR_PWM_TOP * intensity) / 100);
+        uint8_t n;
+
+        for(n = 0; n < p_wave->steps[i].duration && length < (HAPTIC_MAX_SAMPLES - 1); n++)
+        {
+            m_slot_values[slot][length++] = level;
+            duty_sum += intensity;
+        }
+    }
+
+    //Always end with the motor off
+    m_slot_values[slot][length++] = MOTOR_PWM_OFF;
+    m_slot_seq[slot].length = length;
+    m_slot_duty[slot] = (uint8_t)(duty_sum / length);
+}
+
+
+/* Saves a waveform slot to flash */
+static uint32_t haptic_flash_write(uint8_t slot)
+{
+    ret_code_t err_code;
+
+    fds_record_t          record;
+    fds_record_desc_t    record_desc;
+    fds_find_token_t      ftok;
+
+    //setup record
+    record.file_id = HAPTIC_FILE_ID;
+    record.key = HAPTIC_REC_BASE_KEY + slot;
+    record.data.p_data = &m_waveforms[slot];
+    record.data.length_words = (sizeof(haptic_waveform_t) + 3) / 4;
+    memset(&ftok, 0x00, sizeof(fds_find_token_t));
+
+    //If record exists, update.
+    if(fds_record_find(HAPTIC_FILE_ID, record.key, &record_desc, &ftok) == NRF_SUCCESS)
+    {
+        err_code = fds_record_update(&record_desc, &record);
+        event_post(EVENT_FDS_GC);
+    }
+    else
+    {
+        err_code = fds_record_write(&record_desc, &record);
+    }
+
+    return err_code;
+}
+
+
+/* Recalls a waveform slot from flash */
+static bool haptic_flash_recall(uint8_t slot)
+{
+    fds_flash_record_t  record;
+    fds_record_desc_t   record_desc;
+    fds_find_token_t    ftok;
+
+    memset(&ftok, 0x00, sizeof(fds_find_token_t));
+
+    if(fds_record_find(HAPTIC_FILE_ID, HAPTIC_REC_BASE_KEY + slot, &record_desc, &ftok) != NRF_SUCCESS)
+    {
+        return false;
+    }
+
+    if(fds_record_open(&record_desc, &record) != NRF_SUCCESS)
+    {
+        return false;
+    }
+
+    memcpy(&m_waveforms[slot], record.p_data, sizeof(haptic_waveform_t));
+    fds_record_close(&record_desc);
+
+    return true;
+}
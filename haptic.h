@@ -0,0 +1,103 @@
+/* Header file haptic.h */
+
+/** Header file for the SwivX haptic waveform library **/
+
+
+
+#ifndef HAPTIC_H
+#define HAPTIC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "nrfx_pwm.h"
+
+//Waveform library, each slot is a list of (intensity, duration) steps
+#define HAPTIC_SLOT_COUNT           4
+#define HAPTIC_SLOT_NONE            0xFF        //Alert plays the motorIntensity/motorDuration pulses
+#define HAPTIC_MAX_STEPS            16
+#define HAPTIC_STEP_MS              20          //Duration unit of a step, 4 PWM periods
+#define HAPTIC_MAX_SAMPLES          200         //Longest waveform 4 s, including the trailing off sample
+
+//Upload packet: slot, step count, then intensity (%) and duration (HAPTIC_STEP_MS) per step.
+//A step count of 0 selects the slot as the alert waveform, slot HAPTIC_SLOT_NONE selects the pulses.
+#define HAPTIC_UPLOAD_HEADER_LEN    2
+#define HAPTIC_UPLOAD_MAX_LEN       (HAPTIC_UPLOAD_HEADER_LEN + (HAPTIC_MAX_STEPS * 2))
+
+//FDS definitions, one record per slot
+#define HAPTIC_FILE_ID              0x1113
+#define HAPTIC_REC_BASE_KEY         0x0001
+
+/** Waveform step **/
+typedef struct
+{
+    uint8_t intensity;          //Percent of full power, 0 = pause
+    uint8_t duration;           //Length in HAPTIC_STEP_MS, 1..255
+} haptic_step_t;
+
+/** Waveform as stored in flash, padded to whole words **/
+typedef struct
+{
+    uint8_t step_count;
+    uint8_t reserved[3];
+    haptic_step_t steps[HAPTIC_MAX_STEPS];
+} haptic_waveform_t;
+
+
+/**@brief Function for loading the waveform slots from flash.
+ *
+ * @details Every stored waveform is compiled into its PWM sequence, FDS must be initialized.
+ */
+void haptic_init(void);
+
+/**@brief Function for checking an upload packet without applying it.
+ *
+ * @param[in]   p_data   Upload packet, see HAPTIC_UPLOAD_MAX_LEN.
+ * @param[in]   len      Length of the packet.
+ *
+ * @return   true if the packet can be applied with haptic_upload.
+ */
+bool haptic_upload_check(uint8_t const * p_data, uint16_t len);
+
+/**@brief Function for applying an upload packet.
+ *
+ * @details A waveform is compiled into its slot and written to flash. A playing waveform is
+ *          stopped first, its PWM sequence is overwritten.
+ *
+ * @param[in]   p_data   Upload packet, see HAPTIC_UPLOAD_MAX_LEN.
+ * @param[in]   len      Length of the packet.
+ *
+ * @return   NRF_SUCCESS, NRF_ERROR_INVALID_LENGTH or NRF_ERROR_INVALID_PARAM if the packet was
+ *           rejected, otherwise an FDS error code.
+ */
+uint32_t haptic_upload(uint8_t const * p_data, uint16_t len);
+
+/**@brief Function for getting the compiled PWM sequence of a slot.
+ *
+ * @param[in]   slot   Waveform slot.
+ *
+ * @return   Sequence to play, NULL if the slot is empty or out of range.
+ */
+nrf_pwm_sequence_t const * haptic_sequence_get(uint8_t slot);
+
+/**@brief Function for getting the average duty of a slot in percent. **/
+uint8_t haptic_duty_get(uint8_t slot);
+
+/**@brief Function for compiling all slots again, e.g. after the battery band changed. **/
+void haptic_refresh(void);
+
+/* Static Functions */
+
+/* Expand a waveform to one PWM value per HAPTIC_STEP_MS */
+static void haptic_compile(uint8_t slot);
+
+/* Save a waveform slot to flash */
+static uint32_t haptic_flash_write(uint8_t slot);
+
+/* Recall a waveform slot from flash */
+static bool haptic_flash_recall(uint8_t slot);
+
+#endif
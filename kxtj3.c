@@ -8,49 +8,273 @@
 #include "nrf_gpio.h"
 #include "boards.h"
 #include "nrf_log.h"
-#include "nrfx_twi.h"
-#include "math.h"
+#include "nrfx_twim.h"
+#include "nrfx_gpiote.h"
+#include "nrfx_timer.h"
+#include "nrfx_ppi.h"
+#include "nrf_delay.h"
+#include "sdk_macros.h"
 #include "motor.h"
+#include "event.h"
+#include "ticks.h"
+#include "periph.h"
+#include "app_util_platform.h"
 
 
 /* TWI instance. */
-static const nrfx_twi_t m_twi = NRFX_TWI_INSTANCE(TWI_INSTANCE_ID);
+static const nrfx_twim_t m_twim = NRFX_TWIM_INSTANCE(TWI_INSTANCE_ID);
 static kxtj3_init_t m_accl_init;
+static nrfx_twim_config_t m_twim_config;
 static bool twi_is_init = false;
+static volatile bool twim_is_busy = false;
+static bool int_pin_is_init = false;
+static bool int_pin_is_wake = false;           //INT pin set up as low power wake input instead of DRDY
+
+/* Batch sampling, DRDY edge starts a TWIM transfer and a TIMER counts the finished ones */
+static const nrfx_timer_t m_batch_timer = NRFX_TIMER_INSTANCE(KXTJ3_TIMER_INSTANCE_ID);
+static nrf_ppi_channel_t m_ppi_sample_start;
+static nrf_ppi_channel_t m_ppi_sample_count;
+static bool batch_is_running = false;
+static uint8_t batch_fill = 0;                //Half of the batch buffer being filled by EasyDMA
+static uint8_t batch_ready = 0;               //Half of the batch buffer handed to the app loop
+static uint64_t batch_time = 0;               //ticks_ms_get() of the last sample in the ready half
+
+/* Sample period in us of each ODR_xxHZ setting */
+static const uint32_t m_odr_period_us[] = {80000, 40000, 20000, 10000, 5000, 2500, 1250, 625,
+                                           1280000, 640000, 320000, 160000};
+
+/* EasyDMA buffers, must stay in RAM for the whole transfer */
+static uint8_t m_sample_reg = XOUT_L;
+static uint8_t m_batch_buffer[2][KXTJ3_BATCH_SIZE * KXTJ3_SAMPLE_BYTES];
 static bool is_hi_res = true;
-static float angle_buffer[10] = {0};
-static float total_sum = 0;
-static uint8_t buff_count = 0;
-static uint32_t current_time = 0;
 
-/* averaging variables */
-float last_angle = -1;
 
+/**@brief TWIM event handler, called when a register write has finished or a transfer failed **/
+ static void twim_handler(nrfx_twim_evt_t const * p_event, void * p_context)
+ {
+    if(batch_is_running)
+    {
+        //Batch transfers only report errors, the driver drops the held transfer on a NACK.
+        //Restart the current batch so the sample count and the DMA pointer stay aligned.
+        batch_arm();
+        return;
+    }
+
+    twim_is_busy = false;
+ }
+
+/**@brief GPIOTE handler of the INT pin, only enabled while the wake-up engine is armed **/
+ static void accl_int_handler(nrfx_gpiote_pin_t pin, nrf_gpiote_polarity_t action)
+ {
+    event_post(EVENT_ACCL_MOTION);
+ }
+
+/**@brief TIMER event handler, called after KXTJ3_BATCH_SIZE samples have been received **/
+ static void batch_timer_handler(nrf_timer_event_t event_type, void * p_context)
+ {
+    if(event_type == NRF_TIMER_EVENT_COMPARE0)
+    {
+        //Hand the full half to the app loop, the next batch goes into the other half
+        batch_ready = batch_fill;
+        batch_fill ^= 1;
+        nrf_twim_rx_buffer_set(m_twim.p_twim, m_batch_buffer[batch_fill], KXTJ3_SAMPLE_BYTES);
+        batch_time = ticks_ms_get();
+        event_post(EVENT_ACCL_BATCH);
+    }
+ }
+
+/**@brief Function for setting up the DRDY input, TIMER and PPI channels of the batch sampler **/
+ static uint32_t batch_init(void)
+ {
+    ret_code_t err_code;
+
+    const nrfx_timer_config_t timer_config = {
+        .frequency          = NRF_TIMER_FREQ_16MHz,
+        .mode               = NRF_TIMER_MODE_COUNTER,
+        .bit_width          = NRF_TIMER_BIT_WIDTH_16,
+        .interrupt_priority = APP_IRQ_PRIORITY_LOW,
+        .p_context          = NULL
+    };
+
+    if(!nrfx_gpiote_is_init())
+    {
+        err_code = nrfx_gpiote_init();
+        VERIFY_SUCCESS(err_code);
+    }
+
+    err_code = nrfx_timer_init(&m_batch_timer, &timer_config, batch_timer_handler);
+    VERIFY_SUCCESS(err_code);
+
+    //Interrupt and restart the count every KXTJ3_BATCH_SIZE finished transfers
+    nrfx_timer_extended_compare(&m_batch_timer, NRF_TIMER_CC_CHANNEL0, KXTJ3_BATCH_SIZE,
+                                NRF_TIMER_SHORT_COMPARE0_CLEAR_MASK, true);
+
+    //DRDY -> TWIM start, assigned with the INT pin input
+    err_code = nrfx_ppi_channel_alloc(&m_ppi_sample_start);
+    VERIFY_SUCCESS(err_code);
 
-/**@brief Function writing to the KXTJ3 by I2C
+    //TWIM stopped -> TIMER count
+    err_code = nrfx_ppi_channel_alloc(&m_ppi_sample_count);
+    VERIFY_SUCCESS(err_code);
+
+    err_code = nrfx_ppi_channel_assign(m_ppi_sample_count,
+                                       nrfx_twim_stopped_event_get(&m_twim),
+                                       nrfx_timer_task_address_get(&m_batch_timer, NRF_TIMER_TASK_COUNT));
+    VERIFY_SUCCESS(err_code);
+
+    return int_pin_config(false);
+ }
+
+/**@brief Function for powering the TWIM up and down, called by the resource manager **/
+ static uint32_t twim_power(bool is_on)
+ {
+    ret_code_t err_code;
+    volatile uint32_t * p_power;
+
+    if(is_on)
+    {
+        err_code = nrfx_twim_init(&m_twim, &m_twim_config, twim_handler, NULL);      //Non-blocking mode
+        VERIFY_SUCCESS(err_code);
+
+        nrfx_twim_enable(&m_twim);
+        return NRF_SUCCESS;
+    }
+
+    nrfx_twim_uninit(&m_twim);
+
+    //nRF52832 anomaly 89, a disabled TWIM keeps drawing ~400uA while GPIOTE is in use until the
+    //peripheral is power cycled. The registers reset, the next power up initializes it again
+    p_power = (volatile uint32_t *)((uint32_t)m_twim.p_twim + 0xFFC);
+    *p_power = 0;
+    (void)*p_power;
+    *p_power = 1;
+
+    return NRF_SUCCESS;
+ }
+
+/**@brief Function for setting up the INT pin input.
  *
- * @return   NRF_SUCCESS on successful initialization, otherwise an error code.
+ * @details Sampling uses a hi accuracy IN event on the DRDY pulse, routed by PPI without interrupt.
+ *          Waiting for motion uses the low power PORT sense with an interrupt instead, so no GPIOTE
+ *          channel is kept running while the device is idle.
+ *
+ * @param[in]   wake   true for the low power wake input, false for the DRDY sampling input.
  */
- static uint32_t i2c_write(uint8_t *data, uint8_t length)
+ static uint32_t int_pin_config(bool wake)
  {
     ret_code_t err_code;
 
-    err_code = nrfx_twi_tx(&m_twi, ACCL_I2C_ADDR, data, length, false);
-    return err_code;
+    if(int_pin_is_init)
+    {
+        nrfx_gpiote_in_uninit(m_accl_init.int_pin);
+        int_pin_is_init = false;
+    }
+
+    if(wake)
+    {
+        nrfx_gpiote_in_config_t wake_config = NRFX_GPIOTE_CONFIG_IN_SENSE_LOTOHI(false);
+
+        err_code = nrfx_gpiote_in_init(m_accl_init.int_pin, &wake_config, accl_int_handler);
+        VERIFY_SUCCESS(err_code);
+    }
+    else
+    {
+        nrfx_gpiote_in_config_t drdy_config = NRFX_GPIOTE_CONFIG_IN_SENSE_LOTOHI(true);
+
+        err_code = nrfx_gpiote_in_init(m_accl_init.int_pin, &drdy_config, NULL);
+        VERIFY_SUCCESS(err_code);
+
+        //GPIOTE channel may differ from the last time, reassign the DRDY event
+        err_code = nrfx_ppi_channel_assign(m_ppi_sample_start,
+                                           nrfx_gpiote_in_event_addr_get(m_accl_init.int_pin),
+                                           nrfx_twim_start_task_get(&m_twim, NRFX_TWIM_XFER_TXRX));
+        VERIFY_SUCCESS(err_code);
+    }
+
+    int_pin_is_init = true;
+    int_pin_is_wake = wake;
+
+    return NRF_SUCCESS;
+ }
+
+/**@brief Function for preparing the held TWIM transfer for the current batch half **/
+ static uint32_t batch_arm(void)
+ {
+    nrfx_twim_xfer_desc_t xfer = NRFX_TWIM_XFER_DESC_TXRX(ACCL_I2C_ADDR, &m_sample_reg, 1,
+                                                          m_batch_buffer[batch_fill], KXTJ3_SAMPLE_BYTES);
+
+    //Transfer is started by PPI, each one lands in the next KXTJ3_SAMPLE_BYTES of the buffer
+    uint32_t flags = NRFX_TWIM_FLAG_HOLD_XFER | NRFX_TWIM_FLAG_RX_POSTINC |
+                     NRFX_TWIM_FLAG_REPEATED_XFER | NRFX_TWIM_FLAG_NO_XFER_EVT_HANDLER;
+
+    nrfx_timer_clear(&m_batch_timer);
+
+    return nrfx_twim_xfer(&m_twim, &xfer, flags);
  }
 
-/**@brief Function reading from the KXTJ3 by I2C
+/**@brief Function for a blocking register transfer with the KXTJ3 by I2C
+ *
+ * @details Register transfers are only done on init and mode changes, wait for them to finish.
  *
- * @return   NRF_SUCCESS on successful initialization, otherwise an error code.
+ * @return   NRF_SUCCESS on success, otherwise an error code.
  */
- static uint32_t i2c_read(uint8_t *data, uint8_t length)
+ static uint32_t i2c_transfer(nrfx_twim_xfer_desc_t const * p_xfer)
  {
     ret_code_t err_code;
+    bool resume_batch = batch_is_running;
+
+    //Powered for the write, taken before the batch sampler lets go of the bus
+    err_code = periph_acquire(PERIPH_TWI);
+    VERIFY_SUCCESS(err_code);
+
+    //Take the bus from the batch sampler for the write
+    if(resume_batch)
+    {
+        kxtj3_batch_stop();
+    }
+
+    twim_is_busy = true;
+    err_code = nrfx_twim_xfer(&m_twim, p_xfer, 0);
+    if(err_code != NRF_SUCCESS)
+    {
+        twim_is_busy = false;
+    }
+
+    while(twim_is_busy);
+
+    if(resume_batch)
+    {
+        kxtj3_batch_start();
+    }
+    periph_release(PERIPH_TWI);
 
-    err_code = nrfx_twi_rx(&m_twi, ACCL_I2C_ADDR, data, length);
     return err_code;
  }
 
+/**@brief Function writing to the KXTJ3 by I2C, the first byte is the register **/
+ static uint32_t i2c_write(uint8_t *data, uint8_t length)
+ {
+    nrfx_twim_xfer_desc_t xfer = NRFX_TWIM_XFER_DESC_TX(ACCL_I2C_ADDR, data, length);
+
+    return i2c_transfer(&xfer);
+ }
+
+/**@brief Function reading KXTJ3 registers by I2C **/
+ static uint32_t i2c_read(uint8_t reg, uint8_t *data, uint8_t length)
+ {
+    nrfx_twim_xfer_desc_t xfer = NRFX_TWIM_XFER_DESC_TXRX(ACCL_I2C_ADDR, &reg, 1, data, length);
+
+    return i2c_transfer(&xfer);
+ }
+
+/**@brief Function for releasing the latched wake-up interrupt, the INT pin goes back low **/
+ static uint32_t int_release(void)
+ {
+    uint8_t int_rel;
+
+    return i2c_read(INT_REL, &int_rel, 1);
+ }
+
 
 /**@brief Function for initializing the KXTJ3 Accelerometer.
  *
@@ -63,31 +287,48 @@ float last_angle = -1;
     ret_code_t err_code;
     uint8_t txBuffer[5] = {0};        //I2C transmit buffer
 
-    //Initialize the I2C module
-    const nrfx_twi_config_t twi_kxtj3_config = {
+    //I2C module, initialized by the resource manager for register writes and while batch sampling
+    const nrfx_twim_config_t twi_kxtj3_config = {
         .scl                = p_accl_init->i2c_scl_pin,
         .sda                = p_accl_init->i2c_sda_pin,
-        .frequency          = NRF_TWI_FREQ_100K,
+        .frequency          = NRF_TWIM_FREQ_400K,
         .interrupt_priority = APP_IRQ_PRIORITY_HIGH,
         .hold_bus_uninit     = false
     };
 
-    err_code = nrfx_twi_init(&m_twi, &twi_kxtj3_config, NULL, NULL);      //Blocking mode
+    m_twim_config = twi_kxtj3_config;
+    periph_register(PERIPH_TWI, twim_power);
+
+    m_accl_init = * p_accl_init;
+
+    err_code = batch_init();
     APP_ERROR_CHECK(err_code);
 
-    nrfx_twi_enable(&m_twi);
     twi_is_init = true;
 
-    m_accl_init = * p_accl_init;
-
-    //Initialize the KXTJ3 accelerometer with init settings
+    //Initialize the KXTJ3 accelerometer with init settings, only accepted in standby
     txBuffer[0] = CNTRL_REG1;
     txBuffer[1] = CNTRL_RESET;
     err_code = i2c_write(txBuffer, 2);
     if(err_code != NRF_SUCCESS)
         return err_code;
 
-    txBuffer[1] = 0x00 | p_accl_init->range_mode | p_accl_init->reso_mode | POWER_RUN_MODE;
+    //Output data rate, the sensor paces the sampling
+    txBuffer[0] = DATA_CNTRL_REG;
+    txBuffer[1] = p_accl_init->odr;
+    err_code = i2c_write(txBuffer, 2);
+    if(err_code != NRF_SUCCESS)
+        return err_code;
+
+    //INT pin active high, pulsed once per new sample for the PPI
+    txBuffer[0] = INT_CNTRL_REG1;
+    txBuffer[1] = INT_ENABLE | INT_ACTIVE_HIGH | INT_PULSED;
+    err_code = i2c_write(txBuffer, 2);
+    if(err_code != NRF_SUCCESS)
+        return err_code;
+
+    txBuffer[0] = CNTRL_REG1;
+    txBuffer[1] = 0x00 | p_accl_init->range_mode | p_accl_init->reso_mode | DRDY_ENABLE | POWER_RUN_MODE;
     err_code = i2c_write(txBuffer, 2);
 
     if(p_accl_init->reso_mode == RESO_HI_12_14Bit)
@@ -99,166 +340,114 @@ float last_angle = -1;
  }
 
 
- /**@brief Function for getting the current accelerometer angle.
+ /**@brief Function for starting the autonomous batch sampling.
  *
- * @return   float    calculated angle of the XYZ readouts of the KXTJ3.
+ * @details The KXTJ3 DRDY pulse starts a TWIM transfer through PPI at the sensor ODR. Each transfer
+ *          writes the register address and reads XYZ into the next slot of the batch buffer. The
+ *          TIMER counts finished transfers and wakes the CPU once per KXTJ3_BATCH_SIZE samples.
+ *
+ * @return      NRF_SUCCESS if sampling was started, otherwise an error code.
  */
- float kxtj3_get_angle(void)
+ uint32_t kxtj3_batch_start(void)
  {
     ret_code_t err_code;
-    uint8_t txBuffer[1] = {XOUT_L};
-    uint8_t rxBuffer[7] = {0};
 
     if(twi_is_init != true)
     {
       NRF_LOG_INFO("TWI is not initialized");
-      return 0;
+      return NRF_ERROR_INVALID_STATE;
     }
-    
-    //Read from the x,y,z axis registers of the KXTJ3
-    err_code = i2c_write(txBuffer, 1);
-    //APP_ERROR_CHECK(err_code);
-    err_code = i2c_read(rxBuffer, 6);
-    //APP_ERROR_CHECK(err_code);
-    
-    float x_valF = 0;
-    float y_valF = 0;
-    float z_valF = 0;
 
-    if(is_hi_res)
-    {
-      //Shift into 16bit variables
-      uint16_t x_u16_t  = (rxBuffer[1] << 8) | rxBuffer[0];
-      uint16_t y_u16_t  = (rxBuffer[3] << 8) | rxBuffer[2];
-      uint16_t z_u16_t  = (rxBuffer[5] << 8) | rxBuffer[4];
-
-      //2's compliment
-      uint16_t x_valT_16 = (x_u16_t & 0x8000 ? (~x_u16_t + 1) & 0xFFFF : x_u16_t) >> 4;
-      uint16_t y_valT_16 = (y_u16_t & 0x8000 ? (~y_u16_t + 1) & 0xFFFF : y_u16_t) >> 4;
-      uint16_t z_valT_16 = (z_u16_t & 0x8000 ? (~z_u16_t + 1) & 0xFFFF : z_u16_t) >> 4;
-
-      x_valF = (float) x_valT_16;
-      y_valF = (float) y_valT_16;
-      z_valF = (float) z_valT_16;
-
-      x_valF = x_valF / 512.0 * (x_u16_t & 0x8000 ? (-1.0) : (1.0));
-      y_valF = y_valF / 512.0 * (y_u16_t & 0x8000 ? (-1.0) : (1.0));
-      z_valF = z_valF / 512.0 * (z_u16_t & 0x8000 ? (-1.0) : (1.0));
-    }
-    else
+    if(batch_is_running)
     {
-      //Shift into 16bit variables
-      uint8_t x_u8_t  = rxBuffer[1];
-      uint8_t y_u8_t  = rxBuffer[3];
-      uint8_t z_u8_t  = rxBuffer[5];
-
-      //2's compliment
-      uint8_t x_valT_8 = (x_u8_t & 0x80 ? (~x_u8_t + 1) & 0xFF : x_u8_t);
-      uint8_t y_valT_8 = (y_u8_t & 0x80 ? (~y_u8_t + 1) & 0xFF : y_u8_t);
-      uint8_t z_valT_8 = (z_u8_t & 0x80 ? (~z_u8_t + 1) & 0xFF : z_u8_t);
-
-      x_valF = (float) x_valT_8;
-      y_valF = (float) y_valT_8;
-      z_valF = (float) z_valT_8;
-
-      x_valF = x_valF / 32.0 * (x_u8_t & 0x80 ? (-1.0) : (1.0));
-      y_valF = y_valF / 32.0 * (y_u8_t & 0x80 ? (-1.0) : (1.0));
-      z_valF = z_valF / 32.0 * (z_u8_t & 0x80 ? (-1.0) : (1.0));
+      return NRF_SUCCESS;
     }
 
-    if(z_valF == 0)
+    //TWIM stays powered while the batch runs, PPI starts its transfers
+    err_code = periph_acquire(PERIPH_TWI);
+    if(err_code != NRF_SUCCESS)
     {
-      //printf("divid by zero\r\n");
-      z_valF = 0.01;
+      return err_code;
     }
-    //Calculate the angle
-    float norm = sqrtf(x_valF * x_valF + y_valF * y_valF);
-    float angle = (float)atan(-1 * norm/z_valF) * 180 / 3.14159;
 
-    if(angle < 0.0f)
+    err_code = batch_arm();
+    if(err_code != NRF_SUCCESS)
     {
-      angle += 180.0f;
+      periph_release(PERIPH_TWI);
+      return err_code;
     }
 
-    return angle;
+    batch_is_running = true;
+    nrfx_timer_enable(&m_batch_timer);
+    nrfx_ppi_channel_enable(m_ppi_sample_count);
+    nrfx_ppi_channel_enable(m_ppi_sample_start);
+    nrfx_gpiote_in_event_enable(m_accl_init.int_pin, false);
+
+    return NRF_SUCCESS;
  }
 
 
- /**@brief Function for calculating filtered angle.
- *
- * @return   uint8_t    calculated filtered angle.
- */
- uint8_t kxtj3_filter_angle(float unf_angle)
+ /**@brief Function for stopping the batch sampling. **/
+ void kxtj3_batch_stop(void)
  {
-    float f_angle = 0;
-    //float temp_buff[5] = {0};
-
-
-    angle_buffer[buff_count] = unf_angle;
-    buff_count++;
-    total_sum += unf_angle;
-
-    if(buff_count >= 10)
-    {
-      f_angle = total_sum/BUFFER_SIZE;
-      buff_count = 0;
-      total_sum = 0;
-
-      return (uint8_t)f_angle;
-    }
-    else 
+    if(!batch_is_running)
     {
-      return 200;
+      return;
     }
 
+    nrfx_gpiote_in_event_disable(m_accl_init.int_pin);
+    nrfx_ppi_channel_disable(m_ppi_sample_start);
+
+    //Let a transfer started by the last DRDY finish before the bus is reused
+    nrf_delay_us(KXTJ3_XFER_TIME_US);
 
+    nrfx_ppi_channel_disable(m_ppi_sample_count);
+    nrfx_timer_disable(&m_batch_timer);
+    batch_is_running = false;
+    periph_release(PERIPH_TWI);
+ }
 
 
-/*
-    memcpy(temp_buff, angle_buffer, sizeof(angle_buffer));
-    angle_buffer[0] = unf_angle;
-    total_sum = unf_angle;
+ /**@brief Function for getting a raw sample of the received batch.
+ *
+ * @param[in]   sample   Index of the sample in the batch, 0 is the oldest.
+ * @param[out]  p_xyz    X, Y, Z readouts of the KXTJ3, signed and left justified.
+ */
+ void kxtj3_get_sample(uint8_t sample, int16_t * p_xyz)
+ {
+    uint8_t * rxBuffer = &m_batch_buffer[batch_ready][sample * KXTJ3_SAMPLE_BYTES];
 
-    uint8_t i;
-    for(i = 1; i<5; i++)
-    {
-        angle_buffer[i] = temp_buff[i-1];
-        total_sum += temp_buff[i-1];
-    }
+    //Left justified 2's complement output, the low byte is only valid in hi res mode
+    uint8_t low_mask = is_hi_res ? 0xFF : 0x00;
+    p_xyz[0] = (int16_t)((rxBuffer[1] << 8) | (rxBuffer[0] & low_mask));
+    p_xyz[1] = (int16_t)((rxBuffer[3] << 8) | (rxBuffer[2] & low_mask));
+    p_xyz[2] = (int16_t)((rxBuffer[5] << 8) | (rxBuffer[4] & low_mask));
+ }
 
-    f_angle = total_sum / 5;
-  
-    current_time = millis();
 
-    Extra filtering during motor
-    if(!is_motor_stopped() && compare_millis(motor_roll_delay, current_time) > MOTOR_ROLL_TIMEOUT)
-    {
-        if(last_angle <= 0)
-        {
-            last_angle = f_angle;
-        }
-
-        // Filtering uses exponential smoothing.
-        f_angle = last_angle + (SMOOTH_FACTOR)*(f_angle - last_angle); 
-     }
-    
-    if(f_angle >= (last_angle + 2))
-    {
-        f_angle = (last_angle + 2);
-    }
-    else if(f_angle <= (last_angle-2))
+ /**@brief Function for getting the time a sample of the received batch was taken.
+ *
+ * @param[in]   sample   Index of the sample in the batch, 0 is the oldest.
+ *
+ * @return   uint64_t    ticks_ms_get() time of the sample.
+ */
+ uint64_t kxtj3_sample_time_get(uint8_t sample)
+ {
+    uint32_t age_us = 0;
+    uint64_t time;
+
+    //Samples are evenly spaced at the ODR, the last one completed the batch
+    if(m_accl_init.odr < (sizeof(m_odr_period_us) / sizeof(m_odr_period_us[0])))
     {
-        f_angle = (last_angle - 2);
+        age_us = (uint32_t)(KXTJ3_BATCH_SIZE - 1 - sample) * m_odr_period_us[m_accl_init.odr];
     }
-    else
-    {
-    } 
 
-    last_angle = f_angle;
+    //Written by the batch interrupt, 64bit is not read atomically
+    CRITICAL_REGION_ENTER();
+    time = batch_time;
+    CRITICAL_REGION_EXIT();
 
-
-    return (uint8_t)f_angle;
-   */
+    return time - (age_us / 1000);
  }
 
 
@@ -268,21 +457,130 @@ uint32_t kxtj3_power_mode(uint8_t p_mode)
     ret_code_t err_code;
     uint8_t txBuffer[2] = {0};
 
-    if(p_mode == POWER_STNDBY_MODE)
+    //place KXTJ3 into standby mode, CNTRL_REG1 can only be changed in standby
+    txBuffer[0] = CNTRL_REG1;
+    txBuffer[1] = POWER_STNDBY_MODE;
+    err_code = i2c_write(txBuffer, 2);
+    VERIFY_SUCCESS(err_code);
+
+    //Leaving the wake-up mode, INT pin goes back to pulsed DRDY sampling
+    if(int_pin_is_wake)
     {
-        //place KXTJ3 into standby mode
-        txBuffer[0] = CNTRL_REG1;
-        txBuffer[1] = POWER_STNDBY_MODE;
+        nrfx_gpiote_in_event_disable(m_accl_init.int_pin);
+
+        txBuffer[0] = INT_CNTRL_REG1;
+        txBuffer[1] = INT_ENABLE | INT_ACTIVE_HIGH | INT_PULSED;
         err_code = i2c_write(txBuffer, 2);
+        VERIFY_SUCCESS(err_code);
+
+        err_code = int_release();
+        VERIFY_SUCCESS(err_code);
+
+        err_code = int_pin_config(false);
+        VERIFY_SUCCESS(err_code);
+
+        txBuffer[0] = CNTRL_REG1;
     }
-    else
+
+    if(p_mode != POWER_STNDBY_MODE && err_code == NRF_SUCCESS)
     {
-        //place KXTJ3 into standby mode
-        txBuffer[0] = CNTRL_REG1;
-        txBuffer[1] = 0x00 | m_accl_init.range_mode | m_accl_init.reso_mode | POWER_RUN_MODE;
+        //place KXTJ3 into operating mode
+        txBuffer[1] = 0x00 | m_accl_init.range_mode | m_accl_init.reso_mode | DRDY_ENABLE | POWER_RUN_MODE;
         err_code = i2c_write(txBuffer, 2);
     }
 
     return err_code;
     
-}
\ No newline at end of file
+}
+
+
+/**@brief Function to arm the KXTJ3 wake-up engine and wait for motion.
+ *
+ * @details Angle sampling is stopped. The KXTJ3 runs only the wake-up function at the low wake
+ *          ODR and latches the INT pin high when the acceleration changes by more than the
+ *          threshold for the set number of samples. A ~50us pulse could end before the PORT sense
+ *          sees it, the level stays until INT_REL is read. EVENT_ACCL_MOTION is posted on the edge.
+ *
+ * @return   NRF_SUCCESS on success, otherwise an error code.
+ */
+uint32_t kxtj3_motion_wake_enable(void)
+{
+    ret_code_t err_code;
+    uint8_t txBuffer[2] = {0};
+
+    kxtj3_batch_stop();
+
+    //Registers can only be changed in standby
+    txBuffer[0] = CNTRL_REG1;
+    txBuffer[1] = POWER_STNDBY_MODE;
+    err_code = i2c_write(txBuffer, 2);
+    VERIFY_SUCCESS(err_code);
+
+    txBuffer[0] = CNTRL_REG2;
+    txBuffer[1] = m_accl_init.wake_odr;
+    err_code = i2c_write(txBuffer, 2);
+    VERIFY_SUCCESS(err_code);
+
+    //Motion on any axis in either direction
+    txBuffer[0] = INT_CNTRL_REG2;
+    txBuffer[1] = WUF_ALL_AXES;
+    err_code = i2c_write(txBuffer, 2);
+    VERIFY_SUCCESS(err_code);
+
+    //Latched until INT_REL is read, the level is held for the PORT sense and System OFF wake
+    txBuffer[0] = INT_CNTRL_REG1;
+    txBuffer[1] = INT_ENABLE | INT_ACTIVE_HIGH;
+    err_code = i2c_write(txBuffer, 2);
+    VERIFY_SUCCESS(err_code);
+
+    txBuffer[0] = WAKEUP_COUNTER;
+    txBuffer[1] = m_accl_init.wake_counter;
+    err_code = i2c_write(txBuffer, 2);
+    VERIFY_SUCCESS(err_code);
+
+    //12bit threshold, bits 11:4 in the high register and bits 3:0 in the top of the low register
+    txBuffer[0] = WAKEUP_THRESHOLD_H;
+    txBuffer[1] = (uint8_t)(m_accl_init.wake_threshold >> 4);
+    err_code = i2c_write(txBuffer, 2);
+    VERIFY_SUCCESS(err_code);
+
+    txBuffer[0] = WAKEUP_THRESHOLD_L;
+    txBuffer[1] = (uint8_t)((m_accl_init.wake_threshold & 0x0F) << 4);
+    err_code = i2c_write(txBuffer, 2);
+    VERIFY_SUCCESS(err_code);
+
+    //Low resolution, wake-up function only, no data ready
+    txBuffer[0] = CNTRL_REG1;
+    txBuffer[1] = 0x00 | m_accl_init.range_mode | RESO_LOW_8BIT | WUF_ENABLE | POWER_RUN_MODE;
+    err_code = i2c_write(txBuffer, 2);
+    VERIFY_SUCCESS(err_code);
+
+    //A latch left from before would hold the pin high and hide the next motion
+    err_code = int_release();
+    VERIFY_SUCCESS(err_code);
+
+    err_code = int_pin_config(true);
+    VERIFY_SUCCESS(err_code);
+
+    nrfx_gpiote_in_event_enable(m_accl_init.int_pin, true);
+
+    return NRF_SUCCESS;
+}
+
+
+/**@brief Function to release the wake-up interrupt and wait for the next motion.
+ *
+ * @details The latched INT pin stays high after a motion event until released. Called when the
+ *          motion did not take the app out of the wake-up mode.
+ *
+ * @return   NRF_SUCCESS on success, otherwise an error code.
+ */
+uint32_t kxtj3_motion_wake_ack(void)
+{
+    if(!int_pin_is_wake)
+    {
+        return NRF_SUCCESS;
+    }
+
+    return int_release();
+}
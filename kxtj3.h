@@ -19,6 +19,8 @@ extern "C" {
 #define ACCL_I2C_ADDR         0x0F
 /* TWI instance ID. */
 #define TWI_INSTANCE_ID       0
+/* Batch sampling counter, TIMER1/2 are used by csense */
+#define KXTJ3_TIMER_INSTANCE_ID   3
 
 /** KXTJ3 Register definitions **/
 #define XOUT_L                0x06
@@ -28,7 +30,19 @@ extern "C" {
 #define ZOUT_L                0x0A
 #define ZOUT_H                0x0B
 #define CNTRL_REG1            0x1B
+#define CNTRL_REG2            0x1D
+#define INT_CNTRL_REG1        0x1E
+#define INT_CNTRL_REG2        0x1F
 #define DATA_CNTRL_REG        0x21
+#define INT_REL               0x1A      //Read to release the latched interrupt
+#define WAKEUP_COUNTER        0x29
+#define WAKEUP_THRESHOLD_H    0x6A
+#define WAKEUP_THRESHOLD_L    0x6B
+#define KXTJ3_SAMPLE_BYTES    6         //XOUT_L to ZOUT_H
+
+/** Batch sampling definitions **/
+#define KXTJ3_BATCH_SIZE      10        //Samples per CPU wakeup
+#define KXTJ3_XFER_TIME_US    500       //Longest sample transfer at 400kHz, with margin
 
 /** KXTJ3 Mode definitions **/
 #define RESO_HI_12_14Bit      0x40
@@ -37,19 +51,51 @@ extern "C" {
 #define POWER_STNDBY_MODE     0x00
 #define POWER_RUN_MODE        0x80
 #define CNTRL_RESET           0x00
-
-/** Averaging Definitions **/
-#define SMOOTH_FACTOR         0.05
-#define MOTOR_SMOOTH_FACTOR   0.01
-#define BUFFER_SIZE           10
+#define DRDY_ENABLE           0x20      //CNTRL_REG1 DRDYE, data ready on the INT pin
+#define WUF_ENABLE            0x02      //CNTRL_REG1 WUFE, wake-up function on the INT pin
+
+/** KXTJ3 Interrupt definitions, INT_CNTRL_REG1 **/
+#define INT_ENABLE            0x20
+#define INT_ACTIVE_HIGH       0x10
+#define INT_PULSED            0x08      //~50us pulse per event instead of latched until INT_REL read
+
+/** KXTJ3 Wake-up definitions, INT_CNTRL_REG2 and CNTRL_REG2 **/
+#define WUF_ALL_AXES          0x3F      //X, Y and Z motion in both directions
+#define WUF_ODR_0_781HZ       0x00
+#define WUF_ODR_1_563HZ       0x01
+#define WUF_ODR_3_125HZ       0x02
+#define WUF_ODR_6_25HZ        0x03
+#define WUF_ODR_12_5HZ        0x04
+#define WUF_ODR_25HZ          0x05
+#define WUF_ODR_50HZ          0x06
+#define WUF_ODR_100HZ         0x07
+
+/** KXTJ3 Output data rate definitions, DATA_CNTRL_REG **/
+#define ODR_0_781HZ           0x08
+#define ODR_1_563HZ           0x09
+#define ODR_3_125HZ           0x0A
+#define ODR_6_25HZ            0x0B
+#define ODR_12_5HZ            0x00
+#define ODR_25HZ              0x01
+#define ODR_50HZ              0x02
+#define ODR_100HZ             0x03
+#define ODR_200HZ             0x04
+#define ODR_400HZ             0x05
+#define ODR_800HZ             0x06
+#define ODR_1600HZ            0x07
 
 /** @brief KXTJ3  init object Struct **/
 typedef struct
 {
     uint8_t i2c_scl_pin;
     uint8_t i2c_sda_pin;
+    uint8_t int_pin;            //KXTJ3 INT pin, data ready pulses start the sampling
     uint8_t reso_mode;
     uint8_t range_mode;
+    uint8_t odr;                //Output data rate, ODR_xxHZ
+    uint8_t wake_odr;           //Wake-up function data rate, WUF_ODR_xxHZ
+    uint16_t wake_threshold;    //Wake-up threshold in counts of 1/256 g, 12bit
+    uint8_t wake_counter;       //Samples at wake_odr above the threshold before waking
 } kxtj3_init_t;
 
 
@@ -62,22 +108,74 @@ typedef struct
  uint32_t kxtj3_init(kxtj3_init_t * p_accl_init);
 
 
-/**@brief Function for getting the current accelerometer angle.
+/**@brief Function for starting the autonomous batch sampling.
+ *
+ * @details Samples are taken by DRDY, PPI and TWIM without the CPU. EVENT_ACCL_BATCH is posted
+ *          once KXTJ3_BATCH_SIZE samples have been received.
+ *
+ * @return      NRF_SUCCESS if sampling was started, otherwise an error code.
+ */
+ uint32_t kxtj3_batch_start(void);
+
+
+/**@brief Function for stopping the batch sampling. **/
+ void kxtj3_batch_stop(void);
+
+
+/**@brief Function for getting a raw sample of the received batch.
  *
- * @return   float    calculated angle of the XYZ readouts of the KXTJ3.
+ * @param[in]   sample   Index of the sample in the batch, 0 is the oldest.
+ * @param[out]  p_xyz    X, Y, Z readouts of the KXTJ3, signed and left justified.
  */
- float kxtj3_get_angle(void);
+ void kxtj3_get_sample(uint8_t sample, int16_t * p_xyz);
 
 
- /**@brief Function for calculating filtered angle.
+/**@brief Function for getting the time a sample of the received batch was taken.
  *
- * @return   float    calculated filtered angle.
+ * @param[in]   sample   Index of the sample in the batch, 0 is the oldest.
+ *
+ * @return   uint64_t    ticks_ms_get() time of the sample.
  */
- uint8_t kxtj3_filter_angle(float unf_angle);
+ uint64_t kxtj3_sample_time_get(uint8_t sample);
 
 
 /**@brief Function to put the KXTJ3 accelerometer into standby/operating mode **/
 uint32_t kxtj3_power_mode(uint8_t p_mode);
 
+/**@brief Function to arm the KXTJ3 wake-up engine and wait for motion.
+ *
+ * @details Stops angle sampling, EVENT_ACCL_MOTION is posted by the INT pin when motion occurs.
+ *          Call kxtj3_power_mode(POWER_RUN_MODE) to go back to sampling.
+ *
+ * @return   NRF_SUCCESS on success, otherwise an error code.
+ */
+uint32_t kxtj3_motion_wake_enable(void);
+
+/**@brief Function to release the latched wake-up interrupt after a motion event.
+ *
+ * @details Call when the motion does not end the wake-up mode, otherwise the INT pin stays high
+ *          and no further EVENT_ACCL_MOTION is posted.
+ *
+ * @return   NRF_SUCCESS on success, otherwise an error code.
+ */
+uint32_t kxtj3_motion_wake_ack(void);
+
+/* Static Functions */
+
+/* Sets up the DRDY input, TIMER and PPI channels of the batch sampler */
+static uint32_t batch_init(void);
+
+/* Prepares the held TWIM transfer for the current batch half */
+static uint32_t batch_arm(void);
+
+/* Sets up the INT pin as DRDY sampling input or low power wake input */
+static uint32_t int_pin_config(bool wake);
+
+/* Reads INT_REL, the latched INT pin goes back low */
+static uint32_t int_release(void);
+
+/* Enables or disables the TWIM for the resource manager */
+static uint32_t twim_power(bool is_on);
+
 
 #endif
\ No newline at end of file
@@ -0,0 +1,144 @@
+/* File: led.c */
+
+/** C file for the SwivX LED pattern engine **/
+
+
+#include "led.h"
+#include "custom_board.h"
+#include "app_util_platform.h"
+#include "sdk_macros.h"
+#include "diag.h"
+
+/** PWM Driver instance, PWM0 drives the motor **/
+static nrfx_pwm_t m_pwm1 = NRFX_PWM_INSTANCE(1);
+
+/* Blink sequence pair, values must stay in RAM for EasyDMA */
+static nrf_pwm_values_individual_t m_seq_on_values;
+static nrf_pwm_values_individual_t m_seq_off_values;
+static nrf_pwm_sequence_t m_seq_on =
+{
+    .values.p_individual = &m_seq_on_values,
+    .length = NRF_PWM_VALUES_LENGTH(m_seq_on_values),
+    .repeats = 0,
+    .end_delay = 0
+};
+static nrf_pwm_sequence_t m_seq_off =
+{
+    .values.p_individual = &m_seq_off_values,
+    .length = NRF_PWM_VALUES_LENGTH(m_seq_off_values),
+    .repeats = 0,
+    .end_delay = 0
+};
+static led_pattern_t const * p_playing = NULL;  //Looping pattern, NULL if none
+static bool is_led_init = false;
+
+
+/**@brief Function for initializing the LED PWM. **/
+uint32_t led_init(void)
+{
+    ret_code_t err_code;
+
+    //Inverted pins idle high, the LEDs are off while the PWM is stopped
+    nrfx_pwm_config_t const config1 =
+    {
+        .output_pins =
+        {
+            LED_R | NRFX_PWM_PIN_INVERTED,
+            LED_G | NRFX_PWM_PIN_INVERTED,
+            LED_B | NRFX_PWM_PIN_INVERTED,
+            NRFX_PWM_PIN_NOT_USED
+        },
+        .irq_priority = APP_IRQ_PRIORITY_LOWEST,
+        .base_clock = NRF_PWM_CLK_125kHz,
+        .count_mode = NRF_PWM_MODE_UP,
+        .top_value = LED_PWM_TOP,
+        .load_mode = NRF_PWM_LOAD_INDIVIDUAL,
+        .step_mode = NRF_PWM_STEP_AUTO
+    };
+
+    //No handler, the driver then keeps the PWM interrupt disabled
+    err_code = nrfx_pwm_init(&m_pwm1, &config1, NULL);
+    VERIFY_SUCCESS(err_code);
+
+    //Rising edge polarity, the pin is low (LED on) until the counter reaches the value
+    m_seq_off_values.channel_0 = 0;
+    m_seq_off_values.channel_1 = 0;
+    m_seq_off_values.channel_2 = 0;
+    m_seq_off_values.channel_3 = 0;
+
+    is_led_init = true;
+
+    return NRF_SUCCESS;
+}
+
+
+/**@brief Function for playing a blink pattern. **/
+uint32_t led_pattern_play(led_pattern_t const * p_pattern)
+{
+    if(p_pattern == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    if(!is_led_init)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    //Keep the phase of a blink that is already running
+    if(p_pattern == p_playing)
+    {
+        return NRF_SUCCESS;
+    }
+
+    led_stop();
+
+    m_seq_on_values.channel_0 = p_pattern->red;
+    m_seq_on_values.channel_1 = p_pattern->green;
+    m_seq_on_values.channel_2 = p_pattern->blue;
+    m_seq_on_values.channel_3 = 0;
+    m_seq_on.repeats = led_periods(p_pattern->on_ms) - 1;
+    m_seq_off.repeats = led_periods(p_pattern->off_ms) - 1;
+
+    if(p_pattern->count == LED_PATTERN_LOOP)
+    {
+        //LOOPSDONE restarts the pair in hardware, nothing to do until the next pattern
+        p_playing = p_pattern;
+        diag_on(DIAG_SUBSYS_LED);
+        (void)nrfx_pwm_complex_playback(&m_pwm1, &m_seq_on, &m_seq_off, 1, NRFX_PWM_FLAG_LOOP);
+    }
+    else
+    {
+        //Stops by itself, no interrupt to tell so the length is accounted up front
+        diag_add(DIAG_SUBSYS_LED, (uint32_t)p_pattern->count * (p_pattern->on_ms + p_pattern->off_ms));
+        (void)nrfx_pwm_complex_playback(&m_pwm1, &m_seq_on, &m_seq_off, p_pattern->count, NRFX_PWM_FLAG_STOP);
+    }
+
+    return NRF_SUCCESS;
+}
+
+
+/**@brief Function for stopping the playing pattern, all LEDs off. **/
+void led_stop(void)
+{
+    if(!is_led_init)
+    {
+        return;
+    }
+
+    //Stops at the end of the PWM period, at most LED_PWM_PERIOD_US. Polls the STOPPED event,
+    //safe from any interrupt priority
+    (void)nrfx_pwm_stop(&m_pwm1, true);
+
+    p_playing = NULL;
+    diag_off(DIAG_SUBSYS_LED);
+}
+
+
+/* Converts a time in ms to PWM periods, at least one */
+static uint32_t led_periods(uint16_t ms)
+{
+    uint32_t periods = (((uint32_t)ms * 1000) + (LED_PWM_PERIOD_US / 2)) / LED_PWM_PERIOD_US;
+
+    return (periods > 0) ? periods : 1;
+}
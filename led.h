@@ -0,0 +1,64 @@
+/* Header file led.h */
+
+/** Header file for the SwivX LED pattern engine **/
+
+
+
+#ifndef LED_H
+#define LED_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "nrfx_pwm.h"
+
+//PWM at 125kHz, top of 255 is a 2.04ms period. A channel value is its brightness, LEDs are active low
+#define LED_PWM_TOP             255
+#define LED_PWM_PERIOD_US       2040
+#define LED_LEVEL_MAX           LED_PWM_TOP
+
+#define LED_PATTERN_LOOP        0           //Pattern count, blinks until another pattern or led_stop
+
+/** Blink pattern, red/green/blue levels are mixed for other colours **/
+typedef struct
+{
+    uint8_t red;                //Brightness 0..LED_LEVEL_MAX
+    uint8_t green;
+    uint8_t blue;
+    uint8_t count;              //Blinks to play, LED_PATTERN_LOOP for endless
+    uint16_t on_ms;
+    uint16_t off_ms;
+} led_pattern_t;
+
+
+/**@brief Function for initializing the LED PWM.
+ *
+ * @details The PWM runs without interrupts, patterns play in hardware only.
+ *
+ * @return   NRF_SUCCESS on success, otherwise an error code.
+ */
+uint32_t led_init(void);
+
+/**@brief Function for playing a blink pattern.
+ *
+ * @details The on and off times loop in the PWM, the CPU is not woken up while the pattern
+ *          plays. A looping pattern that is already playing is not restarted.
+ *
+ * @param[in]   p_pattern   Pattern to play, must stay valid while it plays.
+ *
+ * @return   NRF_SUCCESS on success, otherwise an error code.
+ */
+uint32_t led_pattern_play(led_pattern_t const * p_pattern);
+
+/**@brief Function for stopping the playing pattern, all LEDs off. **/
+void led_stop(void);
+
+/* Static Functions */
+
+/* Convert a time in ms to PWM periods, at least one */
+static uint32_t led_periods(uint16_t ms);
+
+#endif
@@ -4,6 +4,15 @@
 
 
 #include "log.h"
+#include "epoch.h"
+#include "filter.h"
+#include "haptic.h"
+#include "event.h"
+#include "ticks.h"
+#include "app_util_platform.h"
+#include "nrf_fstorage.h"
+#include "diag.h"
+#include "trace.h"
 
 static bool volatile fds_is_init;
 settingsStruct settings_register;
@@ -13,8 +22,14 @@ static uint8_t save_period_index = 0;
 static uint8_t log_current_page = 0;
 static bool isFlashWriting = false;
 union timeStampUnion epoch_time;
-uint32_t last_log_time = 0;
-bool runGC = false;
+uint64_t last_log_time = 0;
+
+//Live log sync variables
+static uint8_t logReadBuffer[LOG_BYTES_PER_PAGE];   //Cache of a committed page that is being sent
+static uint8_t log_read_page = LOG_PAGE_INVALID;
+static uint32_t log_send_pos = 0;                   //Ring offset of the next packet to notify
+static uint16_t log_inflight = 0;                   //Packets notified but not yet acknowledged
+static uint16_t log_ack_skip = 0;                   //In flight packets dropped by a ring overwrite
 
 
 
@@ -80,6 +95,7 @@ static void settings_reg_init(void)
         settings_register.motor_pulses = 3;
         settings_register.touchDuration = 30000;
         settings_register.timestamp = 0x5F7EC4FA;
+        settings_reg_new_fields_init();
 
         settings_reg_flash_write();
     }
@@ -89,8 +105,22 @@ static void settings_reg_init(void)
     //Set Current data log buffer index
     data_counter = settings_register.angleLogHead % LOG_BYTES_PER_PAGE;
     log_current_page = (settings_register.angleLogHead) / LOG_BYTES_PER_PAGE;
+    //Nothing has been sent since reset, start at the durable tail
+    log_send_pos = settings_register.angleLogTail;
  }
 
+/* @brief Function to set the fields added after the first layout to their defaults */
+static void settings_reg_new_fields_init(void)
+{
+    settings_register.clockDrift = 0;
+    settings_register.filterMedian = FILTER_DEFAULT_MEDIAN;
+    settings_register.filterIirShift = FILTER_DEFAULT_IIR_SHIFT;
+    settings_register.filterDecimation = FILTER_DEFAULT_DECIMATION;
+    memset(settings_register.gravityRef, 0, sizeof(settings_register.gravityRef));
+    settings_register.hapticSlot = HAPTIC_SLOT_NONE;
+    settings_register.layoutMagic = SETTINGS_LAYOUT_MAGIC;
+}
+
 
 /* @brief Function for handling FDS events */
 static void log_fds_evt_handler(fds_evt_t const * p_evt)
@@ -110,14 +140,25 @@ static void log_fds_evt_handler(fds_evt_t const * p_evt)
             {
                 NRF_LOG_INFO("FDS data Saved!");
                 isFlashWriting = false;
+                diag_count(DIAG_COUNTER_FLASH_WRITE, 1);
+            }
+            break;
+
+        case FDS_EVT_UPDATE:
+        case FDS_EVT_DEL_RECORD:
+            if(p_evt->result == NRF_SUCCESS)
+            {
+                diag_count(DIAG_COUNTER_FLASH_WRITE, 1);
             }
             break;
 
         case FDS_EVT_GC:
+            diag_off(DIAG_SUBSYS_FDS_GC);
             if(p_evt->result == NRF_SUCCESS)
             {
                 NRF_LOG_INFO("FDS GC cleared");
                 is_on_GC = false;
+                diag_count(DIAG_COUNTER_FLASH_ERASE, 1);
             }
             break;
 
@@ -159,6 +200,8 @@ void log_full_flush(void)
     data_counter = 0;
     save_period_index = 0;
     log_current_page = 0;
+    log_read_page = LOG_PAGE_INVALID;
+    log_send_rewind();
     err_code = settings_reg_flash_write();
     APP_ERROR_CHECK(err_code);
 
@@ -182,6 +225,7 @@ bool log_write(uint8_t log_data)
     if(save_period_index == LOG_SAVE_PERIOD)
     {
         //Check if head and tail overlap
+        CRITICAL_REGION_ENTER();
         if(settings_register.angleLogHead == settings_register.angleLogTail && isLogFull)
         {
             //Shift tail by 1 packet
@@ -192,11 +236,25 @@ bool log_write(uint8_t log_data)
             {
                 settings_register.angleLogTail = 0;
             }
+
+            //Oldest packet is gone, keep the send cursor at or after the tail
+            if(log_inflight > 0)
+            {
+                log_inflight--;
+                log_ack_skip++;
+            }
+            else
+            {
+                log_send_pos = settings_register.angleLogTail;
+            }
         }
+        CRITICAL_REGION_EXIT();
 
         //Reset period index counter
         save_period_index = 0;
-        //Add EPOCH timestamp data to packet
+        //Add EPOCH timestamp data to packet, persisted with the settings register
+        settings_register.timestamp = epoch_get_monotonic();
+        settings_register.clockDrift = epoch_drift_get();
         epoch_time.time = settings_register.timestamp;
         angleLogBuffer[data_counter] = epoch_time.bytes[3];
         angleLogBuffer[data_counter + 1] = epoch_time.bytes[2];
@@ -206,7 +264,7 @@ bool log_write(uint8_t log_data)
         settings_register.angleLogHead += 18;
         
         //printf("time stamp: %X %X\r\n", epoch_time.bytes[1], epoch_time.bytes[0]);
-        printf("head: %d, tail: %d\r\n", settings_register.angleLogHead, settings_register.angleLogTail);
+        TRACE(TRACE_LOG_WRITE, settings_register.angleLogHead, settings_register.angleLogTail);
         err_code = log_flash_write(log_current_page);
         if(err_code == FDS_ERR_NO_SPACE_IN_FLASH)
         {
@@ -214,10 +272,11 @@ bool log_write(uint8_t log_data)
             isLogFull = false;
             settings_register.angleLogTail = 0;
             settings_register.angleLogHead = 0;
+            log_send_rewind();
         }
         err_code = settings_reg_flash_write();
         APP_ERROR_CHECK(err_code);
-        last_log_time = millis();
+        last_log_time = ticks_ms_get();
         did_page_save = true;
 
         if(data_counter >= LOG_BYTES_PER_PAGE)
@@ -247,6 +306,8 @@ bool log_write(uint8_t log_data)
         while(isFlashWriting);
         data_counter = 0;
         is_new_page = false;
+        //Cached send page may be the one that is overwritten next
+        log_read_page = LOG_PAGE_INVALID;
     
         //Load next page into log buffer
         if(log_flash_read(log_current_page, angleLogBuffer));
@@ -263,6 +324,95 @@ bool log_write(uint8_t log_data)
 }
 
 
+/* @brief Function for getting the next committed packet that has not been notified */
+bool log_send_next(uint8_t * packet)
+{
+    uint8_t page = log_send_pos / LOG_BYTES_PER_PAGE;
+    uint32_t page_byte = log_send_pos % LOG_BYTES_PER_PAGE;
+
+    //All committed packets are sent or in flight
+    if((get_log_size() / LOG_PACKET_SIZE) <= log_inflight)
+    {
+        return false;
+    }
+
+    if(page == log_current_page)
+    {
+        //Packet is in the page that is being logged to
+        memcpy(packet, &angleLogBuffer[page_byte], LOG_PACKET_SIZE);
+        return true;
+    }
+
+    if(page != log_read_page)
+    {
+        if(!log_flash_read(page, logReadBuffer))
+        {
+            //Page not readable yet, try again later
+            log_read_page = LOG_PAGE_INVALID;
+            return false;
+        }
+        log_read_page = page;
+    }
+
+    memcpy(packet, &logReadBuffer[page_byte], LOG_PACKET_SIZE);
+    return true;
+}
+
+/* @brief Function for moving the send cursor past a packet that was queued for notification */
+void log_send_commit(void)
+{
+    CRITICAL_REGION_ENTER();
+    log_send_pos += LOG_PACKET_SIZE;
+    if(log_send_pos >= LOG_MAX_BYTES)
+    {
+        log_send_pos = 0;
+    }
+    log_inflight++;
+    CRITICAL_REGION_EXIT();
+}
+
+/* @brief Function for advancing the durable tail by the acknowledged packets */
+void log_send_ack(uint16_t count)
+{
+    CRITICAL_REGION_ENTER();
+    //Acks for packets that were overwritten, the tail already moved past them
+    while(count > 0 && log_ack_skip > 0)
+    {
+        count--;
+        log_ack_skip--;
+    }
+
+    if(count > log_inflight)
+    {
+        count = log_inflight;
+    }
+    log_inflight -= count;
+
+    settings_register.angleLogTail += (uint32_t)count * LOG_PACKET_SIZE;
+    if(settings_register.angleLogTail >= LOG_MAX_BYTES)
+    {
+        settings_register.angleLogTail -= LOG_MAX_BYTES;
+    }
+
+    //Caught up with the head, log is empty and not full
+    if(count > 0 && settings_register.angleLogTail == settings_register.angleLogHead)
+    {
+        isLogFull = false;
+    }
+    CRITICAL_REGION_EXIT();
+}
+
+/* @brief Function for resending every packet that has not been acknowledged */
+void log_send_rewind(void)
+{
+    CRITICAL_REGION_ENTER();
+    log_send_pos = settings_register.angleLogTail;
+    log_inflight = 0;
+    log_ack_skip = 0;
+    CRITICAL_REGION_EXIT();
+}
+
+
 /* @brief Function for saving Log data to flash */
 uint32_t log_flash_write(uint8_t page)
 {
@@ -299,14 +449,14 @@ uint32_t log_flash_write(uint8_t page)
         {
           NRF_LOG_INFO("Log ran out of space for real\r\n");
         }
-        NRF_LOG_INFO("Log updating, page: %d\r\n", page);
+        TRACE(TRACE_LOG_PAGE, page, false);
         isFlashWriting = true;
-        runGC = true;
+        event_post(EVENT_FDS_GC);
     }
     else
     {
         err_code = fds_record_write(&record_desc, &record);
-        NRF_LOG_INFO("Log creating, page: %d\r\n", page);
+        TRACE(TRACE_LOG_PAGE, page, true);
     }
 
     return err_code;
@@ -362,7 +512,7 @@ uint32_t settings_reg_flash_write(void)
     record.file_id = SETTINGS_FILE_ID;
     record.key = SETTINGS_FILE_KEY;
     record.data.p_data = &settings_register;
-    record.data.length_words = (sizeof(settings_register)); //24 bytes
+    record.data.length_words = (sizeof(settings_register) + 3) / 4;
     memset(&ftok, 0x00, sizeof(fds_find_token_t));
 
     //If record exists, update.
@@ -375,7 +525,7 @@ uint32_t settings_reg_flash_write(void)
         APP_ERROR_CHECK(err_code);
         NRF_LOG_INFO("Settings registery updating.\r\n");
         isFlashWriting = true;
-        runGC = true;
+        event_post(EVENT_FDS_GC);
     }
     else
     {
@@ -393,6 +543,7 @@ bool settings_reg_flash_recall(void)
 {
     ret_code_t err_code;
     bool isValid = false;
+    bool is_layout_changed = false;
 
     fds_flash_record_t  record;
     fds_record_desc_t   record_desc;
@@ -409,12 +560,33 @@ bool settings_reg_flash_recall(void)
             return isValid;
         }
 
-        //Copy settings register from flash
-        memcpy(&settings_register, record.p_data, sizeof(settingsStruct));
-        isValid = true;
+        uint32_t length = record.p_header->length_words * sizeof(uint32_t);
+        settingsStruct const * p_saved = (settingsStruct const *)record.p_data;
+
+        if(length >= sizeof(settingsStruct) && p_saved->layoutMagic == SETTINGS_LAYOUT_MAGIC)
+        {
+            //Copy settings register from flash
+            memcpy(&settings_register, record.p_data, sizeof(settingsStruct));
+            isValid = true;
+        }
+        else if(length >= SETTINGS_LEGACY_SIZE)
+        {
+            //Older layout, keep the log position and the user settings, the rest is new
+            NRF_LOG_INFO("Settings layout changed, new fields reinit");
+            memcpy(&settings_register, record.p_data, SETTINGS_LEGACY_SIZE);
+            settings_reg_new_fields_init();
+            isValid = true;
+            is_layout_changed = true;
+        }
         fds_record_close(&record_desc);
     }
 
+    //Save the current layout, after the record is closed
+    if(is_layout_changed)
+    {
+        settings_reg_flash_write();
+    }
+
     return isValid;
 
 }
@@ -439,7 +611,7 @@ uint32_t log_page_delete(uint8_t page)
     {
         //found page, delete it
         err_code = fds_record_delete(&record_desc);
-        runGC = true;
+        event_post(EVENT_FDS_GC);
         return err_code;
     }
 
@@ -461,9 +633,37 @@ uint32_t log_data_delete(void)
 void run_garbage_collection(void)
 {
     ret_code_t err_code;
-    runGC = false;
     is_on_GC = true;
+    diag_on(DIAG_SUBSYS_FDS_GC);
 
     err_code = fds_gc();
+    if(err_code != NRF_SUCCESS)
+    {
+        diag_off(DIAG_SUBSYS_FDS_GC);
+    }
+
+}
+
 
-}
\ No newline at end of file
+/* @brief Function for saving the log state before the power goes off */
+bool log_shutdown_flush(void)
+{
+    static bool is_flush_started = false;
+
+    if(!fds_is_init)
+    {
+        return true;
+    }
+
+    //Every finished packet is already in flash, samples of an unfinished packet have no timestamp and are dropped
+    if(!is_flush_started)
+    {
+        is_flush_started = true;
+        settings_register.timestamp = epoch_get_monotonic();
+        settings_register.clockDrift = epoch_drift_get();
+        (void)settings_reg_flash_write();
+    }
+
+    //Queued FDS writes and garbage collection finish before the power goes off
+    return !nrf_fstorage_is_busy(NULL);
+}
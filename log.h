@@ -14,6 +14,7 @@ extern "C" {
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <string.h>
 #include "nrf_gpio.h"
 #include "nrf_log.h"
@@ -27,17 +28,18 @@ extern "C" {
 #define LOG_MAX_BYTES             (LOG_MAX_PAGES * LOG_BYTES_PER_PAGE)//(84672)   //Max bytes of data possilbe in Log (MAX_PAGES * 4032 Bytes per page)
 #define LOG_PACKET_SIZE           (LOG_SAVE_PERIOD + 4) //size of save period plus 4 bytes for timestamp
 #define LOG_PACKETS_PER_PAGE      (LOG_BYTES_PER_PAGE / LOG_PACKET_SIZE) //224 packets per page
+#define LOG_PAGE_INVALID          (0xFF)    //No log page cached
 
 //FDS definitions
 #define LOG_FILE_BASE_ID      0x1112
 #define LOG_REC_BASE_KEY      0x0001
 #define SETTINGS_FILE_ID      0x1111
 #define SETTINGS_FILE_KEY     0x2222
+#define SETTINGS_LAYOUT_MAGIC 0x53570001    //"SW" and the layout version, change it with settingsStruct
 
 static bool isLogFull = false;
-extern bool runGC;
 static bool is_on_GC = false;
-extern uint32_t last_log_time;
+extern uint64_t last_log_time;
 
 
 /** Settings register struct **/
@@ -52,8 +54,18 @@ typedef struct
     uint32_t angleLogHead;
     uint32_t angleLogTail;
     uint32_t timestamp;
+    int32_t clockDrift;                       //LFCLK drift estimate in ppb
+    uint8_t filterMedian;                     //Angle filter median window, see filter_config_t
+    uint8_t filterIirShift;                   //Angle filter IIR weight 1/2^n
+    uint8_t filterDecimation;                 //Angle filter output every n samples
+    int16_t gravityRef[3];                    //Raw X, Y, Z in the neutral posture, 0 if not calibrated
+    uint8_t hapticSlot;                       //Alert waveform slot, HAPTIC_SLOT_NONE plays the motor pulses
+    uint32_t layoutMagic;                     //SETTINGS_LAYOUT_MAGIC, last so an older layout never matches
 } settingsStruct;
 
+//Fields up to here are in every saved layout, older records keep them
+#define SETTINGS_LEGACY_SIZE  (offsetof(settingsStruct, clockDrift))
+
 /* Current Time in EPOCH Format */
 union timeStampUnion
 {
@@ -82,9 +94,31 @@ uint32_t get_log_size(void);
 /* @brief Function for resetting log full status */
 void log_full_flush(void);
 
+/* @brief Function for getting the next committed packet that has not been notified
+*
+* @param[out] packet - LOG_PACKET_SIZE buffer for the packet
+* @return true if a packet was copied
+*/
+bool log_send_next(uint8_t * packet);
+
+/* @brief Function for moving the send cursor past a packet that was queued for notification */
+void log_send_commit(void);
+
+/* @brief Function for advancing the durable tail by the acknowledged packets
+*
+* @param[in] count - Number of log packets the peer has received
+*/
+void log_send_ack(uint16_t count);
+
+/* @brief Function for resending every packet that has not been acknowledged */
+void log_send_rewind(void);
+
 /* @brief Function to init the settings register */
 static void settings_reg_init(void);
 
+/* Sets the fields added after the first layout to their defaults */
+static void settings_reg_new_fields_init(void);
+
 /* @brief Function to init the Log Buffer */
 static void log_buffer_init(void);
 
@@ -103,6 +137,12 @@ uint32_t log_data_delete(void);
 /* @brief Function to start a garbage collection process */
 void run_garbage_collection(void);
 
+/* @brief Function for saving the log state before the power goes off
+*
+* @return true once the settings register is saved and flash is idle, call again until then
+*/
+bool log_shutdown_flush(void);
+
 /* @brief Function for handling FDS events */
 static void log_fds_evt_handler(fds_evt_t const * p_evt);
 
@@ -78,6 +78,9 @@
 #include "ble_dfu.h"
 #include "nrf_ble_gatt.h"
 #include "nrf_ble_qwr.h"
+#include "nrf_ble_gq.h"
+#include "ble_db_discovery.h"
+#include "ble_cts_c.h"
 #include "fds.h"
 #include "nrf_pwr_mgmt.h"
 #include "nrf_drv_clock.h"
@@ -86,14 +89,26 @@
 #include "nrf_log_ctrl.h"
 #include "nrf_log_default_backends.h"
 #include "nrf_bootloader_info.h"
-#include "nrf_delay.h"
 #include "custom_board.h"
 #include "BLE_swivx.h"
 #include "kxtj3.h"
+#include "angle.h"
 #include "motor.h"
 #include "log.h"
 #include "capsense.h"
 #include "battery.h"
+#include "epoch.h"
+#include "filter.h"
+#include "posture.h"
+#include "haptic.h"
+#include "alert.h"
+#include "budget.h"
+#include "event.h"
+#include "ticks.h"
+#include "power.h"
+#include "diag.h"
+#include "periph.h"
+#include "trace.h"
 
 
 #define DEVICE_NAME                     "SwivX"                                     /**< Name of device. Will be included in the advertising data. */
@@ -124,35 +139,37 @@
 
 #define DEAD_BEEF                       0xDEADBEEF                                  /**< Value used as error code on stack dump, can be used to identify stack location on stack unwind. */
 
+#define CTS_GATT_QUEUE_SIZE             4                                           /**< Number of queued GATT client requests for the Current Time Service client. */
+#define QWR_MEM_BUFF_SIZE               512                                         /**< Prepared writes buffer, holds a haptic upload split in ATT_MTU 23 writes. */
+
 
 NRF_BLE_GATT_DEF(m_gatt);                                                           /**< GATT module instance. */
 NRF_BLE_QWR_DEF(m_qwr);                                                             /**< Context for the Queued Write module.*/
 BLE_ADVERTISING_DEF(m_advertising);                                                 /**< Advertising module instance. */
 BLE_SWIVX_DEF(m_swivx_cus);
+NRF_BLE_GQ_DEF(m_ble_gatt_queue,                                                    /**< BLE GATT Queue instance. */
+               NRF_SDH_BLE_PERIPHERAL_LINK_COUNT,
+               CTS_GATT_QUEUE_SIZE);
+BLE_CTS_C_DEF(m_cts_c);                                                             /**< Current Time Service client instance. */
+BLE_DB_DISCOVERY_DEF(m_ble_db_discovery);                                           /**< Database discovery module instance. */
 
 static uint16_t m_conn_handle = BLE_CONN_HANDLE_INVALID;                            /**< Handle of the current connection. */
+static uint8_t m_qwr_mem[QWR_MEM_BUFF_SIZE];                                        /**< Memory for the Queued Write module. */
 static void advertising_start(bool erase_bonds);                                    /**< Forward declaration of advertising start function */
 
-static uint8_t app_mode = 0;
-static uint32_t button_time = 0;  
-static bool button_is_pressed = false;                                                      /**< 0 - low power mode, 1 - active mode **/
+static uint8_t app_mode = APP_MODE_ACTIVE;                                          /**< 0 - low power mode, 1 - active mode **/
 static uint8_t current_app_state = 0xFF;
-static uint32_t current_time;
-static uint32_t last_bat_time = 0;
+static uint64_t current_time;
+static uint8_t last_bat_lvl = 0xFF;
 static uint8_t last_angle = 0;
-static uint32_t last_motor_en = 0;
+static bool is_angle_pending = false;                                               /**< Angle notification not queued yet, the queue was full **/
+static uint8_t still_angle = 0;
+static uint64_t last_motion_time = 0;
+static uint64_t last_event_log_time = 0;
+static bool is_calibrating = false;
 static bool is_advertising = false;
 static bool is_motor_en = false;
 
-//Log transfer variables
-static bool start_log_send_en = false;
-static bool log_is_sending = false;
-static bool needs_new_page = false;
-static uint32_t num_log_packets = 0;
-static uint16_t current_log_packet = 0;
-static uint32_t current_log_page_byte = 0;
-static uint8_t log_sendBuffer[LOG_BYTES_PER_PAGE];
-
 
 // YOUR_JOB: Use UUIDs for service(s) used in your application.
 static ble_uuid_t m_adv_uuids[] = {{SWIVX_SERVICE_UUID,BLE_UUID_TYPE_VENDOR_BEGIN}};
@@ -169,6 +186,16 @@ static ble_uuid_t m_adv_uuids[] = {{SWIVX_SERVICE_UUID,BLE_UUID_TYPE_VENDOR_BEGI
  */
 static bool app_shutdown_handler(nrf_pwr_mgmt_evt_t event)
 {
+    //Motor off and the log in flash before any shutdown, retried every second until done
+    if(!is_motor_stopped())
+    {
+        motor_state_handler(MOTOR_STOP);
+    }
+    if(!log_shutdown_flush())
+    {
+        return false;
+    }
+
     switch (event)
     {
         case NRF_PWR_MGMT_EVT_PREPARE_DFU:
@@ -197,10 +224,7 @@ static bool app_shutdown_handler(nrf_pwr_mgmt_evt_t event)
             break;
 
         default:
-            // YOUR_JOB: Implement any of the other events available from the power management module:
-            //      -NRF_PWR_MGMT_EVT_PREPARE_SYSOFF
-            //      -NRF_PWR_MGMT_EVT_PREPARE_WAKEUP
-            //      -NRF_PWR_MGMT_EVT_PREPARE_RESET
+            //System OFF wake sources are armed by the power state manager
             return true;
     }
 
@@ -312,6 +336,76 @@ static void ble_dfu_evt_handler(ble_dfu_buttonless_evt_type_t event)
     }
 }
 
+/**@brief Function for applying angle filter settings to the filter pipeline.
+ *
+ * @details Settings that are out of range are not applied, the settings register is set back
+ *          to the running configuration instead.
+ *
+ * @param[in]   median       Sliding median window.
+ * @param[in]   iir_shift    IIR low-pass weight 1/2^n.
+ * @param[in]   decimation   Output every n samples.
+ *
+ * @return      true if the settings were applied.
+ */
+static bool angle_filter_set(uint8_t median, uint8_t iir_shift, uint8_t decimation)
+{
+    filter_config_t config;
+    bool is_applied;
+
+    config.median_len = median;
+    config.iir_shift = iir_shift;
+    config.decimation = decimation;
+
+    is_applied = (filter_config_set(&config) == NRF_SUCCESS);
+    if(!is_applied)
+    {
+        NRF_LOG_INFO("Invalid filter settings %d %d %d", median, iir_shift, decimation);
+    }
+
+    filter_config_get(&config);
+    settings_register.filterMedian = config.median_len;
+    settings_register.filterIirShift = config.iir_shift;
+    settings_register.filterDecimation = config.decimation;
+
+    return is_applied;
+}
+
+/**@brief Function for applying a haptic upload from the SwivX Haptic characteristic.
+ *
+ * @details The characteristic is set back to the alert waveform selection afterwards, a rejected
+ *          upload is not kept in the GATT database.
+ */
+static void haptic_char_apply(void)
+{
+    ret_code_t err_code;
+    uint8_t data[SWIVX_HAPTIC_CHAR_LEN];
+    uint16_t len = sizeof(data);
+
+    err_code = ble_swivx_haptic_value_get(&m_swivx_cus, data, &len);
+    APP_ERROR_CHECK(err_code);
+
+    err_code = haptic_upload(data, len);
+    if(err_code == NRF_ERROR_INVALID_PARAM || err_code == NRF_ERROR_INVALID_LENGTH)
+    {
+        NRF_LOG_INFO("Invalid haptic upload, %d bytes", len);
+    }
+    else
+    {
+        APP_ERROR_CHECK(err_code);
+    }
+
+    err_code = ble_swivx_haptic_update(&m_swivx_cus);
+    APP_ERROR_CHECK(err_code);
+}
+
+/**@brief Function for changing the app mode, the mode entry runs from the event queue. **/
+static void app_mode_set(uint8_t mode)
+{
+    app_mode = mode;
+    event_post(EVENT_MODE);
+    power_motion_set(mode == APP_MODE_ACTIVE);
+}
+
 /**@brief Function for handling the SwivX Service events.
  *
  * @details This function will be called for all SwivX Service events which are passed to
@@ -330,10 +424,16 @@ static void on_swivx_evt(ble_swivx_t     * p_cus_service,
     {
         case BLE_SWIVX_EVT_CONNECTED:
             is_ble_connected = true;
+            power_connection_set(true);
+            err_code = ble_swivx_diag_update(&m_swivx_cus);
+            APP_ERROR_CHECK(err_code);
             break;
 
         case BLE_SWIVX_EVT_DISCONNECTED:
               is_ble_connected = false;
+              power_connection_set(false);
+              //Unacknowledged packets are sent again on the next connection
+              log_send_rewind();
               break;
         
         case BLE_SWIVX_EVT_DATA_NOTIFICATION_ENABLED:
@@ -346,16 +446,48 @@ static void on_swivx_evt(ble_swivx_t     * p_cus_service,
         
         case BLE_SWIVX_EVT_LOG_NOTIFICATION_ENABLED:
               is_ble_log_notifications_en = true;
+              event_post(EVENT_LOG_SEND);
               break;
 
         case BLE_SWIVX_EVT_LOG_NOTIFICATION_DISABLED:
               is_ble_log_notifications_en = false;
+              log_send_rewind();
+              break;
+
+        case BLE_SWIVX_EVT_LOG_TX_COMPLETE:
+              //Peer has the packets, release them from the log
+              log_send_ack(*(uint16_t*)p_context);
+              event_post(EVENT_LOG_SEND);
               break;
         
+        case BLE_SWIVX_EVT_FILTER_WRITTEN:
+              if(angle_filter_set(((uint8_t*)p_context)[0], ((uint8_t*)p_context)[1], ((uint8_t*)p_context)[2]))
+              {
+                  err_code = settings_reg_flash_write();
+                  APP_ERROR_CHECK(err_code);
+              }
+              //Publish the running configuration, reverts a rejected write
+              err_code = ble_swivx_filter_update(&m_swivx_cus);
+              APP_ERROR_CHECK(err_code);
+              break;
+
+        case BLE_SWIVX_EVT_HAPTIC_WRITTEN:
+              haptic_char_apply();
+              break;
+
         case BLE_SWIVX_EVT_MODE_WRITTEN:
               if(*(uint8_t*)p_context == APP_MODE_REQ_LOG)
               {
-                  start_log_send_en = true;
+                  //Resend everything from the durable tail
+                  log_send_rewind();
+                  event_post(EVENT_LOG_SEND);
+              }
+              else if(*(uint8_t*)p_context == APP_MODE_CALIBRATE)
+              {
+                  //Capture the neutral posture from the next samples, sampling needs active mode
+                  posture_calibration_start();
+                  is_calibrating = true;
+                  app_mode_set(APP_MODE_ACTIVE);
               }
               break;
 
@@ -402,8 +534,107 @@ void assert_nrf_callback(uint16_t line_num, const uint8_t * p_file_name)
  */
 static void pm_evt_handler(pm_evt_t const * p_evt)
 {
+    ret_code_t err_code;
+
     pm_handler_on_pm_evt(p_evt);
     pm_handler_flash_clean(p_evt);
+
+    switch (p_evt->evt_id)
+    {
+        case PM_EVT_CONN_SEC_SUCCEEDED:
+            // Phones only expose the Current Time Service on an encrypted link.
+            err_code = ble_db_discovery_start(&m_ble_db_discovery, p_evt->conn_handle);
+            if (err_code != NRF_ERROR_BUSY)
+            {
+                APP_ERROR_CHECK(err_code);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+/**@brief Function for handling the Current Time Service client errors.
+ *
+ * @param[in]   nrf_error   Error code containing information about what went wrong.
+ */
+static void current_time_error_handler(uint32_t nrf_error)
+{
+    APP_ERROR_HANDLER(nrf_error);
+}
+
+
+/**@brief Function for handling Database Discovery events.
+ *
+ * @details Passes the discovery result on to the Current Time Service client.
+ *
+ * @param[in] p_evt  Pointer to the database discovery event.
+ */
+static void db_disc_handler(ble_db_discovery_evt_t * p_evt)
+{
+    ble_cts_c_on_db_disc_evt(&m_cts_c, p_evt);
+}
+
+
+/**@brief Function for handling the Current Time Service client events.
+ *
+ * @details Syncs the EPOCH time base to the time read from the phone.
+ *
+ * @param[in]   p_cts   Current Time Service client structure.
+ * @param[in]   p_evt   Event received from the Current Time Service client.
+ */
+static void on_cts_c_evt(ble_cts_c_t * p_cts, ble_cts_c_evt_t * p_evt)
+{
+    ret_code_t err_code;
+
+    switch (p_evt->evt_type)
+    {
+        case BLE_CTS_C_EVT_DISCOVERY_COMPLETE:
+            NRF_LOG_INFO("Current Time Service discovered on server.");
+            err_code = ble_cts_c_handles_assign(&m_cts_c,
+                                                p_evt->conn_handle,
+                                                &p_evt->params.char_handles);
+            APP_ERROR_CHECK(err_code);
+
+            err_code = ble_cts_c_current_time_read(&m_cts_c);
+            if (err_code != NRF_ERROR_NOT_FOUND)
+            {
+                APP_ERROR_CHECK(err_code);
+            }
+            break;
+
+        case BLE_CTS_C_EVT_DISCOVERY_FAILED:
+            NRF_LOG_INFO("Current Time Service not found on server.");
+            break;
+
+        case BLE_CTS_C_EVT_DISCONN_COMPLETE:
+            break;
+
+        case BLE_CTS_C_EVT_CURRENT_TIME:
+        {
+            exact_time_256_t const * p_time = &p_evt->params.current_time.exact_time_256;
+            uint32_t time = epoch_from_date(p_time->day_date_time.date_time.year,
+                                            p_time->day_date_time.date_time.month,
+                                            p_time->day_date_time.date_time.day,
+                                            p_time->day_date_time.date_time.hours,
+                                            p_time->day_date_time.date_time.minutes,
+                                            p_time->day_date_time.date_time.seconds);
+
+            epoch_sync(time, p_time->fractions256, EPOCH_SOURCE_CTS);
+            err_code = ble_swivx_settings_update(&m_swivx_cus);
+            APP_ERROR_CHECK(err_code);
+            break;
+        }
+
+        case BLE_CTS_C_EVT_INVALID_TIME:
+            NRF_LOG_INFO("Invalid time received from the Current Time Service.");
+            break;
+
+        default:
+            break;
+    }
 }
 
 
@@ -454,6 +685,48 @@ static void nrf_qwr_error_handler(uint32_t nrf_error)
 }
 
 
+/**@brief Function for handling Queued Write Module events.
+ *
+ * @details Long haptic uploads are checked before the prepared writes are executed, a
+ *          rejected upload leaves the characteristic unchanged.
+ *
+ * @param[in]   p_qwr   Queued Write module instance.
+ * @param[in]   p_evt   Event received from the Queued Write module.
+ *
+ * @return      GATT status of the request.
+ */
+static uint16_t nrf_qwr_evt_handler(nrf_ble_qwr_t * p_qwr, nrf_ble_qwr_evt_t * p_evt)
+{
+    uint8_t data[SWIVX_HAPTIC_CHAR_LEN];
+    uint16_t len = sizeof(data);
+
+    if(p_evt->attr_handle != m_swivx_cus.swivx_haptic_handles.value_handle)
+    {
+        return BLE_GATT_STATUS_SUCCESS;
+    }
+
+    switch(p_evt->evt_type)
+    {
+        case NRF_BLE_QWR_EVT_AUTH_REQUEST:
+            if(nrf_ble_qwr_value_get(p_qwr, p_evt->attr_handle, data, &len) != NRF_SUCCESS
+               || !haptic_upload_check(data, len))
+            {
+                return BLE_GATT_STATUS_ATTERR_INVALID_ATT_VAL_LENGTH;
+            }
+            break;
+
+        case NRF_BLE_QWR_EVT_EXECUTE_WRITE:
+            haptic_char_apply();
+            break;
+
+        default:
+            break;
+    }
+
+    return BLE_GATT_STATUS_SUCCESS;
+}
+
+
 
 /**@brief Function for initializing services that will be used by the application.
  */
@@ -463,9 +736,14 @@ static void services_init(void)
     nrf_ble_qwr_init_t        qwr_init  = {0};
     ble_dfu_buttonless_init_t dfus_init = {0};
     ble_swivx_init_t          swivx_init;
+    ble_db_discovery_init_t   db_init   = {0};
+    ble_cts_c_init_t          cts_init  = {0};
 
     // Initialize Queued Write Module.
-    qwr_init.error_handler = nrf_qwr_error_handler;
+    qwr_init.mem_buffer.len   = QWR_MEM_BUFF_SIZE;
+    qwr_init.mem_buffer.p_mem = m_qwr_mem;
+    qwr_init.error_handler    = nrf_qwr_error_handler;
+    qwr_init.callback         = nrf_qwr_evt_handler;
 
     err_code = nrf_ble_qwr_init(&m_qwr, &qwr_init);
     APP_ERROR_CHECK(err_code);
@@ -489,8 +767,34 @@ static void services_init(void)
     BLE_GAP_CONN_SEC_MODE_SET_OPEN(&swivx_init.swivx_data_char_attr_md.write_perm);
     BLE_GAP_CONN_SEC_MODE_SET_OPEN(&swivx_init.swivx_bat_char_attr_md.read_perm);
     BLE_GAP_CONN_SEC_MODE_SET_NO_ACCESS(&swivx_init.swivx_bat_char_attr_md.write_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&swivx_init.swivx_filter_char_attr_md.read_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&swivx_init.swivx_filter_char_attr_md.write_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&swivx_init.swivx_haptic_char_attr_md.read_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&swivx_init.swivx_haptic_char_attr_md.write_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&swivx_init.swivx_budget_char_attr_md.read_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_NO_ACCESS(&swivx_init.swivx_budget_char_attr_md.write_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&swivx_init.swivx_diag_char_attr_md.read_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_NO_ACCESS(&swivx_init.swivx_diag_char_attr_md.write_perm);
     err_code = ble_swivx_init(&m_swivx_cus, &swivx_init);
     //APP_ERROR_CHECK(err_code);
+
+    //Haptic uploads are longer than one ATT write
+    err_code = nrf_ble_qwr_attr_register(&m_qwr, m_swivx_cus.swivx_haptic_handles.value_handle);
+    APP_ERROR_CHECK(err_code);
+
+    // Initialize the Database Discovery module and the Current Time Service client.
+    db_init.evt_handler  = db_disc_handler;
+    db_init.p_gatt_queue = &m_ble_gatt_queue;
+
+    err_code = ble_db_discovery_init(&db_init);
+    APP_ERROR_CHECK(err_code);
+
+    cts_init.evt_handler   = on_cts_c_evt;
+    cts_init.error_handler = current_time_error_handler;
+    cts_init.p_gatt_queue  = &m_ble_gatt_queue;
+
+    err_code = ble_cts_c_init(&m_cts_c, &cts_init);
+    APP_ERROR_CHECK(err_code);
 }
 
 
@@ -885,15 +1189,29 @@ static void power_management_init(void)
 
 uint8_t get_battery_level(void)
 {
-    //uninit capsense
-    //capsense_uninit();
-    battery_level_init();
+    uint32_t err_code;
+
+    //Level of the last burst, sampled by the battery monitor without the CPU
     uint8_t current_bat_lvl = battery_level_update();
-    uint32_t err_code = ble_swivx_bat_value_update(&m_swivx_cus, current_bat_lvl);
+
+    //Notified only when it changes
+    if(current_bat_lvl != last_bat_lvl)
+    {
+        last_bat_lvl = current_bat_lvl;
+        err_code = ble_swivx_bat_value_update(&m_swivx_cus, current_bat_lvl);
+        APP_ERROR_CHECK(err_code);
+    }
+
+    //Motor intensity and budget follow the battery band
+    if(budget_battery_set(current_bat_lvl))
+    {
+        get_sequence_values();
+        haptic_refresh();
+    }
+    err_code = ble_swivx_budget_update(&m_swivx_cus);
     APP_ERROR_CHECK(err_code);
-    battery_level_uninit();
-    //init capsense
-    //capsense_init();
+
+    power_battery_set(current_bat_lvl);
 
     return current_bat_lvl;
 }
@@ -904,9 +1222,56 @@ uint8_t get_battery_level(void)
  */
 static void idle_state_handle(void)
 {
+    //Binary trace records go out raw, no formatting on the device
+    trace_flush();
+
     if (NRF_LOG_PROCESS() == false)
     {
+        //Wake-ups include every interrupt, the event queue runs after each one
+        diag_on(DIAG_SUBSYS_SLEEP);
         nrf_pwr_mgmt_run();
+        diag_off(DIAG_SUBSYS_SLEEP);
+        diag_count(DIAG_COUNTER_WAKEUP, 1);
+    }
+}
+
+/** @brief Function for capturing the neutral posture reference from raw samples */
+static void posture_calibration_process(int16_t const * p_xyz)
+{
+    ret_code_t err_code;
+    int16_t gravity_ref[3];
+
+    switch(posture_calibration_add(p_xyz))
+    {
+        case POSTURE_CAL_DONE:
+            is_calibrating = false;
+            posture_calibration_get(gravity_ref);
+
+            if(posture_init(gravity_ref))
+            {
+                memcpy(settings_register.gravityRef, gravity_ref, sizeof(gravity_ref));
+                err_code = settings_reg_flash_write();
+                APP_ERROR_CHECK(err_code);
+                NRF_LOG_INFO("Posture calibrated %d %d %d", gravity_ref[0], gravity_ref[1], gravity_ref[2]);
+                motor_indicate(MOTOR_ALERT_SHORT);
+            }
+            else
+            {
+                //Not a plausible gravity vector, keep the previous reference
+                posture_init(settings_register.gravityRef);
+                NRF_LOG_INFO("Posture calibration failed");
+            }
+
+            //Angle output jumps to the new reference
+            filter_reset();
+            break;
+
+        case POSTURE_CAL_MOVED:
+            NRF_LOG_INFO("Posture calibration restarted, hold still");
+            break;
+
+        default:
+            break;
     }
 }
 
@@ -916,10 +1281,11 @@ static void app_loop_lp(void)
     //Run first time the mode switches, sets timers and puts things to sleep
     if(current_app_state != app_mode)
     {
-        //Set accelerometer to low power mode
-        kxtj3_power_mode(POWER_STNDBY_MODE);
-        //set to low power app loop timer interval
-        apploop_timer_start_mode(APPLOOP_TIMER_LP);
+        //No app loop timer, only the accelerometer wake-up interrupt wakes the CPU
+        apploop_timer_start_mode(APPLOOP_TIMER_OFF);
+        //Stop angle sampling and wait for motion
+        uint32_t err_code = kxtj3_motion_wake_enable();
+        APP_ERROR_CHECK(err_code);
         current_app_state = app_mode;
         NRF_LOG_INFO("App mode Low Power");
         motor_state_handler(MOTOR_STOP);
@@ -931,266 +1297,411 @@ static void app_loop_lp(void)
         //uint32_t err_code = ble_advertising_start(&m_advertising, BLE_ADV_MODE_SLOW);
         //APP_ERROR_CHECK(err_code);
     }
+}
+
+/** @brief Function for handling motion and Capsense events, wakes the app from low power mode */
+static void app_wake_handler(void)
+{
+    //Motion off the body, e.g. carried in a bag, does not start sampling
+    if(app_mode == APP_MODE_LP && capsense_is_worn())
+    {
+        app_mode_set(APP_MODE_ACTIVE);
+    }
+    else
+    {
+        //Still waiting for motion, release the latched INT for the next one
+        uint32_t err_code = kxtj3_motion_wake_ack();
+        APP_ERROR_CHECK(err_code);
+    }
+}
+
+/** @brief Function for playing the motor action of the alert policy */
+static void alert_motor_process(alert_action_t action)
+{
+    ret_code_t err_code;
+
+    //Keep the battery reserve for BLE and logging, stop is always allowed
+    if(action != ALERT_ACTION_NONE && action != ALERT_ACTION_STOP)
+    {
+        if(!budget_alert_allow())
+        {
+            NRF_LOG_INFO("Alert throttled, battery %d%%", budget_battery_get());
+            err_code = ble_swivx_budget_update(&m_swivx_cus);
+            APP_ERROR_CHECK(err_code);
+            return;
+        }
+
+        //Low battery, a single play instead of the repeated alert
+        if(action == ALERT_ACTION_REPEATED && budget_band_get() != BUDGET_BAND_FULL)
+        {
+            action = ALERT_ACTION_STRONG;
+        }
+    }
 
-    //If Capsense threshold achieved, change mode to active
-    if(touch_activated)
+    switch(action)
     {
-        app_mode = 1; //active mode
+        case ALERT_ACTION_GENTLE:
+            motor_indicate(MOTOR_ALERT_GENTLE);
+            break;
+
+        case ALERT_ACTION_STRONG:
+            motor_indicate(MOTOR_ALERT_FEEDBACK);
+            break;
+
+        case ALERT_ACTION_REPEATED:
+            motor_state_handler(MOTOR_START);
+            break;
+
+        case ALERT_ACTION_STOP:
+            if(is_motor_on || !is_motor_stopped())
+            {
+                motor_state_handler(MOTOR_STOP);
+            }
+            break;
+
+        default:
+            break;
     }
 }
 
 /** @brief Function for the Application process in active mode */
 static void app_loop_active(void)
 {
-    bool log_saved;
-
     //Run first time the mode switches, sets timers and wakes things up
     if(current_app_state != app_mode)
     {
        //Set accelerometer to low power mode
        kxtj3_power_mode(POWER_RUN_MODE);
-       motor_init();
        //set to low power capsense timer interval
        apploop_timer_start_mode(APPLOOP_TIMER_ACTIVE);
        current_app_state = app_mode;
+       last_motion_time = ticks_ms_get();
+       //Sampling was stopped, do not filter across the gap
+       filter_reset();
+       alert_reset();
        NRF_LOG_INFO("App mode Active");
     }
+}
+
+/** @brief Function for sending the pending angle notification, kept pending while the queue is full */
+static void app_angle_send(void)
+{
+    uint32_t err_code;
+
+    if(!is_angle_pending)
+    {
+        return;
+    }
+
+    if(!(is_ble_connected && is_ble_data_notifications_en))
+    {
+        is_angle_pending = false;
+        return;
+    }
+
+    //Log sync fills the queue, sent again on the next TX complete or angle instead of waiting here
+    err_code = ble_swivx_data_update(&m_swivx_cus, last_angle);
+    if(err_code != NRF_ERROR_RESOURCES)
+    {
+        is_angle_pending = false;
+    }
+}
+
+/** @brief Function for processing a batch of angle readings, sampled by RTC/PPI/TWIM while the CPU sleeps */
+static void app_accl_batch_handler(void)
+{
+    bool log_saved;
+
+    //Batch finished just before sampling was stopped
+    if(app_mode != APP_MODE_ACTIVE || current_app_state != APP_MODE_ACTIVE)
+    {
+        return;
+    }
+    diag_cpu_begin(DIAG_SUBSYS_SAMPLING);
 
     //get current time
-    current_time = millis();
+    current_time = ticks_ms_get();
+
+    //No motion for the stillness timeout, go to low power unless the app is streaming angles
+    if((current_time - last_motion_time) > STILLNESS_TIMEOUT)
+    {
+        if(!(is_ble_connected && is_ble_data_notifications_en) && !is_motor_on)
+        {
+            app_mode_set(APP_MODE_LP);
+            diag_cpu_end(DIAG_SUBSYS_SAMPLING);
+            return;
+        }
+        last_motion_time = current_time;
+    }
 
     //Check if the touch is still pressed
     /*
     if(!touch_activated && is_touch_active)
     {
         //If capsense has not been active for 4 seconds, change mode to low power
-        if(compare_millis(last_touch_time, current_time) > NOTOUCH_TIMEOUT && !log_is_sending)
+        if((current_time - last_touch_time) > NOTOUCH_TIMEOUT)
         {
             app_mode = 0;
         }
     }
     */
 
-    //If battery level timeout occurs, read and update battery level
-    if(compare_millis(last_bat_time, current_time) > BATTERY_LEVEL_TIMEOUT)
+    if((current_time - last_event_log_time) > EVENT_STATS_LOG_TIMEOUT)
     {
-        last_bat_time = millis();
+        diag_snapshot_t snapshot;
 
-        //stop capsense timer
-        apploop_timer_start_mode(APPLOOP_TIMER_OFF);
-       
-        //Get battery measurement
-        //uint8_t current_bat_lvl = get_battery_level();
-        uint8_t current_bat_lvl = 20;
-        //start Capsense timer
-        apploop_timer_start_mode(APPLOOP_TIMER_ACTIVE);
-
-        if(current_bat_lvl <= 10)
-        {
-            uint32_t err_code = swivx_led_indication(LED_INDICATE_LOW_BATTERY);
-            APP_ERROR_CHECK(err_code);
-        }
+        last_event_log_time = current_time;
+        event_stats_log();
+        periph_stats_log();
+
+        //Refresh the diagnostics snapshot for a connected phone
+        diag_snapshot_get(&snapshot);
+        NRF_LOG_INFO("Average current %d uA over %d s", snapshot.avg_current_ua, snapshot.uptime_s);
+        NRF_LOG_INFO("Angle samples gated by the motor: %d", snapshot.counters[DIAG_COUNTER_SAMPLE_GATED]);
+        uint32_t err_code = ble_swivx_diag_update(&m_swivx_cus);
+        APP_ERROR_CHECK(err_code);
     }
  
-    //Take angle reading every 10ms
-    if(take_angle_reading)
-    {
-        float angle_raw = 0;
-        uint8_t angle_filt = 0;
-        take_angle_reading = false;
-        
-          angle_raw = kxtj3_get_angle();
-          angle_filt = kxtj3_filter_angle(angle_raw);
-
-          if(angle_filt != 200)
+    bool is_angle_new = false;
+    int16_t angle_q = 0;
+    uint8_t angle_filt;
+    int16_t sample[3];
+
+      //Run every sample through the filter pipeline, keep the latest output of the batch
+      for(uint8_t i = 0; i < KXTJ3_BATCH_SIZE; i++)
+      {
+          kxtj3_get_sample(i, sample);
+
+          //Samples shaken by the motor, or still settling after it, are gated
+          bool is_gated = motor_is_artefact(kxtj3_sample_time_get(i));
+          if(is_gated)
           {
-            printf("current angle: %d\r\n", angle_filt);
-
-            if(is_ble_connected && is_ble_data_notifications_en)
-            {
-                //send angle data notification if the angle changed
-                if(last_angle != angle_filt)
-                {
-                    uint32_t err_code;
-                    do
-                    {
-                        //send notification
-                        err_code = ble_swivx_data_update(&m_swivx_cus, angle_filt);
-                        if(err_code != NRF_ERROR_RESOURCES)
-                        {
-                            //APP_ERROR_CHECK(err_code);
-                        }
-
-                    } while(err_code == NRF_ERROR_RESOURCES);
-
-                    last_angle = angle_filt;
-                }
-            }
-          
-
-            if(compare_millis(last_log_time, current_time) > LOG_SAMPLE_TIMEOUT && !log_is_sending)
-            {
-                //Log the angle data
-                log_saved = log_write((uint8_t)angle_filt);
-                last_log_time = millis();
-
-                if(log_saved)
-                {   
-                    //update settings GATT Database
-                    uint32_t err_code = ble_swivx_settings_update(&m_swivx_cus);
-                    APP_ERROR_CHECK(err_code);
-                }
-            }
+              diag_count(DIAG_COUNTER_SAMPLE_GATED, 1);
+          }
 
-          //Check if angle is within min/max
-          if(angle_filt < settings_register.angleMin)
+          if(is_calibrating && !is_gated)
           {
-              if(!is_motor_on && compare_millis(last_motor_en, current_time) > MOTOR_HYST_DELAY)
-              {
-                  //check if vibration is enabled
-                  if(settings_register.motorIntensity > 0 && is_motor_en)
-                  {
-                      //angle is out of acceptable range
-                       motor_state_handler(MOTOR_START);
-                  }
-              }
+              posture_calibration_process(sample);
           }
-          else if(is_motor_on)
+
+          //Forward tilt from the neutral posture, or the Z axis tilt if not calibrated
+          diag_cpu_begin(DIAG_SUBSYS_FILTER);
+          if(filter_process(posture_tilt(sample), is_gated, &angle_q))
           {
-              motor_state_handler(MOTOR_STOP);
-              last_motor_en = millis();
+              is_angle_new = true;
           }
-        }
-    }
-}
-
-/** @brief Funtion for sending Log packets when requested */
-static void app_log_send()
-{
-    ret_code_t err_code;
-    bool isValid;
-    uint8_t packetBuffer[18];
-
+          diag_cpu_end(DIAG_SUBSYS_FILTER);
+      }
 
-    if(is_ble_connected && is_ble_log_notifications_en && get_log_size() > 0)
-    {
-        if(start_log_send_en)
+      if(is_angle_new)
+      {
+        //Round the 1/64 degree filter output to whole degrees, leaning far back can leave 0-180
+        if(angle_q < 0)
         {
-            //prepare number of packets
-
-            //Get page of log tail
-            uint8_t log_page = settings_register.angleLogTail / LOG_BYTES_PER_PAGE;
-            //printf("log read page: %d\r\n", log_page);
-            //Get byte location in page of log tail
-            current_log_page_byte = settings_register.angleLogTail % LOG_BYTES_PER_PAGE;
-            start_log_send_en = false;
-            log_is_sending = true;
-            isValid = log_flash_read(log_page, log_sendBuffer);
-            
+            angle_q = 0;
         }
-        
-        if(current_log_page_byte >= LOG_BYTES_PER_PAGE)
+        else if(angle_q > ANGLE_DEG(180))
         {
-            //grab new page from flash
-            current_log_page_byte = 0;
-            uint8_t log_page = settings_register.angleLogTail / LOG_BYTES_PER_PAGE;
-            printf("log read page: %d\r\n", log_page);
-            isValid = log_flash_read(log_page, log_sendBuffer);
-            if(!isValid)
-            {
-                printf("bad log! \r\n");
-            }
+            angle_q = ANGLE_DEG(180);
         }
-        
-        //Fill BLE packet buffer with net data
-        for(uint8_t i = 0; i < LOG_PACKET_SIZE; i++)
+        angle_filt = (uint8_t)((angle_q + (1 << (ANGLE_Q - 1))) >> ANGLE_Q);
+        TRACE(TRACE_ANGLE, angle_filt, posture_lateral(sample) / (1 << ANGLE_Q));
+
+        //Restart the stillness timeout on a real change of the angle
+        if(angle_filt > still_angle + STILLNESS_ANGLE_DELTA || angle_filt + STILLNESS_ANGLE_DELTA < still_angle)
         {
-            packetBuffer[i] = log_sendBuffer[current_log_page_byte + i];
+            still_angle = angle_filt;
+            last_motion_time = current_time;
         }
-        
-        //Increment current byte location by size of packet
-        current_log_page_byte += 18;
-        settings_register.angleLogTail += 18;
-        
-        //Send packet
-        //printf("Sending Log Data: byte %d\r\n", current_log_page_byte);
-        do
+
+        if(is_ble_connected && is_ble_data_notifications_en)
         {
-            err_code = ble_swivx_log_packet_send(&m_swivx_cus, packetBuffer);
-            if(err_code != NRF_ERROR_RESOURCES)
-              {
-                  //APP_ERROR_CHECK(err_code);
-              }
-        
-        } while(err_code == NRF_ERROR_RESOURCES);
-        
-        if(settings_register.angleLogTail >= LOG_MAX_BYTES)
+            //send angle data notification if the angle changed
+            if(last_angle != angle_filt)
+            {
+                last_angle = angle_filt;
+                is_angle_pending = true;
+            }
+            app_angle_send();
+        }
+      
+
+        if((current_time - last_log_time) > LOG_SAMPLE_TIMEOUT)
         {
-            //Set tail back to beginning
-            settings_register.angleLogTail = 0;
+            //Log the angle data
+            diag_cpu_begin(DIAG_SUBSYS_LOG);
+            log_saved = log_write((uint8_t)angle_filt);
+            last_log_time = ticks_ms_get();
+
+            if(log_saved)
+            {   
+                //update settings GATT Database
+                uint32_t err_code = ble_swivx_settings_update(&m_swivx_cus);
+                APP_ERROR_CHECK(err_code);
+                //New packet committed
+                event_post(EVENT_LOG_SEND);
+            }
+            diag_cpu_end(DIAG_SUBSYS_LOG);
         }
-        
-        //printf("head: %d, tail: %d\r\n", settings_register.angleLogHead, settings_register.angleLogTail);
-        if(settings_register.angleLogTail == settings_register.angleLogHead)
+
+      //Escalate the alert while the angle stays below angleMin
+      if(settings_register.motorIntensity > 0 && is_motor_en)
+      {
+          alert_motor_process(alert_process(angle_filt, current_time));
+      }
+      else
+      {
+          alert_reset();
+      }
+    }
+
+    diag_cpu_end(DIAG_SUBSYS_SAMPLING);
+}
+
+/** @brief Funtion for streaming committed Log packets to a subscribed phone */
+static void app_log_send()
+{
+    ret_code_t err_code = NRF_SUCCESS;
+    uint8_t packetBuffer[LOG_PACKET_SIZE];
+    uint16_t packets = 0;
+
+    //Queue packets until the SoftDevice is full, the TX complete event frees space again
+    while(log_send_next(packetBuffer))
+    {
+        err_code = ble_swivx_log_packet_send(&m_swivx_cus, packetBuffer);
+        if(err_code != NRF_SUCCESS)
         {
-            //Packet sending is done, clear all state variables
-            start_log_send_en = false;
-            log_is_sending = false;
-            isValid = false;
-            current_log_packet = 0;
-            current_log_page_byte = 0;
-            log_full_flush();
+            break;
         }
-    } 
+        log_send_commit();
+        packets++;
+    }
+
+    TRACE(TRACE_LOG_SEND, packets, err_code);
+}
+
+/** @brief Function for handling the Log send event */
+static void app_log_send_handler(void)
+{
+    //The angle goes first into the space the TX complete freed
+    app_angle_send();
+
+    if(is_ble_connected && is_ble_log_notifications_en)
+    {
+        app_log_send();
+    }
+}
+
+/** @brief Function for handling the app mode event, runs the entry of the new mode */
+static void app_mode_handler(void)
+{
+    if(app_mode == APP_MODE_LP)
+    {
+        app_loop_lp();
+    }
+    else if(app_mode == APP_MODE_ACTIVE)
+    {
+        app_loop_active();
+    }
+}
+
+/** @brief Function for handling a short press of the power button, toggles the vibration */
+static void button_short_handler(void)
+{
+    is_motor_en = !is_motor_en;
+    if(is_motor_en)
+    {
+      NRF_LOG_INFO("vibration enabled.");
+      motor_indicate(MOTOR_POWER_ON);
+    }
     else
     {
-        //BLE not connected or notifications not enabled, do not send data
-        start_log_send_en = false;
-        log_is_sending = false;
+      NRF_LOG_INFO("vibration disabled.");
+      motor_indicate(MOTOR_BUTTON_PRESS);
+      app_mode_set(APP_MODE_ACTIVE);
     }
 }
 
-static void check_gpio_inputs(void)
-{ 
-  //Check physical button press
-  if(!nrf_gpio_pin_read(PBOUT))
-   {
-     if(!button_is_pressed)
-     {
-        button_time = millis();
-        button_is_pressed = true;
-     }
-     else
-     {
-        if(compare_millis(button_time, millis()) > POWER_OFF_TIMEOUT)
-        {
-            //Turn off device
-            NRF_LOG_INFO("Powering Down");
-            nrf_gpio_pin_clear(PSHOLD);
-        }
-     }
-   }
-   else
-   {
-      if(button_is_pressed)
-      { 
-          button_is_pressed = false;
-          is_motor_en = !is_motor_en;
-          if(is_motor_en)
-          {
-            NRF_LOG_INFO("vibration enabled.");
-            motor_indicate(MOTOR_POWER_ON);
-            nrf_delay_ms(1000);
-          }
-          else
-          {
-            NRF_LOG_INFO("vibration disabled.");
-            motor_indicate(MOTOR_BUTTON_PRESS);
-            nrf_delay_ms(1000);
-            app_mode = APP_MODE_ACTIVE;
-          }
-      }
-   } 
+/** @brief Function for handling a long press of the power button, turns off the device */
+static void button_long_handler(void)
+{
+    NRF_LOG_INFO("Powering Down");
+    power_off();
+}
+
+/** @brief Function for handling a power state change, advertising follows the state */
+static void app_power_state_handler(void)
+{
+    ret_code_t err_code;
+
+    switch(power_state_get())
+    {
+        case POWER_STATE_STANDBY:
+            //Nobody connected for a while, motion starts advertising again
+            if(is_advertising)
+            {
+                err_code = sd_ble_gap_adv_stop(m_advertising.adv_handle);
+                if(err_code != NRF_ERROR_INVALID_STATE)
+                {
+                    APP_ERROR_CHECK(err_code);
+                }
+                is_advertising = false;
+                err_code = swivx_led_indication(LED_INDICATE_IDLE);
+                APP_ERROR_CHECK(err_code);
+            }
+            break;
+
+        case POWER_STATE_ACTIVE:
+        case POWER_STATE_IDLE_ADVERTISING:
+            if(!is_advertising && !is_ble_connected)
+            {
+                advertising_start(false);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+/** @brief Function for handling a new battery burst, about once a minute */
+static void app_battery_handler(void)
+{
+    //Also updates the motor budget and the power state
+    uint8_t current_bat_lvl = get_battery_level();
+
+    if(current_bat_lvl <= 10 && app_mode == APP_MODE_ACTIVE)
+    {
+        uint32_t err_code = swivx_led_indication(LED_INDICATE_LOW_BATTERY);
+        APP_ERROR_CHECK(err_code);
+    }
+}
+
+/** @brief Function for handling a wear state change, angle sampling stops off the body */
+static void app_wear_handler(void)
+{
+    bool is_worn = capsense_is_worn();
+
+    NRF_LOG_INFO("Device %s", is_worn ? "worn" : "taken off");
+    power_wear_set(is_worn);
+
+    if(!is_worn && app_mode == APP_MODE_ACTIVE)
+    {
+        app_mode_set(APP_MODE_LP);
+    }
+    else if(is_worn && app_mode == APP_MODE_LP)
+    {
+        app_mode_set(APP_MODE_ACTIVE);
+    }
+}
+
+/** @brief Function for handling a double press of the power button, captures the neutral posture */
+static void button_double_handler(void)
+{
+    NRF_LOG_INFO("Calibrating posture.");
+    posture_calibration_start();
+    is_calibrating = true;
+    app_mode_set(APP_MODE_ACTIVE);
 }
 
 /**@brief Function for application main entry.
@@ -1201,8 +1712,29 @@ int main(void)
     ret_code_t err_code;
 
     log_init();
+    trace_init();
+    event_init();
+    periph_init();
+    event_handler_set(EVENT_MODE, app_mode_handler);
+    event_handler_set(EVENT_ACCL_BATCH, app_accl_batch_handler);
+    event_handler_set(EVENT_ACCL_MOTION, app_wake_handler);
+    event_handler_set(EVENT_TOUCH, app_wake_handler);
+    event_handler_set(EVENT_BUTTON_SHORT, button_short_handler);
+    event_handler_set(EVENT_BUTTON_LONG, button_long_handler);
+    event_handler_set(EVENT_BUTTON_DOUBLE, button_double_handler);
+    event_handler_set(EVENT_POWER_STATE, app_power_state_handler);
+    event_handler_set(EVENT_BATTERY, app_battery_handler);
+    event_handler_set(EVENT_WEAR, app_wear_handler);
+    event_handler_set(EVENT_LOG_SEND, app_log_send_handler);
+    event_handler_set(EVENT_FDS_GC, run_garbage_collection);
     custom_board_init();
     log_fds_init();
+    haptic_init();
+    epoch_init(settings_register.timestamp, settings_register.clockDrift);
+    //Settings saved by older firmware have no filter settings, defaults are used then
+    angle_filter_set(settings_register.filterMedian, settings_register.filterIirShift, settings_register.filterDecimation);
+    posture_init(settings_register.gravityRef);
+    power_init();
   
     // Initialize the async SVCI interface to bootloader before any interrupts are enabled.
     err_code = ble_dfu_buttonless_async_svci_init();
@@ -1211,6 +1743,9 @@ int main(void)
 
     power_management_init();
     ble_stack_init();
+    //Radio notification needs the SoftDevice
+    err_code = diag_init();
+    APP_ERROR_CHECK(err_code);
     peer_manager_init();
     gap_params_init();
     gatt_init();
@@ -1224,40 +1759,17 @@ int main(void)
     uint8_t current_bat_lvl = get_battery_level();
     application_timers_start();
     advertising_start(erase_bonds);
+    //Plays in the background, samples taken during it are gated
     motor_indicate(MOTOR_POWER_ON);
-    nrf_delay_ms(2000);
+    app_mode_set(APP_MODE_ACTIVE);
 
     // Enter main loop.
     
 
     for (;;)
     {
-        check_gpio_inputs();
-
-        if(app_mode == APP_MODE_LP)
-        {         
-            //app_loop_lp();
-            app_loop_active();
-        }
-        else if(app_mode == APP_MODE_ACTIVE)
-        {
-            app_loop_active();
-        }
-        
-        if(start_log_send_en || log_is_sending)
-        {
-            app_log_send();
-            if(!log_is_sending)
-            {
-                uint32_t err_code = settings_reg_flash_write();
-                printf("Done sending log");
-            }
-        }
-
-        if(runGC)
-        {
-            run_garbage_collection();
-        }
+        //Everything runs from the events posted by the interrupt handlers
+        event_execute();
 
         idle_state_handle();
     }
@@ -4,30 +4,75 @@
 
 
 #include "motor.h"
+#include "haptic.h"
+#include "budget.h"
+#include "ticks.h"
+#include "diag.h"
+#include "periph.h"
+#include "battery.h"
+#include "sdk_macros.h"
+#include "app_util_platform.h"
 
 /** Motor state timer instance **/
 APP_TIMER_DEF(m_motor_timer);
 
 /** PWM Drvier instance **/
 static nrfx_pwm_t m_pwm0 = NRFX_PWM_INSTANCE(0);
-static nrf_pwm_values_common_t seq_values2[5] = {0,0,0,0, 5000};
-static uint32_t vib_duration = 0;
+
+/* Pattern sequence pair, values must stay in RAM for EasyDMA */
+static nrf_pwm_values_common_t m_seq_on_value = MOTOR_PWM_OFF;
+static nrf_pwm_values_common_t m_seq_off_value = MOTOR_PWM_OFF;
+static nrf_pwm_sequence_t m_seq_on =
+{
+    .values.p_common = &m_seq_on_value,
+    .length = 1,
+    .repeats = 0,
+    .end_delay = 0
+};
+static nrf_pwm_sequence_t m_seq_off =
+{
+    .values.p_common = &m_seq_off_value,
+    .length = 1,
+    .repeats = 0,
+    .end_delay = 0
+};
+static motor_pattern_t m_alert_pattern;         //Alert from the settings register
+static motor_pattern_t m_short_pattern;         //Short full power confirmation buzz
+static motor_pattern_t m_gentle_pattern;        //Single soft buzz, first alert stage
+static motor_pattern_t m_power_on_pattern;      //Power on and vibration enabled
+static motor_pattern_t m_button_pattern;        //Double buzz, vibration disabled
 static bool is_motor_driver_init = false;
+static bool is_pwm_held = false;                //Reference on PWM0 while a pattern plays
 static motor_state_t motor_current_state = MOTOR_STOP;
-static motor_state_t last_motor_state = MOTOR_STOP;
 static uint8_t motor_state_counter = 0;
 bool is_motor_on = false;
-uint32_t motor_roll_delay = 0;
+
+/* Vibration window, tells the angle pipeline which samples are disturbed */
+static bool is_vibrating = false;
+static uint64_t vib_start_time = 0;
+static uint64_t vib_end_time = 0;
+static uint8_t play_duty = 0;                   //Average duty (%) of the playing pattern, for the budget
 
 
 /**@brief Function for the Motor and PWM initialization.
  *
- * @details Initializes the PWM module. Setus up Sequence for the vibration motor.
+ * @details Registers the PWM module, it is only powered while a pattern plays. Setus up Sequence
+ *          for the vibration motor.
  */
  uint32_t motor_init(void)
  {
-    ret_code_t err_code;
+    periph_register(PERIPH_PWM0, motor_pwm_power);
+
+    is_motor_driver_init = true;
+
+    get_sequence_values();
 
+    return NRF_SUCCESS;
+ }
+
+/* @brief Function for powering the PWM up and down, called by the resource manager */
+static uint32_t motor_pwm_power(bool is_on)
+{
     //Period calculation: (1/base_clock) * top_value
     nrfx_pwm_config_t const config0 = 
     {
@@ -39,21 +84,21 @@ uint32_t motor_roll_delay = 0;
             NRFX_PWM_PIN_NOT_USED
         },
         .irq_priority = APP_IRQ_PRIORITY_LOWEST,
-        .base_clock = NRF_PWM_CLK_125kHz,
+        .base_clock = NRF_PWM_CLK_1MHz,
         .count_mode = NRF_PWM_MODE_UP,
-        .top_value = 6250,                                //Period of 50ms
+        .top_value = MOTOR_PWM_TOP,                       //Period of 5ms
         .load_mode = NRF_PWM_LOAD_COMMON,
         .step_mode = NRF_PWM_STEP_AUTO
     };
 
-    err_code = nrfx_pwm_init(&m_pwm0, &config0, NULL);
-
-    is_motor_driver_init = true;
-
-    get_sequence_values();
+    if(!is_on)
+    {
+        nrfx_pwm_uninit(&m_pwm0);
+        return NRF_SUCCESS;
+    }
 
-    return err_code;
- }
+    return nrfx_pwm_init(&m_pwm0, &config0, motor_pwm_handler);
+}
 
 
 /**@brief Function for the setting the PWM sequence and motor duty cycles.
@@ -64,47 +109,39 @@ uint32_t motor_roll_delay = 0;
  {
     ret_code_t err_code;
 
+    //Indications play in the background on the PWM, nothing to play on without the driver
+    if(!is_motor_driver_init)
+    {
+        return;
+    }
+
     switch(indicate)
     {
         case MOTOR_ALERT_SHORT:
             NRF_LOG_INFO("Motor Alert Short!");
-            static nrf_pwm_values_common_t seq_values[] = {0,0,0,0, 5000};
-            nrf_pwm_sequence_t const seq = 
-            {
-                .values.p_common = seq_values,
-                .length = NRF_PWM_VALUES_LENGTH(seq_values),
-                .repeats = 0,
-                .end_delay = 0
-            };
-            nrf_gpio_pin_set(MOTOR_EN);
-            nrfx_pwm_simple_playback(&m_pwm0, &seq, 2, NRFX_PWM_FLAG_STOP);
+            err_code = motor_pattern_play(&m_short_pattern);
+            APP_ERROR_CHECK(err_code);
             break;
       
+        case MOTOR_ALERT_GENTLE:
+            NRF_LOG_INFO("Motor Alert Gentle!");
+            err_code = motor_pattern_play(&m_gentle_pattern);
+            APP_ERROR_CHECK(err_code);
+            break;
+
         case MOTOR_ALERT_FEEDBACK:
             NRF_LOG_INFO("Motor Alert Long!");
-            nrf_pwm_sequence_t const seq2 = 
-            {
-                .values.p_common = seq_values2,
-                .length = NRF_PWM_VALUES_LENGTH(seq_values2),
-                .repeats = 0,
-                .end_delay = 0
-            };
-            nrf_gpio_pin_set(MOTOR_EN);
-            nrfx_pwm_simple_playback(&m_pwm0, &seq2, 2, NRFX_PWM_FLAG_STOP);
+            err_code = motor_alert_play();
+            APP_ERROR_CHECK(err_code);
             break;
         case MOTOR_POWER_ON:
-            nrf_gpio_pin_set(MOTOR_EN);
-            nrf_delay_ms(500);
-            nrf_gpio_pin_clear(MOTOR_EN);
+            err_code = motor_pattern_play(&m_power_on_pattern);
+            APP_ERROR_CHECK(err_code);
             break;
         case MOTOR_BUTTON_PRESS:
-            nrf_gpio_pin_set(MOTOR_EN);
-            nrf_delay_ms(200);
-            nrf_gpio_pin_clear(MOTOR_EN);
-            nrf_delay_ms(200);
-            nrf_gpio_pin_set(MOTOR_EN);
-            nrf_delay_ms(200);
-            nrf_gpio_pin_clear(MOTOR_EN);
+            err_code = motor_pattern_play(&m_button_pattern);
+            APP_ERROR_CHECK(err_code);
+            break;
         default:
             break;
     }
@@ -115,52 +152,25 @@ void motor_state_handler(motor_state_t state)
     ret_code_t err_code;
     motor_current_state = state;
 
-    if(last_motor_state != state)
-    {
-        app_timer_stop(m_motor_timer);
-    }
-    last_motor_state = state;
-
     switch(state)
     {   
         case MOTOR_START:
-            //indicate feedback
-            motor_indicate(MOTOR_ALERT_FEEDBACK);
+            //Whole alert plays in hardware, the PWM handler takes over when it has finished
+            err_code = motor_alert_play();
+            APP_ERROR_CHECK(err_code);
             motor_current_state = MOTOR_RUNNING;
             motor_state_counter++;
             is_motor_on = true;
-            err_code = app_timer_start(m_motor_timer, APP_TIMER_TICKS(MOTOR_CHECK_DELAY), NULL);
-            APP_ERROR_CHECK(err_code);
-            break;
-
-        case MOTOR_RUNNING:
-            if(is_motor_stopped())
-            {
-                motor_roll_delay = millis();
-                nrf_gpio_pin_clear(MOTOR_EN);
-
-                if(motor_state_counter >= 5)
-                {
-                    motor_current_state = MOTOR_STOP;
-                }
-                else
-                {
-                    motor_current_state = MOTOR_START;
-                    err_code = app_timer_start(m_motor_timer, APP_TIMER_TICKS(MOTOR_INDICATE_DELAY), NULL);
-                    APP_ERROR_CHECK(err_code);
-                }
-            }
-            else
-            {
-                err_code = app_timer_start(m_motor_timer, APP_TIMER_TICKS(MOTOR_CHECK_DELAY), NULL);
-                APP_ERROR_CHECK(err_code);
-            }
             break;
 
         case MOTOR_STOP:
+            app_timer_stop(m_motor_timer);
             is_motor_on = false;
-            nrfx_pwm_stop(&m_pwm0, false);
-            nrf_gpio_pin_clear(MOTOR_EN);
+            if(periph_is_powered(PERIPH_PWM0))
+            {
+                nrfx_pwm_stop(&m_pwm0, false);
+            }
+            motor_en_clear();
             motor_state_counter = 0;
             break;
 
@@ -169,6 +179,203 @@ void motor_state_handler(motor_state_t state)
     }
 }
 
+/**@brief Function for compiling a pulse pattern into the PWM sequence pair and playing it.
+ *
+ * @details Sequence 0 holds the pulse intensity for the on time, sequence 1 holds off for the
+ *          off time. The pair is looped once per pulse by the PWM, no CPU until the finished event.
+ */
+uint32_t motor_pattern_play(motor_pattern_t const * p_pattern)
+{
+    ret_code_t err_code;
+
+    if(!is_motor_driver_init)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    //Sequences are read by EasyDMA while playing, stop before the values are changed.
+    //The finished event of the old pattern has been handled once stopped, take the PWM after it
+    if(periph_is_powered(PERIPH_PWM0))
+    {
+        nrfx_pwm_stop(&m_pwm0, true);
+    }
+
+    err_code = motor_pwm_acquire();
+    VERIFY_SUCCESS(err_code);
+
+    m_seq_on_value = p_pattern->level;
+    m_seq_off_value = MOTOR_PWM_OFF;
+
+    m_seq_on.repeats = (p_pattern->on_periods > 0) ? (p_pattern->on_periods - 1) : 0;
+    m_seq_off.repeats = (p_pattern->off_periods > 0) ? (p_pattern->off_periods - 1) : 0;
+
+    play_duty = (uint8_t)((((uint32_t)(MOTOR_PWM_TOP - p_pattern->level) * 100) / MOTOR_PWM_TOP)
+                          * (m_seq_on.repeats + 1) / (m_seq_on.repeats + m_seq_off.repeats + 2));
+
+    motor_en_set();
+
+    //Returns a task address, only used with NRFX_PWM_FLAG_START_VIA_TASK
+    (void)nrfx_pwm_complex_playback(&m_pwm0, &m_seq_on, &m_seq_off,
+                                    (p_pattern->pulses > 0) ? p_pattern->pulses : 1, NRFX_PWM_FLAG_STOP);
+
+    return NRF_SUCCESS;
+}
+
+/**@brief Function for playing a precompiled PWM sequence, e.g. a haptic waveform. **/
+uint32_t motor_sequence_play(nrf_pwm_sequence_t const * p_sequence, uint8_t duty)
+{
+    ret_code_t err_code;
+
+    if(!is_motor_driver_init)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    if(periph_is_powered(PERIPH_PWM0))
+    {
+        nrfx_pwm_stop(&m_pwm0, true);
+    }
+
+    err_code = motor_pwm_acquire();
+    VERIFY_SUCCESS(err_code);
+
+    play_duty = duty;
+
+    motor_en_set();
+
+    (void)nrfx_pwm_simple_playback(&m_pwm0, p_sequence, 1, NRFX_PWM_FLAG_STOP);
+
+    return NRF_SUCCESS;
+}
+
+/* @brief Function to play the alert, the selected haptic waveform or the settings register pulses */
+static uint32_t motor_alert_play(void)
+{
+    nrf_pwm_sequence_t const * p_sequence = haptic_sequence_get(settings_register.hapticSlot);
+
+    if(p_sequence != NULL)
+    {
+        return motor_sequence_play(p_sequence, haptic_duty_get(settings_register.hapticSlot));
+    }
+
+    return motor_pattern_play(&m_alert_pattern);
+}
+
+/* @brief Function to build a pulse pattern from an intensity in percent and times in ms */
+static void motor_pattern_compile(motor_pattern_t * p_pattern, uint8_t intensity, uint8_t pulses,
+                                  uint16_t on_ms, uint16_t off_ms)
+{
+    if(intensity > 100)
+    {
+        intensity = 100;
+    }
+
+    //PWM off value is MOTOR_PWM_TOP, full on is 0
+    p_pattern->level = MOTOR_PWM_TOP - (uint16_t)(((uint32_t)MOTOR_PWM_TOP * intensity) / 100);
+    p_pattern->pulses = (pulses > 0) ? pulses : 1;
+    p_pattern->on_periods = (on_ms >= MOTOR_PWM_PERIOD_MS) ? (on_ms / MOTOR_PWM_PERIOD_MS) : 1;
+    p_pattern->off_periods = (off_ms >= MOTOR_PWM_PERIOD_MS) ? (off_ms / MOTOR_PWM_PERIOD_MS) : 1;
+}
+
+/* @brief Function for handling the PWM events, called once a whole pattern has played */
+static void motor_pwm_handler(nrfx_pwm_evt_type_t event_type)
+{
+    ret_code_t err_code;
+
+    if(event_type != NRFX_PWM_EVT_FINISHED)
+    {
+        return;
+    }
+
+    motor_en_clear();
+
+    //Repeat the alert after a pause until it has played MOTOR_ALERT_REPEATS times
+    if(motor_current_state == MOTOR_RUNNING && motor_state_counter < MOTOR_ALERT_REPEATS)
+    {
+        motor_current_state = MOTOR_START;
+        err_code = app_timer_start(m_motor_timer, APP_TIMER_TICKS(MOTOR_INDICATE_DELAY), NULL);
+        APP_ERROR_CHECK(err_code);
+    }
+}
+
+/** @brief Function to check if a sample is disturbed by the motor vibration **/
+bool motor_is_artefact(uint64_t sample_time)
+{
+    uint64_t start_time;
+    uint64_t end_time;
+    bool vibrating;
+
+    //Written by the motor interrupts, 64bit is not read atomically
+    CRITICAL_REGION_ENTER();
+    start_time = vib_start_time;
+    end_time = vib_end_time;
+    vibrating = is_vibrating;
+    CRITICAL_REGION_EXIT();
+
+    //Taken before the last vibration started
+    if(sample_time < start_time)
+    {
+        return false;
+    }
+
+    if(vibrating)
+    {
+        return true;
+    }
+
+    //Taken during the vibration or within the settling time after it
+    return (sample_time < end_time + MOTOR_ROLL_TIMEOUT);
+}
+
+/* @brief Function to switch the motor driver on and start a vibration window */
+static void motor_en_set(void)
+{
+    nrf_gpio_pin_set(MOTOR_EN);
+    if(!is_vibrating)
+    {
+        vib_start_time = ticks_ms_get();
+        is_vibrating = true;
+        diag_on(DIAG_SUBSYS_MOTOR);
+        //No battery samples under the motor current
+        battery_load_set(true);
+    }
+}
+
+/* @brief Function to switch the motor driver off and close the vibration window */
+static void motor_en_clear(void)
+{
+    nrf_gpio_pin_clear(MOTOR_EN);
+    if(is_vibrating)
+    {
+        vib_end_time = ticks_ms_get();
+        is_vibrating = false;
+        diag_off(DIAG_SUBSYS_MOTOR);
+        battery_load_set(false);
+        budget_motor_charge(((uint32_t)(vib_end_time - vib_start_time) * play_duty) / 100);
+    }
+
+    //Pattern is over, PWM0 is powered down from the main loop
+    if(is_pwm_held)
+    {
+        is_pwm_held = false;
+        periph_release(PERIPH_PWM0);
+    }
+}
+
+/* @brief Function to take PWM0 for a pattern, held until the motor is switched off */
+static uint32_t motor_pwm_acquire(void)
+{
+    ret_code_t err_code = NRF_SUCCESS;
+
+    if(!is_pwm_held)
+    {
+        err_code = periph_acquire(PERIPH_PWM0);
+        is_pwm_held = (err_code == NRF_SUCCESS);
+    }
+
+    return err_code;
+}
+
 /* @brief Function for the motor timer handling */
 static void motor_timer_handler(void *p_context)
 {
@@ -181,9 +388,10 @@ static void motor_timer_handler(void *p_context)
  */
  void motor_uninit(void)
  {
-    nrfx_pwm_uninit(&m_pwm0);
+    //Stopping releases PWM0
+    motor_state_handler(MOTOR_STOP);
     is_motor_driver_init = false;
-    is_motor_on - false;
+    is_motor_on = false;
  }
 
 /** @brief Function to return the motor driver status **/
@@ -198,7 +406,7 @@ bool is_motor_init(void)
  */
  bool is_motor_stopped(void)
  {
-    if(is_motor_driver_init)
+    if(periph_is_powered(PERIPH_PWM0))
     {
         return nrfx_pwm_is_stopped(&m_pwm0);
     }
@@ -211,25 +419,24 @@ bool is_motor_init(void)
  /** @brief Function to dynamically create PWM sequence values based on the settings register */
 void get_sequence_values(void)
 {
-    //PWM off value max is 5000, full on is 0. Calculate based on settings register vibration intensity percent
-
     //Check if intensity is above 100
     if(settings_register.motorIntensity > 100)
     {
         settings_register.motorIntensity = 100;
     }
-   
 
-    float intensity_percent = (settings_register.motorIntensity / 100.0);
-    uint16_t vib_intensity = (5000 - (5000 * intensity_percent));
-    for(uint8_t i=2; i<4; i+=1)
-    {
-        seq_values2[i] = vib_intensity;
-    }
+    //motorDuration is split in motor_pulses pulses, each half on and half off
+    uint8_t pulses = (settings_register.motor_pulses > 0) ? settings_register.motor_pulses : 1;
+    uint16_t pulse_ms = (settings_register.motorDuration / pulses) / 2;
+
+    //Alerts are softer on a low battery, confirmations stay at full power
+    uint8_t intensity = budget_intensity_scale(settings_register.motorIntensity);
 
-    //Calculate vibration pulse duration based on number of pulses and total motor duration from settings register
-    //((Duration / num pulses) / 5ms period) / 2
-    vib_duration = ((settings_register.motorDuration / settings_register.motor_pulses) / 5) / 2;
+    motor_pattern_compile(&m_alert_pattern, intensity, pulses, pulse_ms, pulse_ms);
+    motor_pattern_compile(&m_short_pattern, 100, 1, MOTOR_SHORT_ON_MS, MOTOR_PWM_PERIOD_MS);
+    motor_pattern_compile(&m_gentle_pattern, intensity / 2, 1, MOTOR_GENTLE_ON_MS, MOTOR_PWM_PERIOD_MS);
+    motor_pattern_compile(&m_power_on_pattern, 100, 1, MOTOR_POWER_ON_MS, MOTOR_PWM_PERIOD_MS);
+    motor_pattern_compile(&m_button_pattern, 100, 2, MOTOR_BUTTON_PRESS_MS, MOTOR_BUTTON_PRESS_MS);
 }
 
 /** create motor Timer **/
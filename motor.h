@@ -20,10 +20,18 @@ extern "C" {
 #include "nrfx_pwm.h"
 #include "log.h"
 
-#define MOTOR_CHECK_DELAY       100
 #define MOTOR_INDICATE_DELAY    2000
-#define MOTOR_ROLL_TIMEOUT      1000
-#define MOTOR_HYST_DELAY        2000
+#define MOTOR_ROLL_TIMEOUT      300         //Settling time after a vibration, angle samples are gated
+#define MOTOR_ALERT_REPEATS     5           //Alert plays up to 5 times, MOTOR_INDICATE_DELAY apart
+#define MOTOR_SHORT_ON_MS       200
+#define MOTOR_GENTLE_ON_MS      300         //First alert stage, half the alert intensity
+#define MOTOR_POWER_ON_MS       500
+#define MOTOR_BUTTON_PRESS_MS   200         //On and off time of the double buzz
+
+//PWM at 1MHz, 5ms period. Motor driver is full on at 0 and off at MOTOR_PWM_TOP
+#define MOTOR_PWM_TOP           5000
+#define MOTOR_PWM_OFF           MOTOR_PWM_TOP
+#define MOTOR_PWM_PERIOD_MS     5
 
 /** Motor status states **/
 typedef enum
@@ -37,13 +45,22 @@ typedef enum
 typedef enum
 {
    MOTOR_ALERT_SHORT,
+   MOTOR_ALERT_GENTLE,
    MOTOR_ALERT_FEEDBACK,
    MOTOR_POWER_ON,
    MOTOR_BUTTON_PRESS,
 } motor_indicate_t;
 
+/** Pulse pattern, compiled to PWM periods for the sequence pair **/
+typedef struct
+{
+    uint16_t level;             //PWM compare value of the pulses, MOTOR_PWM_OFF - intensity
+    uint8_t pulses;             //Number of on/off pulses
+    uint32_t on_periods;        //PWM periods on per pulse
+    uint32_t off_periods;       //PWM periods off per pulse
+} motor_pattern_t;
+
 extern bool is_motor_on;
-extern uint32_t motor_roll_delay;
 
 /**@brief Function for the Motor and PWM initialization.
  *
@@ -70,6 +87,27 @@ bool is_motor_init(void);
 
  void motor_state_handler(motor_state_t state);
 
+/**@brief Function for playing a pulse pattern.
+ *
+ * @details The whole pattern plays out in hardware, any playing pattern is stopped first.
+ *
+ * @param[in]   p_pattern   Compiled pattern.
+ *
+ * @return   NRF_SUCCESS on success, otherwise an error code.
+ */
+uint32_t motor_pattern_play(motor_pattern_t const * p_pattern);
+
+/**@brief Function for playing a precompiled PWM sequence, e.g. a haptic waveform.
+ *
+ * @details The sequence plays once in hardware and must stay in RAM while playing.
+ *
+ * @param[in]   p_sequence   Sequence at the motor PWM period, common load mode.
+ * @param[in]   duty         Average duty of the sequence in percent, charged to the budget.
+ *
+ * @return   NRF_SUCCESS on success, otherwise an error code.
+ */
+uint32_t motor_sequence_play(nrf_pwm_sequence_t const * p_sequence, uint8_t duty);
+
 /**@brieef Function to check status of PWM.
  *
  * @details returns true if the PWM is stopped, false if it is running.
@@ -78,6 +116,34 @@ bool is_motor_init(void);
 
  static void motor_timer_handler(void *p_context);
 
+/** @brief Function to check if a sample is disturbed by the motor vibration
+ *
+ * @param[in]   sample_time   ticks_ms_get() time the sample was taken.
+ *
+ * @return   true if the sample was taken while vibrating or within MOTOR_ROLL_TIMEOUT after.
+ */
+bool motor_is_artefact(uint64_t sample_time);
+
+/* Build a pulse pattern from an intensity in percent and times in ms */
+static void motor_pattern_compile(motor_pattern_t * p_pattern, uint8_t intensity, uint8_t pulses,
+                                  uint16_t on_ms, uint16_t off_ms);
+
+/* Play the alert, the selected haptic waveform or the settings register pulses */
+static uint32_t motor_alert_play(void);
+
+/* PWM event handler, a pattern has finished */
+static void motor_pwm_handler(nrfx_pwm_evt_type_t event_type);
+
+/* Switch the motor driver and track the vibration window */
+static void motor_en_set(void);
+static void motor_en_clear(void);
+
+/* Power PWM0 up or down for the resource manager */
+static uint32_t motor_pwm_power(bool is_on);
+
+/* Take PWM0 for a pattern */
+static uint32_t motor_pwm_acquire(void);
+
 /** @brief Function to set the sequency values for the vibration intensity from settings registers **/
 void get_sequence_values(void);
 
@@ -0,0 +1,159 @@
+/* File: periph.c */
+
+/** C file for the SwivX peripheral resource manager **/
+
+
+#include "periph.h"
+#include <string.h>
+#include "nrf_error.h"
+#include "nrf_log.h"
+#include "app_util_platform.h"
+#include "event.h"
+#include "ticks.h"
+
+static periph_power_handler_t m_handlers[PERIPH_COUNT];
+static uint8_t m_refs[PERIPH_COUNT];
+static bool m_is_powered[PERIPH_COUNT];
+static uint64_t m_on_since[PERIPH_COUNT];       //ticks_get() of the last power up
+static uint64_t m_on_ticks[PERIPH_COUNT];       //Powered time of the finished intervals
+static uint32_t m_power_ups[PERIPH_COUNT];
+
+
+/**@brief Function for initializing the resource manager. **/
+void periph_init(void)
+{
+    memset(m_handlers, 0, sizeof(m_handlers));
+    memset(m_refs, 0, sizeof(m_refs));
+    memset(m_is_powered, 0, sizeof(m_is_powered));
+    memset(m_on_ticks, 0, sizeof(m_on_ticks));
+    memset(m_power_ups, 0, sizeof(m_power_ups));
+
+    event_handler_set(EVENT_PERIPH_RELEASE, periph_release_handler);
+}
+
+
+/**@brief Function for registering the power handler of a peripheral. **/
+void periph_register(periph_t periph, periph_power_handler_t handler)
+{
+    if(periph < PERIPH_COUNT)
+    {
+        m_handlers[periph] = handler;
+    }
+}
+
+
+/**@brief Function for taking a reference on a peripheral. **/
+uint32_t periph_acquire(periph_t periph)
+{
+    uint32_t err_code = NRF_SUCCESS;
+
+    if(periph >= PERIPH_COUNT || m_handlers[periph] == NULL)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    //A release handler in the main loop may be powering the same peripheral down
+    CRITICAL_REGION_ENTER();
+    if(!m_is_powered[periph])
+    {
+        err_code = m_handlers[periph](true);
+        if(err_code == NRF_SUCCESS)
+        {
+            m_is_powered[periph] = true;
+            m_on_since[periph] = ticks_get();
+            m_power_ups[periph]++;
+        }
+    }
+
+    if(err_code == NRF_SUCCESS)
+    {
+        m_refs[periph]++;
+    }
+    CRITICAL_REGION_EXIT();
+
+    return err_code;
+}
+
+
+/**@brief Function for dropping a reference on a peripheral. **/
+void periph_release(periph_t periph)
+{
+    bool is_last = false;
+
+    if(periph >= PERIPH_COUNT)
+    {
+        return;
+    }
+
+    CRITICAL_REGION_ENTER();
+    if(m_refs[periph] > 0)
+    {
+        m_refs[periph]--;
+        is_last = (m_refs[periph] == 0);
+    }
+    CRITICAL_REGION_EXIT();
+
+    if(is_last)
+    {
+        event_post(EVENT_PERIPH_RELEASE);
+    }
+}
+
+
+/**@brief Function for checking if the hardware of a peripheral is powered. **/
+bool periph_is_powered(periph_t periph)
+{
+    return (periph < PERIPH_COUNT) && m_is_powered[periph];
+}
+
+
+/**@brief Function for getting the time a peripheral has been powered since reset in ms. **/
+uint32_t periph_powered_ms_get(periph_t periph)
+{
+    uint64_t ticks;
+
+    if(periph >= PERIPH_COUNT)
+    {
+        return 0;
+    }
+
+    //Running interval counts up to now
+    CRITICAL_REGION_ENTER();
+    ticks = m_on_ticks[periph] + (m_is_powered[periph] ? (ticks_get() - m_on_since[periph]) : 0);
+    CRITICAL_REGION_EXIT();
+
+    return (uint32_t)TICKS_TO_MS(ticks);
+}
+
+
+/**@brief Function for logging the powered time of every peripheral. **/
+void periph_stats_log(void)
+{
+    uint8_t periph;
+
+    for(periph = 0; periph < PERIPH_COUNT; periph++)
+    {
+        NRF_LOG_INFO("Peripheral %d: powered %d ms, %d power ups, %d refs", periph,
+                     periph_powered_ms_get(periph), m_power_ups[periph], m_refs[periph]);
+    }
+}
+
+
+/* Event handler, powers down peripherals without references */
+static void periph_release_handler(void)
+{
+    uint8_t periph;
+
+    for(periph = 0; periph < PERIPH_COUNT; periph++)
+    {
+        //Checked again with interrupts off, an interrupt may have taken a new reference
+        CRITICAL_REGION_ENTER();
+        if(m_is_powered[periph] && m_refs[periph] == 0)
+        {
+            (void)m_handlers[periph](false);
+            m_is_powered[periph] = false;
+            m_on_ticks[periph] += ticks_get() - m_on_since[periph];
+        }
+        CRITICAL_REGION_EXIT();
+    }
+}
@@ -0,0 +1,79 @@
+/* Header file periph.h */
+
+/** Header file for the SwivX peripheral resource manager **/
+
+
+
+#ifndef PERIPH_H
+#define PERIPH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/** Managed peripherals, powered only while a driver holds a reference **/
+typedef enum
+{
+    PERIPH_TWI,                 //TWIM of the KXTJ3
+    PERIPH_SAADC,               //Battery voltage
+    PERIPH_PWM0,                //Vibration motor
+    PERIPH_CAPSENSE,            //Capacitive sensor
+    PERIPH_COUNT
+} periph_t;
+
+/**@brief Power handler of a peripheral, registered by its driver.
+ *
+ * @details Called with interrupts disabled, must not wait for events.
+ *
+ * @param[in]   is_on   true to power the hardware up, false to power it down.
+ *
+ * @return   NRF_SUCCESS on success, otherwise an error code. Only checked on power up.
+ */
+typedef uint32_t (*periph_power_handler_t)(bool is_on);
+
+
+/**@brief Function for initializing the resource manager, the event queue must be initialized. **/
+void periph_init(void);
+
+/**@brief Function for registering the power handler of a peripheral, the hardware is left off. **/
+void periph_register(periph_t periph, periph_power_handler_t handler);
+
+/**@brief Function for taking a reference on a peripheral.
+ *
+ * @details The first reference powers the hardware up. Interrupt safe.
+ *
+ * @param[in]   periph   Peripheral.
+ *
+ * @return   NRF_SUCCESS if the peripheral is powered, NRF_ERROR_INVALID_STATE if it has no
+ *           handler, otherwise the error code of the power handler.
+ */
+uint32_t periph_acquire(periph_t periph);
+
+/**@brief Function for dropping a reference on a peripheral.
+ *
+ * @details The hardware is powered down from the event queue once the last reference is gone, a
+ *          release from an interrupt handler is safe and a quick release and acquire pair does
+ *          not cycle the hardware.
+ *
+ * @param[in]   periph   Peripheral.
+ */
+void periph_release(periph_t periph);
+
+/**@brief Function for checking if the hardware of a peripheral is powered. **/
+bool periph_is_powered(periph_t periph);
+
+/**@brief Function for getting the time a peripheral has been powered since reset in ms. **/
+uint32_t periph_powered_ms_get(periph_t periph);
+
+/**@brief Function for logging the powered time of every peripheral. **/
+void periph_stats_log(void);
+
+/* Static Functions */
+
+/* Event handler, powers down peripherals without references */
+static void periph_release_handler(void);
+
+#endif
@@ -0,0 +1,183 @@
+/* File: posture.c */
+
+/** C file for the SwivX posture reference (gravity vector calibration) **/
+
+
+#include "posture.h"
+#include <string.h>
+#include "angle.h"
+
+static bool is_calibrated = false;
+static int32_t basis_r[3];                    //Gravity direction in the neutral posture, Q14
+static int32_t basis_f[3];                    //Forward, horizontal in the neutral posture, Q14
+static int32_t basis_l[3];                    //Lateral, r x f, Q14
+
+/* Calibration capture */
+static int32_t cal_sum[3];
+static int16_t cal_min[3];
+static int16_t cal_max[3];
+static uint8_t cal_count = 0;
+
+
+/**@brief Function for setting the neutral posture reference. **/
+bool posture_init(int16_t const * p_gravity_ref)
+{
+    int32_t magnitude;
+
+    is_calibrated = false;
+
+    for(uint8_t i = 0; i < 3; i++)
+    {
+        basis_r[i] = p_gravity_ref[i];
+    }
+
+    //x^2 + y^2 + z^2 of int16 values is below 2^32
+    magnitude = (int32_t)angle_isqrt((uint32_t)(basis_r[0] * basis_r[0]) +
+                                     (uint32_t)(basis_r[1] * basis_r[1]) +
+                                     (uint32_t)(basis_r[2] * basis_r[2]));
+    if(magnitude < POSTURE_GRAVITY_MIN || magnitude > POSTURE_GRAVITY_MAX)
+    {
+        return false;
+    }
+    vector_normalize(basis_r, 1);
+
+    //Forward is the device Y axis with its vertical part removed, f = Y - (Y.r) r
+    basis_f[0] = -((basis_r[1] * basis_r[0]) >> POSTURE_Q);
+    basis_f[1] = (1 << POSTURE_Q) - ((basis_r[1] * basis_r[1]) >> POSTURE_Q);
+    basis_f[2] = -((basis_r[1] * basis_r[2]) >> POSTURE_Q);
+    if(!vector_normalize(basis_f, POSTURE_MIN_HORIZONTAL))
+    {
+        //Y is close to vertical in this posture, use the X axis instead
+        basis_f[0] = (1 << POSTURE_Q) - ((basis_r[0] * basis_r[0]) >> POSTURE_Q);
+        basis_f[1] = -((basis_r[0] * basis_r[1]) >> POSTURE_Q);
+        basis_f[2] = -((basis_r[0] * basis_r[2]) >> POSTURE_Q);
+        vector_normalize(basis_f, 1);
+    }
+
+    //Lateral completes the right handed basis
+    basis_l[0] = (basis_r[1] * basis_f[2] - basis_r[2] * basis_f[1]) >> POSTURE_Q;
+    basis_l[1] = (basis_r[2] * basis_f[0] - basis_r[0] * basis_f[2]) >> POSTURE_Q;
+    basis_l[2] = (basis_r[0] * basis_f[1] - basis_r[1] * basis_f[0]) >> POSTURE_Q;
+
+    is_calibrated = true;
+
+    return true;
+}
+
+
+/**@brief Function for calculating the forward tilt of a raw accelerometer sample. **/
+int16_t posture_tilt(int16_t const * p_xyz)
+{
+    if(!is_calibrated)
+    {
+        return angle_tilt(p_xyz[0], p_xyz[1], p_xyz[2]);
+    }
+
+    //Tilt in the plane of r and f, leaning forward moves gravity towards -f in the device frame
+    return ANGLE_DEG(POSTURE_NEUTRAL_ANGLE) - angle_atan2(-vector_dot(p_xyz, basis_f), vector_dot(p_xyz, basis_r));
+}
+
+
+/**@brief Function for calculating the lateral tilt of a raw accelerometer sample. **/
+int16_t posture_lateral(int16_t const * p_xyz)
+{
+    if(!is_calibrated)
+    {
+        return 0;
+    }
+
+    //l points left in the neutral posture, leaning right lifts it
+    return angle_atan2(vector_dot(p_xyz, basis_l), vector_dot(p_xyz, basis_r));
+}
+
+
+/**@brief Function to return true if a posture reference is in use. **/
+bool posture_is_calibrated(void)
+{
+    return is_calibrated;
+}
+
+
+/**@brief Function for starting a capture of the neutral posture gravity vector. **/
+void posture_calibration_start(void)
+{
+    memset(cal_sum, 0, sizeof(cal_sum));
+    cal_count = 0;
+}
+
+
+/**@brief Function for adding a raw sample to the calibration capture. **/
+posture_cal_result_t posture_calibration_add(int16_t const * p_xyz)
+{
+    for(uint8_t i = 0; i < 3; i++)
+    {
+        if(cal_count == 0 || p_xyz[i] < cal_min[i])
+        {
+            cal_min[i] = p_xyz[i];
+        }
+        if(cal_count == 0 || p_xyz[i] > cal_max[i])
+        {
+            cal_max[i] = p_xyz[i];
+        }
+        cal_sum[i] += p_xyz[i];
+    }
+    cal_count++;
+
+    //The reference has to be taken while holding still
+    for(uint8_t i = 0; i < 3; i++)
+    {
+        if((int32_t)cal_max[i] - cal_min[i] > POSTURE_CAL_MAX_SPREAD)
+        {
+            posture_calibration_start();
+            return POSTURE_CAL_MOVED;
+        }
+    }
+
+    return (cal_count >= POSTURE_CAL_SAMPLES) ? POSTURE_CAL_DONE : POSTURE_CAL_BUSY;
+}
+
+
+/**@brief Function for getting the averaged gravity vector of a finished capture. **/
+void posture_calibration_get(int16_t * p_gravity_ref)
+{
+    for(uint8_t i = 0; i < 3; i++)
+    {
+        p_gravity_ref[i] = (cal_count > 0) ? (int16_t)(cal_sum[i] / cal_count) : 0;
+    }
+}
+
+
+/* Scales a vector to unit length in Q14, returns false if it is too short */
+static bool vector_normalize(int32_t * p_vector, int32_t min_magnitude)
+{
+    uint32_t sum = 0;
+    int32_t magnitude;
+
+    for(uint8_t i = 0; i < 3; i++)
+    {
+        sum += (uint32_t)(p_vector[i] * p_vector[i]);
+    }
+    magnitude = (int32_t)angle_isqrt(sum);
+
+    if(magnitude < min_magnitude)
+    {
+        return false;
+    }
+
+    for(uint8_t i = 0; i < 3; i++)
+    {
+        p_vector[i] = (p_vector[i] << POSTURE_Q) / magnitude;
+    }
+
+    return true;
+}
+
+
+/* Dot product of a raw sample and a Q14 basis vector, in raw counts */
+static int32_t vector_dot(int16_t const * p_xyz, int32_t const * p_basis)
+{
+    //|xyz| < 2^15 and |basis| <= 2^14, the sum of three products fits int32
+    return ((int32_t)p_xyz[0] * p_basis[0] +
+            (int32_t)p_xyz[1] * p_basis[1] +
+            (int32_t)p_xyz[2] * p_basis[2]) >> POSTURE_Q;
+}
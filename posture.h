@@ -0,0 +1,97 @@
+/* Header file posture.h */
+
+/** Header file for the SwivX posture reference (gravity vector calibration) **/
+
+
+
+#ifndef POSTURE_H
+#define POSTURE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//Raw accelerometer counts per g, KXTJ3 RANGE_4G left justified output
+#define POSTURE_1G                  8192
+//Accepted gravity reference magnitude, rejects an unset or corrupted reference
+#define POSTURE_GRAVITY_MIN         (POSTURE_1G / 2)
+#define POSTURE_GRAVITY_MAX         (POSTURE_1G * 2)
+
+//Reference basis vectors in Q14, 1.0 = 16384
+#define POSTURE_Q                   14
+
+//Shortest horizontal part of the forward axis (Q14), ~15 degrees from vertical
+#define POSTURE_MIN_HORIZONTAL      (1 << (POSTURE_Q - 2))
+
+//Angle reported in the neutral posture, forward tilt lowers it
+#define POSTURE_NEUTRAL_ANGLE       90
+
+//Calibration capture
+#define POSTURE_CAL_SAMPLES         50                  //1 second at 50Hz ODR
+#define POSTURE_CAL_MAX_SPREAD      (POSTURE_1G / 10)   //Max per axis movement while capturing
+
+/** Result of adding a sample to the calibration capture **/
+typedef enum
+{
+    POSTURE_CAL_BUSY,           //More samples needed
+    POSTURE_CAL_DONE,           //Reference captured, see posture_calibration_get
+    POSTURE_CAL_MOVED           //Device moved while capturing, capture restarted
+} posture_cal_result_t;
+
+
+/**@brief Function for setting the neutral posture reference.
+ *
+ * @details Precomputes the reference basis: r along gravity in the neutral posture, f forward
+ *          (the device Y axis, or X if Y is close to vertical, projected onto the horizontal
+ *          plane) and l lateral = r x f. Without a valid reference the tilt of the Z axis
+ *          is used, as before calibration existed.
+ *
+ * @param[in]   p_gravity_ref   Averaged raw X, Y, Z in the neutral posture, all 0 if not calibrated.
+ *
+ * @return   true if the reference is valid and in use.
+ */
+bool posture_init(int16_t const * p_gravity_ref);
+
+/**@brief Function for calculating the forward tilt of a raw accelerometer sample.
+ *
+ * @details Hot path, three dot products and one atan2.
+ *
+ * @param[in]   p_xyz   Raw signed X, Y, Z.
+ *
+ * @return   POSTURE_NEUTRAL_ANGLE minus the forward tilt from the reference in 1/64 degree.
+ *           The Z axis tilt if not calibrated.
+ */
+int16_t posture_tilt(int16_t const * p_xyz);
+
+/**@brief Function for calculating the lateral (sideways) tilt of a raw accelerometer sample.
+ *
+ * @param[in]   p_xyz   Raw signed X, Y, Z.
+ *
+ * @return   Lateral tilt from the reference in 1/64 degree, positive to the right. 0 if not calibrated.
+ */
+int16_t posture_lateral(int16_t const * p_xyz);
+
+/**@brief Function to return true if a posture reference is in use. **/
+bool posture_is_calibrated(void);
+
+/**@brief Function for starting a capture of the neutral posture gravity vector. **/
+void posture_calibration_start(void);
+
+/**@brief Function for adding a raw sample to the calibration capture. **/
+posture_cal_result_t posture_calibration_add(int16_t const * p_xyz);
+
+/**@brief Function for getting the averaged gravity vector of a finished capture. **/
+void posture_calibration_get(int16_t * p_gravity_ref);
+
+/* Static Functions */
+
+/* Scales a vector to unit length in Q14, returns false if it is too short */
+static bool vector_normalize(int32_t * p_vector, int32_t min_magnitude);
+
+/* Dot product of a raw sample and a Q14 basis vector, in raw counts */
+static int32_t vector_dot(int16_t const * p_xyz, int32_t const * p_basis);
+
+#endif
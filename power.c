@@ -0,0 +1,234 @@
+/* File: power.c */
+
+/** C file for the SwivX power state manager **/
+
+
+#include "power.h"
+#include "custom_board.h"
+#include "nrf_gpio.h"
+#include "nrf_log.h"
+#include "app_timer.h"
+#include "kxtj3.h"
+#include "button.h"
+#include "event.h"
+#include "ticks.h"
+#include "led.h"
+
+APP_TIMER_DEF(m_power_idle_timer);    //Idle timeout check, app_timer can not time more than 512 s
+
+//Idle timeouts are checked at this interval
+#define POWER_IDLE_CHECK_TIMEOUT    60000
+
+static power_state_t power_state = POWER_STATE_ACTIVE;
+static uint64_t state_start_time = 0;
+static bool is_moving = true;
+static bool is_worn = true;                 //Until the capsense knows otherwise
+static bool is_connected = false;
+static bool is_off_requested = false;
+static uint8_t battery_level = 100;
+static uint8_t wake_sources = POWER_WAKE_DEFAULT;
+
+//Runs after the app shutdown handler in main.c, the log is flushed by then
+NRF_PWR_MGMT_HANDLER_REGISTER(power_shutdown_handler, 1);
+
+
+/**@brief Function for initializing the power state manager. **/
+void power_init(void)
+{
+    ret_code_t err_code;
+
+    //STAT is configured in gpio_init(), before the battery samples it
+    err_code = app_timer_create(&m_power_idle_timer, APP_TIMER_MODE_REPEATED, power_idle_timer_handler);
+    APP_ERROR_CHECK(err_code);
+
+    event_handler_set(EVENT_POWER_UPDATE, power_state_update);
+
+    power_state = POWER_STATE_ACTIVE;
+    state_start_time = ticks_ms_get();
+}
+
+
+/**@brief Function for setting if the device is moving. **/
+void power_motion_set(bool moving)
+{
+    is_moving = moving;
+    event_post(EVENT_POWER_UPDATE);
+}
+
+
+/**@brief Function for setting if the device is worn. **/
+void power_wear_set(bool worn)
+{
+    is_worn = worn;
+    event_post(EVENT_POWER_UPDATE);
+}
+
+
+/**@brief Function for setting if a phone is connected. **/
+void power_connection_set(bool connected)
+{
+    is_connected = connected;
+    event_post(EVENT_POWER_UPDATE);
+}
+
+
+/**@brief Function for setting the last battery level in percent. **/
+void power_battery_set(uint8_t level)
+{
+    battery_level = level;
+    event_post(EVENT_POWER_UPDATE);
+}
+
+
+/**@brief Function for requesting System OFF. **/
+void power_off(void)
+{
+    is_off_requested = true;
+    event_post(EVENT_POWER_UPDATE);
+}
+
+
+/**@brief Function for setting the System OFF wake sources. **/
+void power_wake_sources_set(uint8_t wake_mask)
+{
+    wake_sources = wake_mask | POWER_WAKE_BUTTON;
+}
+
+
+/**@brief Function for getting the current power state. **/
+power_state_t power_state_get(void)
+{
+    return power_state;
+}
+
+
+/**@brief Function to return true while the charger is connected. **/
+bool power_is_charging(void)
+{
+    return (nrf_gpio_pin_read(STAT) == POWER_CHARGING_LEVEL);
+}
+
+
+/* Picks the state from the inputs and applies a change */
+static void power_state_update(void)
+{
+    ret_code_t err_code;
+    power_state_t state;
+    uint32_t state_time = ticks_ms_since(state_start_time);
+
+    if(power_state == POWER_STATE_OFF)
+    {
+        return;
+    }
+
+    if(is_off_requested || (battery_level < POWER_BATTERY_OFF && !power_is_charging()))
+    {
+        state = POWER_STATE_OFF;
+    }
+    else if(is_moving && is_worn)
+    {
+        state = POWER_STATE_ACTIVE;
+    }
+    else if(is_connected)
+    {
+        state = POWER_STATE_IDLE_CONNECTED;
+    }
+    else if(power_state == POWER_STATE_STANDBY)
+    {
+        state = (state_time >= POWER_STANDBY_TIMEOUT) ? POWER_STATE_OFF : POWER_STATE_STANDBY;
+    }
+    else if(power_state == POWER_STATE_IDLE_ADVERTISING && state_time >= POWER_ADV_TIMEOUT)
+    {
+        state = POWER_STATE_STANDBY;
+    }
+    else
+    {
+        state = POWER_STATE_IDLE_ADVERTISING;
+    }
+
+    if(state == power_state)
+    {
+        return;
+    }
+
+    NRF_LOG_INFO("Power state %d -> %d", power_state, state);
+    power_state = state;
+    state_start_time = ticks_ms_get();
+
+    //Only the states without a connection time out
+    err_code = app_timer_stop(m_power_idle_timer);
+    APP_ERROR_CHECK(err_code);
+    if(state == POWER_STATE_IDLE_ADVERTISING || state == POWER_STATE_STANDBY)
+    {
+        err_code = app_timer_start(m_power_idle_timer, APP_TIMER_TICKS(POWER_IDLE_CHECK_TIMEOUT), NULL);
+        APP_ERROR_CHECK(err_code);
+    }
+
+    event_post(EVENT_POWER_STATE);
+
+    if(state == POWER_STATE_OFF)
+    {
+        //Shutdown handlers flush the log, then the wake sources are armed
+        nrf_pwr_mgmt_shutdown(NRF_PWR_MGMT_SHUTDOWN_GOTO_SYSOFF);
+    }
+}
+
+
+/* Idle timer handler, advances to the next idle state */
+static void power_idle_timer_handler(void * p_context)
+{
+    event_post(EVENT_POWER_UPDATE);
+}
+
+
+/* Shutdown handler, arms the wake sources before System OFF */
+static bool power_shutdown_handler(nrf_pwr_mgmt_evt_t event)
+{
+    if(event != NRF_PWR_MGMT_EVT_PREPARE_WAKEUP && event != NRF_PWR_MGMT_EVT_PREPARE_SYSOFF)
+    {
+        return true;
+    }
+
+    //A held button would wake the device again right away, retried until it is released
+    if(button_is_pressed())
+    {
+        return false;
+    }
+
+    (void)app_timer_stop(m_power_idle_timer);
+
+    //Hands the LED pins back to the GPIO, idle high is off
+    led_stop();
+
+    if(event == NRF_PWR_MGMT_EVT_PREPARE_WAKEUP && (wake_sources & POWER_WAKE_MOTION))
+    {
+        //Wake-up engine keeps running at its low ODR, its INT wakes the device
+        (void)kxtj3_motion_wake_enable();
+        nrf_gpio_cfg_sense_input(ACCL_INT, NRF_GPIO_PIN_NOPULL, NRF_GPIO_PIN_SENSE_HIGH);
+    }
+    else
+    {
+        (void)kxtj3_power_mode(POWER_STNDBY_MODE);
+    }
+
+    if(event == NRF_PWR_MGMT_EVT_PREPARE_WAKEUP)
+    {
+        nrf_gpio_cfg_sense_input(PBOUT, NRF_GPIO_PIN_NOPULL, NRF_GPIO_PIN_SENSE_LOW);
+
+        //Charging that already runs would wake the device at once
+        if((wake_sources & POWER_WAKE_CHARGER) && !power_is_charging())
+        {
+            nrf_gpio_cfg_sense_input(STAT, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
+        }
+    }
+
+    NRF_LOG_INFO("System OFF, wake sources 0x%02X", wake_sources);
+
+    if(is_off_requested)
+    {
+        //Power button off, release the power latch. On charger power the chip stays in System OFF.
+        nrf_gpio_pin_clear(PSHOLD);
+    }
+
+    return true;
+}
@@ -0,0 +1,91 @@
+/* Header file power.h */
+
+/** Header file for the SwivX power state manager **/
+
+
+
+#ifndef POWER_H
+#define POWER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "nrf_pwr_mgmt.h"
+
+//Idle timeouts, ms
+#define POWER_ADV_TIMEOUT           600000      //Still and not connected, advertising stops after this
+#define POWER_STANDBY_TIMEOUT       7200000     //Standby time before System OFF
+
+//Battery level (%) that forces System OFF unless the charger is connected
+#define POWER_BATTERY_OFF           3
+
+//Charger STAT output is open drain, low while charging
+#define POWER_CHARGING_LEVEL        0
+
+//System OFF wake sources
+#define POWER_WAKE_BUTTON           0x01        //PBOUT pressed
+#define POWER_WAKE_MOTION           0x02        //KXTJ3 wake-up engine INT
+#define POWER_WAKE_CHARGER          0x04        //Charger STAT, charging started
+#define POWER_WAKE_DEFAULT          (POWER_WAKE_BUTTON | POWER_WAKE_MOTION | POWER_WAKE_CHARGER)
+
+/** Power states, from most to least power **/
+typedef enum
+{
+    POWER_STATE_ACTIVE,             //Moving and worn, angle sampling runs
+    POWER_STATE_IDLE_CONNECTED,     //Still, phone connected
+    POWER_STATE_IDLE_ADVERTISING,   //Still, advertising for the phone
+    POWER_STATE_STANDBY,            //Still, advertising stopped, motion or the button wakes
+    POWER_STATE_OFF,                //System OFF, only the wake sources reset the device
+} power_state_t;
+
+
+/**@brief Function for initializing the power state manager.
+ *
+ * @details The state follows the motion, connection and battery inputs. Every change posts
+ *          EVENT_POWER_STATE, the app acts on power_state_get(). System OFF is entered with
+ *          nrf_pwr_mgmt_shutdown, the registered shutdown handlers flush the log first.
+ */
+void power_init(void);
+
+/**@brief Function for setting if the device is moving, i.e. the app is in active mode. **/
+void power_motion_set(bool moving);
+
+/**@brief Function for setting if the device is worn, off the body it is never active. **/
+void power_wear_set(bool worn);
+
+/**@brief Function for setting if a phone is connected. **/
+void power_connection_set(bool connected);
+
+/**@brief Function for setting the last battery level in percent. **/
+void power_battery_set(uint8_t level);
+
+/**@brief Function for requesting System OFF, e.g. from the power button. **/
+void power_off(void);
+
+/**@brief Function for setting the System OFF wake sources.
+ *
+ * @param[in]   wake_mask   POWER_WAKE_ bits, the button is always a wake source.
+ */
+void power_wake_sources_set(uint8_t wake_mask);
+
+/**@brief Function for getting the current power state. **/
+power_state_t power_state_get(void);
+
+/**@brief Function to return true while the charger is connected. **/
+bool power_is_charging(void);
+
+/* Static Functions */
+
+/* Picks the state from the inputs and applies a change */
+static void power_state_update(void);
+
+/* Idle timer handler, advances to the next idle state */
+static void power_idle_timer_handler(void * p_context);
+
+/* Shutdown handler, arms the wake sources before System OFF */
+static bool power_shutdown_handler(nrf_pwr_mgmt_evt_t event);
+
+#endif
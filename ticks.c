@@ -0,0 +1,75 @@
+/* File: ticks.c */
+
+/** C file for the SwivX monotonic tick time base **/
+
+
+#include "ticks.h"
+#include "app_error.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+
+APP_TIMER_DEF(m_ticks_guard_timer);   //RTC overflow guard timer
+
+static uint64_t rtc_overflow_ticks = 0;
+static uint32_t rtc_last_cnt = 0;
+
+
+/**@brief Function for initializing the tick time base. **/
+void ticks_init(void)
+{
+    ret_code_t err_code;
+
+    //Overflow guard, 24bit RTC counter wraps every 512 seconds
+    err_code = app_timer_create(&m_ticks_guard_timer, APP_TIMER_MODE_REPEATED, ticks_guard_timer_handler);
+    APP_ERROR_CHECK(err_code);
+
+    err_code = app_timer_start(m_ticks_guard_timer, APP_TIMER_TICKS(TICKS_GUARD_TIMEOUT), NULL);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**@brief Function for getting the RTC ticks since reset, extends the 24bit RTC counter to 64bit. **/
+uint64_t ticks_get(void)
+{
+    uint64_t ticks;
+
+    CRITICAL_REGION_ENTER();
+    uint32_t cnt = app_timer_cnt_get();
+    if(cnt < rtc_last_cnt)
+    {
+        rtc_overflow_ticks += (1UL << TICKS_RTC_COUNTER_BITS);
+    }
+    rtc_last_cnt = cnt;
+    ticks = rtc_overflow_ticks + cnt;
+    CRITICAL_REGION_EXIT();
+
+    return ticks;
+}
+
+
+/**@brief Function for getting the milliseconds since reset. **/
+uint64_t ticks_ms_get(void)
+{
+    return TICKS_TO_MS(ticks_get());
+}
+
+
+/**@brief Function for getting the milliseconds passed since an earlier ticks_ms_get() time. **/
+uint32_t ticks_ms_since(uint64_t previous_ms)
+{
+    uint64_t now = ticks_ms_get();
+
+    if(now <= previous_ms)
+    {
+        return 0;
+    }
+
+    return ((now - previous_ms) > UINT32_MAX) ? UINT32_MAX : (uint32_t)(now - previous_ms);
+}
+
+
+/* Guard timer handler, keeps the RTC overflow count up to date */
+static void ticks_guard_timer_handler(void * p_context)
+{
+    (void)ticks_get();
+}
@@ -0,0 +1,61 @@
+/* Header file ticks.h */
+
+/** Header file for the SwivX monotonic tick time base **/
+
+
+
+#ifndef TICKS_H
+#define TICKS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//RTC time base, app_timer RTC1 runs with prescaler 0 (APP_TIMER_CONFIG_RTC_FREQUENCY)
+#define TICKS_PER_SEC               32768
+#define TICKS_RTC_COUNTER_BITS      24
+//Overflow guard interval, must be shorter than one RTC1 counter period (512 s)
+#define TICKS_GUARD_TIMEOUT         256000
+
+//Integer conversion, 1000/32768 ms per tick is 125/4096
+#define TICKS_TO_MS(ticks)          (((uint64_t)(ticks) * 125) >> 12)
+#define TICKS_FROM_MS(ms)           (((uint64_t)(ms) << 12) / 125)
+
+
+/**@brief Function for initializing the tick time base.
+ *
+ * @details Starts the guard timer that tracks the RTC counter overflows, app_timer must be
+ *          initialized. The time base never wraps, 64 bits of RTC ticks last for millions of years.
+ */
+void ticks_init(void);
+
+/**@brief Function for getting the RTC ticks since reset.
+ *
+ * @details Interrupt safe.
+ */
+uint64_t ticks_get(void);
+
+/**@brief Function for getting the milliseconds since reset.
+ *
+ * @details Interrupt safe. Never wraps, a later time is always the larger value so
+ *          timeouts are a plain subtraction.
+ */
+uint64_t ticks_ms_get(void);
+
+/**@brief Function for getting the milliseconds passed since an earlier ticks_ms_get() time.
+ *
+ * @param[in]   previous_ms   Earlier ticks_ms_get() time.
+ *
+ * @return   Elapsed time in ms, 0 if previous_ms is in the future, saturated at UINT32_MAX.
+ */
+uint32_t ticks_ms_since(uint64_t previous_ms);
+
+/* Static Functions */
+
+/* Guard timer handler, keeps the RTC overflow count up to date */
+static void ticks_guard_timer_handler(void * p_context);
+
+#endif
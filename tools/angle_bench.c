@@ -0,0 +1,204 @@
+/* File: angle_bench.c */
+
+/** Host accuracy sweep and micro-benchmark of the fixed-point tilt kernel (angle.c)
+ *
+ *  Compares angle_tilt() and angle_atan2() with atan2() in double, and times them against the
+ *  float path kxtj3_get_angle() used before. Host timings do not carry over to the M4F, which
+ *  has no double FPU and runs the old path in soft double.
+ *
+ *      gcc -O2 -Wall -I.. -o angle_bench angle_bench.c -lm
+ *      ./angle_bench
+ **/
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../angle.c"
+
+#define SWEEP_STEP          1543        //Grid step over the int16 range, odd to hit odd values
+#define BENCH_SAMPLES       4096
+#define BENCH_ROUNDS        2000
+#define DEG_PER_RAD         (180.0 / 3.14159265358979323846)
+
+static volatile int32_t m_sink;
+
+
+/* Reference tilt in degrees, the same quadrant mapping as angle_tilt() */
+static double tilt_ref(int16_t x, int16_t y, int16_t z)
+{
+    return atan2(sqrt((double)x * x + (double)y * y), -(double)z) * DEG_PER_RAD;
+}
+
+/* The float path of kxtj3_get_angle() before angle.c, hi res mode, in degrees */
+static float tilt_old(int16_t x, int16_t y, int16_t z)
+{
+    uint16_t x_u16_t = (uint16_t)x;
+    uint16_t y_u16_t = (uint16_t)y;
+    uint16_t z_u16_t = (uint16_t)z;
+
+    uint16_t x_valT_16 = (x_u16_t & 0x8000 ? (~x_u16_t + 1) & 0xFFFF : x_u16_t) >> 4;
+    uint16_t y_valT_16 = (y_u16_t & 0x8000 ? (~y_u16_t + 1) & 0xFFFF : y_u16_t) >> 4;
+    uint16_t z_valT_16 = (z_u16_t & 0x8000 ? (~z_u16_t + 1) & 0xFFFF : z_u16_t) >> 4;
+
+    float x_valF = (float)x_valT_16 / 512.0 * (x_u16_t & 0x8000 ? (-1.0) : (1.0));
+    float y_valF = (float)y_valT_16 / 512.0 * (y_u16_t & 0x8000 ? (-1.0) : (1.0));
+    float z_valF = (float)z_valT_16 / 512.0 * (z_u16_t & 0x8000 ? (-1.0) : (1.0));
+
+    if(z_valF == 0)
+    {
+        z_valF = 0.01;
+    }
+
+    float norm = sqrtf(x_valF * x_valF + y_valF * y_valF);
+    float angle = (float)atan(-1 * norm / z_valF) * 180 / 3.14159;
+
+    if(angle < 0.0f)
+    {
+        angle += 180.0f;
+    }
+
+    return angle;
+}
+
+/* Wrapped difference of two angles in degrees */
+static double angle_diff(double a, double b)
+{
+    double d = fmod(a - b + 540.0, 360.0) - 180.0;
+
+    return fabs(d);
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+/* Tilt over a grid of the full int16 cube, both kernels against the double reference */
+static void sweep_tilt(void)
+{
+    double max_new = 0, max_old = 0, sum_new = 0;
+    uint32_t count = 0;
+    int32_t x, y, z;
+
+    for(x = -32768; x <= 32767; x += SWEEP_STEP)
+    {
+        for(y = -32768; y <= 32767; y += SWEEP_STEP)
+        {
+            for(z = -32768; z <= 32767; z += SWEEP_STEP)
+            {
+                if(x == 0 && y == 0 && z == 0)
+                {
+                    continue;
+                }
+
+                double ref = tilt_ref(x, y, z);
+                double err_new = fabs(angle_tilt(x, y, z) / (double)(1 << ANGLE_Q) - ref);
+                double err_old = fabs(tilt_old(x, y, z) - ref);
+
+                max_new = fmax(max_new, err_new);
+                max_old = fmax(max_old, err_old);
+                sum_new += err_new;
+                count++;
+            }
+        }
+    }
+
+    printf("tilt sweep, %u points\n", count);
+    printf("  angle_tilt  max error %.4f deg, mean %.4f deg\n", max_new, sum_new / count);
+    printf("  old float   max error %.4f deg\n", max_old);
+}
+
+/* atan2 over the full circle at a fixed radius and on the axes */
+static void sweep_atan2(void)
+{
+    double max_err = 0;
+    uint32_t i;
+
+    for(i = 0; i < 36000; i++)
+    {
+        double a = i * (360.0 / 36000) - 180.0;
+        int32_t x = (int32_t)lround(30000 * cos(a / DEG_PER_RAD));
+        int32_t y = (int32_t)lround(30000 * sin(a / DEG_PER_RAD));
+        double ref = atan2(y, x) * DEG_PER_RAD;
+
+        max_err = fmax(max_err, angle_diff(angle_atan2(y, x) / (double)(1 << ANGLE_Q), ref));
+    }
+
+    printf("atan2 sweep, 36000 points\n");
+    printf("  angle_atan2 max error %.4f deg\n", max_err);
+}
+
+/* Time per sample over random raw samples, a volatile sink keeps the loops */
+static void bench(void)
+{
+    static int16_t samples[BENCH_SAMPLES][3];
+    double start, t_new, t_old, t_isqrt;
+    uint32_t i, round;
+    int32_t acc;
+
+    srand(1);
+    for(i = 0; i < BENCH_SAMPLES; i++)
+    {
+        samples[i][0] = (int16_t)(rand() & 0xFFFF);
+        samples[i][1] = (int16_t)(rand() & 0xFFFF);
+        samples[i][2] = (int16_t)(rand() & 0xFFFF);
+    }
+
+    acc = 0;
+    start = now_ns();
+    for(round = 0; round < BENCH_ROUNDS; round++)
+    {
+        for(i = 0; i < BENCH_SAMPLES; i++)
+        {
+            acc += angle_tilt(samples[i][0], samples[i][1], samples[i][2]);
+        }
+    }
+    t_new = (now_ns() - start) / ((double)BENCH_ROUNDS * BENCH_SAMPLES);
+    m_sink = acc;
+
+    acc = 0;
+    start = now_ns();
+    for(round = 0; round < BENCH_ROUNDS; round++)
+    {
+        for(i = 0; i < BENCH_SAMPLES; i++)
+        {
+            acc += (int32_t)tilt_old(samples[i][0], samples[i][1], samples[i][2]);
+        }
+    }
+    t_old = (now_ns() - start) / ((double)BENCH_ROUNDS * BENCH_SAMPLES);
+    m_sink = acc;
+
+    acc = 0;
+    start = now_ns();
+    for(round = 0; round < BENCH_ROUNDS; round++)
+    {
+        for(i = 0; i < BENCH_SAMPLES; i++)
+        {
+            acc += angle_isqrt((uint32_t)(samples[i][0] * samples[i][0]) + (uint32_t)(samples[i][1] * samples[i][1]));
+        }
+    }
+    t_isqrt = (now_ns() - start) / ((double)BENCH_ROUNDS * BENCH_SAMPLES);
+    m_sink = acc;
+
+    printf("benchmark, %u samples x %u rounds\n", BENCH_SAMPLES, BENCH_ROUNDS);
+    printf("  angle_tilt  %.1f ns/sample (angle_isqrt %.1f ns)\n", t_new, t_isqrt);
+    printf("  old float   %.1f ns/sample\n", t_old);
+}
+
+
+int main(void)
+{
+    sweep_tilt();
+    sweep_atan2();
+    bench();
+
+    return 0;
+}
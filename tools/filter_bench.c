@@ -0,0 +1,218 @@
+/* File: filter_bench.c */
+
+/** Host step-latency and noise test bench of the angle filter pipeline (filter.c)
+ *
+ *  Runs each configuration on a synthetic 50Hz angle stream:
+ *  - step: a 60 -> 90 degree step, time until the output stays within STEP_BAND_DEG of 90
+ *  - noise: a constant 75 degrees with gaussian noise and random spikes, rms and max output error
+ *  The 10 sample boxcar used before filter.c is run for comparison.
+ *
+ *      gcc -O2 -Wall -I.. -Ihost -o filter_bench filter_bench.c -lm
+ *      ./filter_bench
+ *
+ *  host/ stands in for the SDK headers filter.c includes.
+ **/
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "../filter.c"
+
+#define ODR_HZ              50
+#define SAMPLE_MS           (1000 / ODR_HZ)
+#define STEP_FROM_DEG       60
+#define STEP_TO_DEG         90
+#define STEP_AT             100         //Sample index of the step
+#define STEP_SAMPLES        300
+#define STEP_BAND_DEG       3.0
+#define NOISE_DEG           75
+#define NOISE_SIGMA_DEG     1.0
+#define SPIKE_PERCENT       2
+#define SPIKE_DEG           20
+#define NOISE_SAMPLES       50000
+#define BOXCAR_LEN          10
+
+/** Filter under test, either the pipeline or the old boxcar **/
+typedef struct
+{
+    const char * name;
+    bool is_boxcar;
+    filter_config_t config;
+} bench_case_t;
+
+static const bench_case_t m_cases[] =
+{
+    {"old boxcar /10",      true,   {0, 0, 1}},
+    {"median5 iir1/4",      false,  {5, 2, 1}},
+    {"median3 iir1/4",      false,  {3, 2, 1}},
+    {"median5 iir1/8",      false,  {5, 3, 1}},
+    {"median3 only",        false,  {3, 0, 1}},
+    {"iir1/4 only",         false,  {0, 2, 1}},
+    {"median5 iir1/4 /5",   false,  {5, 2, 5}},
+};
+
+static int32_t boxcar_sum;
+static uint8_t boxcar_count;
+static int16_t boxcar_out;
+
+
+/* Box-Muller, seeded with srand() */
+static double gaussian(void)
+{
+    double u1 = (rand() + 1.0) / (RAND_MAX + 2.0);
+    double u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * 3.14159265358979323846 * u2);
+}
+
+/* Noisy angle sample in 1/64 degree */
+static int16_t noisy_sample(double angle_deg)
+{
+    double value = angle_deg + NOISE_SIGMA_DEG * gaussian();
+
+    if(rand() % 100 < SPIKE_PERCENT)
+    {
+        value += (rand() & 1) ? SPIKE_DEG : -SPIKE_DEG;
+    }
+
+    return (int16_t)lround(value * 64);
+}
+
+static void case_reset(bench_case_t const * p_case)
+{
+    boxcar_sum = 0;
+    boxcar_count = 0;
+    boxcar_out = 0;
+
+    if(!p_case->is_boxcar)
+    {
+        (void)filter_config_set(&p_case->config);
+    }
+}
+
+/* One sample through the filter, the output holds between output samples */
+static int16_t case_process(bench_case_t const * p_case, int16_t sample, bool * p_primed)
+{
+    int16_t out;
+
+    if(p_case->is_boxcar)
+    {
+        //Average of 10 samples, one output per 10 samples
+        boxcar_sum += sample;
+        boxcar_count++;
+        if(boxcar_count == BOXCAR_LEN)
+        {
+            boxcar_out = (int16_t)(boxcar_sum / BOXCAR_LEN);
+            boxcar_sum = 0;
+            boxcar_count = 0;
+            *p_primed = true;
+        }
+        return boxcar_out;
+    }
+
+    if(filter_process(sample, false, &out))
+    {
+        *p_primed = true;
+        return out;
+    }
+    return last_output;
+}
+
+
+/* Worst settling time over every phase of the step against the output cycle, in ms */
+static uint32_t step_latency(bench_case_t const * p_case)
+{
+    uint32_t worst = 0;
+    uint32_t phase;
+
+    for(phase = 0; phase < BOXCAR_LEN; phase++)
+    {
+        bool is_primed = false;
+        int32_t settled = -1;
+        uint32_t i;
+
+        case_reset(p_case);
+
+        for(i = 0; i < STEP_AT + phase + STEP_SAMPLES; i++)
+        {
+            int16_t sample = ((i < STEP_AT + phase) ? STEP_FROM_DEG : STEP_TO_DEG) * 64;
+            int16_t out = case_process(p_case, sample, &is_primed);
+            double err = fabs(out / 64.0 - STEP_TO_DEG);
+
+            if(i < STEP_AT + phase)
+            {
+                continue;
+            }
+            if(err > STEP_BAND_DEG || !is_primed)
+            {
+                settled = -1;
+            }
+            else if(settled < 0)
+            {
+                settled = (int32_t)(i - (STEP_AT + phase));
+            }
+        }
+
+        //The output is sampled at the latest sample, settling on the step sample itself is 1 sample
+        if(settled >= 0 && (uint32_t)(settled + 1) * SAMPLE_MS > worst)
+        {
+            worst = (uint32_t)(settled + 1) * SAMPLE_MS;
+        }
+    }
+
+    return worst;
+}
+
+/* Output error on a constant angle with noise and spikes */
+static void noise_error(bench_case_t const * p_case, double * p_rms, double * p_max)
+{
+    bool is_primed = false;
+    double sum_sq = 0;
+    double max = 0;
+    uint32_t count = 0;
+    uint32_t i;
+
+    srand(1);
+    case_reset(p_case);
+
+    for(i = 0; i < NOISE_SAMPLES; i++)
+    {
+        int16_t out = case_process(p_case, noisy_sample(NOISE_DEG), &is_primed);
+        double err = fabs(out / 64.0 - NOISE_DEG);
+
+        if(!is_primed)
+        {
+            continue;
+        }
+
+        sum_sq += err * err;
+        max = fmax(max, err);
+        count++;
+    }
+
+    *p_rms = sqrt(sum_sq / count);
+    *p_max = max;
+}
+
+
+int main(void)
+{
+    uint32_t i;
+
+    printf("%d Hz, step %d -> %d deg within %.0f deg, noise sigma %.1f deg + %d%% +-%d deg spikes\n",
+           ODR_HZ, STEP_FROM_DEG, STEP_TO_DEG, STEP_BAND_DEG, NOISE_SIGMA_DEG, SPIKE_PERCENT, SPIKE_DEG);
+
+    for(i = 0; i < sizeof(m_cases) / sizeof(m_cases[0]); i++)
+    {
+        double rms, max;
+        uint32_t latency = step_latency(&m_cases[i]);
+
+        noise_error(&m_cases[i], &rms, &max);
+        printf("  %-20s step %4u ms   rms %.2f   max %4.1f deg\n", m_cases[i].name, latency, rms, max);
+    }
+
+    return 0;
+}
@@ -0,0 +1,18 @@
+/* Header file sdk_errors.h */
+
+/** Host stand-in for the SDK error codes, only for the tools/ harnesses **/
+
+
+
+#ifndef SDK_ERRORS_H__
+#define SDK_ERRORS_H__
+
+#include <stdint.h>
+
+typedef uint32_t ret_code_t;
+
+#define NRF_SUCCESS                 0
+#define NRF_ERROR_INVALID_PARAM     7
+#define NRF_ERROR_INVALID_STATE     8
+
+#endif
@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+"""Decoder for the SwivX binary trace.
+
+The firmware sends 20 byte records on RTT up channel 1 (see trace.h). Capture
+the channel to a file, e.g. with the J-Link RTT Logger:
+
+    JLinkRTTLogger -Device NRF52832_XXAA -If SWD -Speed 4000 -RTTChannel 1 trace.bin
+
+then decode it with the format strings of the trace point table:
+
+    python3 tools/trace_decode.py trace.bin
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+RECORD = struct.Struct("<IBBH3i")
+TICKS_PER_SEC = 32768
+
+POINT_RE = re.compile(r'X\(\s*(\w+)\s*,\s*(\w+)\s*,\s*"((?:[^"\\]|\\.)*)"\s*\)')
+
+
+def load_points(header):
+    """Returns (name, format) per trace id, in table order."""
+    with open(header) as f:
+        text = f.read()
+
+    start = text.index("#define TRACE_POINTS(X)")
+    end = text.index("\n\n", start)
+    return [(name, fmt) for name, _level, fmt in POINT_RE.findall(text[start:end])]
+
+
+def decode(data, points, out):
+    last_seq = None
+
+    for offset in range(0, len(data) - RECORD.size + 1, RECORD.size):
+        time, trace_id, argc, seq, *args = RECORD.unpack_from(data, offset)
+
+        if last_seq is not None and seq != (last_seq + 1) & 0xFFFF:
+            out.write("--- %d records lost ---\n" % ((seq - last_seq - 1) & 0xFFFF))
+        last_seq = seq
+
+        if trace_id < len(points):
+            name, fmt = points[trace_id]
+            try:
+                text = fmt % tuple(args[:argc])
+            except (TypeError, ValueError):
+                text = "%s %s" % (fmt, args[:argc])
+        else:
+            name, text = "TRACE_%d" % trace_id, " ".join(str(a) for a in args[:argc])
+
+        out.write("%12.6f %-16s %s\n" % (time / TICKS_PER_SEC, name, text))
+
+
+def main():
+    default_header = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "trace.h")
+
+    parser = argparse.ArgumentParser(description="Decode a SwivX binary trace capture.")
+    parser.add_argument("capture", help="binary capture of RTT channel 1")
+    parser.add_argument("--header", default=default_header, help="trace.h with the trace point table")
+    args = parser.parse_args()
+
+    with open(args.capture, "rb") as f:
+        data = f.read()
+
+    decode(data, load_points(args.header), sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
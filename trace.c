@@ -0,0 +1,102 @@
+/* File: trace.c */
+
+/** C file for the SwivX binary trace **/
+
+
+#include "trace.h"
+
+#if TRACE_LEVEL > TRACE_LEVEL_NONE
+
+#include <string.h>
+#include "nrf.h"
+#include "app_util.h"
+#include "nrf_atomic.h"
+#include "SEGGER_RTT.h"
+#include "ticks.h"
+
+STATIC_ASSERT(sizeof(trace_record_t) == 20);
+STATIC_ASSERT((TRACE_RING_SIZE & (TRACE_RING_SIZE - 1)) == 0);
+
+static trace_record_t m_ring[TRACE_RING_SIZE];
+static nrf_atomic_u32_t m_write_index = 0;     //Next slot to reserve, never wraps back
+static uint32_t m_read_index = 0;              //Next record to send, main loop only
+static uint8_t m_rtt_buffer[TRACE_RTT_BUFFER_SIZE];
+
+
+/**@brief Function for initializing the trace ring and its RTT channel. **/
+void trace_init(void)
+{
+    uint32_t i;
+
+    //Every slot starts one lap behind, so a reserved but unfilled slot is told apart
+    memset(m_ring, 0, sizeof(m_ring));
+    for(i = 0; i < TRACE_RING_SIZE; i++)
+    {
+        m_ring[i].seq = (uint16_t)(i - TRACE_RING_SIZE);
+    }
+    m_write_index = 0;
+    m_read_index = 0;
+
+    //Skip mode, a record is written whole or not at all and never blocks without a host
+    (void)SEGGER_RTT_ConfigUpBuffer(TRACE_RTT_CHANNEL, "Trace", m_rtt_buffer, sizeof(m_rtt_buffer),
+                                    SEGGER_RTT_MODE_NO_BLOCK_SKIP);
+}
+
+
+/**@brief Function for storing a record. **/
+void trace_record(trace_id_t id, uint8_t argc, int32_t a0, int32_t a1, int32_t a2)
+{
+    //Each writer owns its slot, interrupts can record in between without a lock
+    uint32_t index = nrf_atomic_u32_fetch_add(&m_write_index, 1);
+    trace_record_t * p_record = &m_ring[index & (TRACE_RING_SIZE - 1)];
+
+    p_record->time = (uint32_t)ticks_get();
+    p_record->id = (uint8_t)id;
+    p_record->argc = argc;
+    p_record->args[0] = a0;
+    p_record->args[1] = a1;
+    p_record->args[2] = a2;
+
+    //The sequence marks the record complete
+    __DMB();
+    *(volatile uint16_t *)&p_record->seq = (uint16_t)index;
+}
+
+
+/**@brief Function for copying the new records to the RTT channel. **/
+void trace_flush(void)
+{
+    trace_record_t record;
+    uint32_t write_index = m_write_index;
+
+    //Overwritten before they were sent, the host sees the gap in the sequence
+    if(write_index - m_read_index > TRACE_RING_SIZE)
+    {
+        m_read_index = write_index - TRACE_RING_SIZE;
+    }
+
+    while(m_read_index != write_index)
+    {
+        memcpy(&record, &m_ring[m_read_index & (TRACE_RING_SIZE - 1)], sizeof(record));
+
+        if(record.seq == (uint16_t)(m_read_index - TRACE_RING_SIZE))
+        {
+            //Slot reserved by an interrupted writer, not filled in yet
+            break;
+        }
+
+        //Any other sequence is a newer record that overwrote this one, skipped
+        if(record.seq == (uint16_t)m_read_index)
+        {
+            if(SEGGER_RTT_Write(TRACE_RTT_CHANNEL, &record, sizeof(record)) == 0)
+            {
+                //RTT buffer full or no host, the ring keeps the latest records
+                break;
+            }
+        }
+
+        m_read_index++;
+    }
+}
+
+#endif
@@ -0,0 +1,117 @@
+/* Header file trace.h */
+
+/** Header file for the SwivX binary trace **/
+
+
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "nordic_common.h"
+
+/** Trace levels, a trace point is compiled in when its level is at most TRACE_LEVEL **/
+#define TRACE_LEVEL_NONE            0
+#define TRACE_LEVEL_INFO            1
+#define TRACE_LEVEL_DEBUG           2
+
+//Debug builds record everything, release builds strip the trace points and the ring
+#ifndef TRACE_LEVEL
+#ifdef DEBUG
+#define TRACE_LEVEL                 TRACE_LEVEL_DEBUG
+#else
+#define TRACE_LEVEL                 TRACE_LEVEL_NONE
+#endif
+#endif
+
+#define TRACE_RING_SIZE             64          //Records, power of 2
+#define TRACE_ARGS_MAX              3
+#define TRACE_RTT_CHANNEL           1           //RTT up buffer, channel 0 carries NRF_LOG
+#define TRACE_RTT_BUFFER_SIZE       1024
+
+/** Trace points: name, level and the format string, only the host decoder
+ *  (tools/trace_decode.py) reads the strings. Append new points at the end,
+ *  the position is the id in the records.
+ **/
+#define TRACE_POINTS(X)                                                                         \
+    X(TRACE_ANGLE,          TRACE_LEVEL_DEBUG,  "current angle: %d, lateral: %d")               \
+    X(TRACE_LOG_WRITE,      TRACE_LEVEL_DEBUG,  "log head: %d, tail: %d")                       \
+    X(TRACE_LOG_PAGE,       TRACE_LEVEL_INFO,   "log page %d written, new record: %d")          \
+    X(TRACE_LOG_SEND,       TRACE_LEVEL_DEBUG,  "log send: %d packets queued, error: %d")       \
+    X(TRACE_CAPSENSE,       TRACE_LEVEL_DEBUG,  "capsense reading: %d, delta: %d, wear: %d")
+
+/** Trace point ids **/
+typedef enum
+{
+#define TRACE_POINT_ID(name, level, format)     name,
+    TRACE_POINTS(TRACE_POINT_ID)
+#undef TRACE_POINT_ID
+    TRACE_POINT_COUNT
+} trace_id_t;
+
+/** Level of each trace point, constant so the filter folds at compile time **/
+enum
+{
+#define TRACE_POINT_LEVEL(name, level, format)  name##_LEVEL = level,
+    TRACE_POINTS(TRACE_POINT_LEVEL)
+#undef TRACE_POINT_LEVEL
+};
+
+/** Trace record, 20 bytes little endian as the host decoder reads them **/
+typedef struct
+{
+    uint32_t time;                  //RTC ticks, low 32 bits
+    uint8_t id;                     //trace_id_t
+    uint8_t argc;
+    uint16_t seq;                   //Write index, written last, gaps are overwritten records
+    int32_t args[TRACE_ARGS_MAX];
+} trace_record_t;
+
+/**@brief Macro for recording a trace point with up to TRACE_ARGS_MAX integer arguments.
+ *
+ * @details Only the id and the raw arguments are stored, no formatting on the device. Interrupt
+ *          safe. A point above TRACE_LEVEL compiles to nothing, its arguments are not evaluated.
+ */
+#if TRACE_LEVEL > TRACE_LEVEL_NONE
+#define TRACE(...)                  TRACE_(NUM_VA_ARGS_LESS_1(__VA_ARGS__), __VA_ARGS__, 0, 0, 0, 0)
+#define TRACE_(argc, id, a0, a1, a2, ...)                                                       \
+    do                                                                                          \
+    {                                                                                           \
+        if(id##_LEVEL <= TRACE_LEVEL)                                                           \
+        {                                                                                       \
+            trace_record((id), (argc), (int32_t)(a0), (int32_t)(a1), (int32_t)(a2));            \
+        }                                                                                       \
+    } while(0)
+#else
+#define TRACE(...)                  do { } while(0)
+#endif
+
+
+#if TRACE_LEVEL > TRACE_LEVEL_NONE
+
+/**@brief Function for initializing the trace ring and its RTT channel. **/
+void trace_init(void);
+
+/**@brief Function for storing a record, use the TRACE macro. **/
+void trace_record(trace_id_t id, uint8_t argc, int32_t a0, int32_t a1, int32_t a2);
+
+/**@brief Function for copying the new records to the RTT channel, called from the main loop.
+ *
+ * @details Binary only, a record that does not fit waits for the next call. Records the ring
+ *          overwrote before they were sent show up as gaps in the sequence numbers.
+ */
+void trace_flush(void);
+
+#else
+
+#define trace_init()                do { } while(0)
+#define trace_flush()               do { } while(0)
+
+#endif
+
+#endif